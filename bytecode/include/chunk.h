@@ -0,0 +1,177 @@
+#pragma once
+
+#include <callables.h>
+#include <lox_function.h>
+#include <lox_type.h>
+#include <resolution.h>
+#include <stmt.h>
+#include <token.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Bytecode {
+
+// Instructions of the stack machine. Operands follow the opcode as 16 bit
+// indices, except for the argument count of OP_CALL, which is one byte
+// after the index of its token.
+enum OpCode : uint8_t {
+  OP_CONSTANT,
+  OP_NIL,
+  OP_TRUE,
+  OP_FALSE,
+  OP_POP,
+
+  OP_GET_SLOT,
+  OP_SET_SLOT,
+  OP_DEFINE_SLOT,
+  OP_GET_CELL,
+  OP_SET_CELL,
+  OP_DEFINE_CELL,
+  OP_GET_UPVALUE,
+  OP_SET_UPVALUE,
+  OP_GET_GLOBAL,
+  OP_SET_GLOBAL,
+  OP_DEFINE_GLOBAL,
+  OP_GET_PROPERTY,
+  OP_SET_PROPERTY,
+  OP_GET_SUPER,
+
+  OP_EQUAL,
+  OP_NOT_EQUAL,
+  OP_GREATER,
+  OP_GREATER_EQUAL,
+  OP_LESS,
+  OP_LESS_EQUAL,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_MULTIPLY,
+  OP_DIVIDE,
+  OP_NOT,
+  OP_NEGATE,
+  OP_TRUTH,
+
+  OP_JUMP,
+  OP_JUMP_IF_FALSE,
+  OP_JUMP_IF_TRUE_OR_POP,
+  OP_JUMP_IF_FALSE_OR_POP,
+  OP_LOOP,
+
+  OP_PRINT,
+  OP_CALL,
+  OP_CLOSURE,
+  OP_CLASS,
+  OP_RETURN,
+};
+
+// A class declaration, instantiated by OP_CLASS.
+struct ClassInfo {
+  std::string name;
+  std::vector<FunctionCode> methods;
+  // The name of the superclass, which OP_CLASS pops, if the class has one.
+  std::optional<Token> superclass;
+};
+
+// Compiled code of one function: the instruction stream and the tables its
+// operands index into. Instructions that can fail are mapped to the token
+// they were compiled from, which is only looked up to report an error.
+class Chunk {
+public:
+  const uint8_t *code() const { return _code.data(); }
+  size_t size() const { return _code.size(); }
+
+  void write(uint8_t byte) { _code.push_back(byte); }
+  void write16(uint16_t value) {
+    _code.push_back(value & 0xff);
+    _code.push_back(value >> 8);
+  }
+  void patch16(size_t offset, uint16_t value) {
+    _code[offset] = value & 0xff;
+    _code[offset + 1] = value >> 8;
+  }
+
+  static uint16_t read16(const uint8_t *ip) {
+    uint16_t value;
+    std::memcpy(&value, ip, sizeof(value));
+    return value;
+  }
+
+  size_t addConstant(const LoxType &value) {
+    for (size_t i = 0; i < _constants.size(); i++) {
+      if (_constants[i].tag() == value.tag() && _constants[i] == value)
+        return i;
+    }
+    _constants.push_back(value);
+    return _constants.size() - 1;
+  }
+  size_t addToken(const Token &token) {
+    _tokens.push_back(token);
+    _globals.push_back(nullptr);
+    return _tokens.size() - 1;
+  }
+  size_t addFunction(FunctionCode function) {
+    _functions.push_back(std::move(function));
+    return _functions.size() - 1;
+  }
+  size_t addClass(ClassInfo info) {
+    _classes.push_back(std::move(info));
+    return _classes.size() - 1;
+  }
+
+  // Maps the next instruction written to the token it reports errors at.
+  void addLocation(const Token &token) {
+    _locations.emplace_back(_code.size(), addToken(token));
+  }
+
+  const LoxType &constant(size_t index) const { return _constants[index]; }
+  const Token &token(size_t index) const { return _tokens[index]; }
+  // Where the global variable named by a token is stored, once the VM
+  // looked it up.
+  LoxType *&global(size_t index) const { return _globals[index]; }
+  const FunctionCode &function(size_t index) const {
+    return _functions[index];
+  }
+  const ClassInfo &classInfo(size_t index) const { return _classes[index]; }
+
+  // The token of the instruction at this offset.
+  const Token &tokenAt(size_t offset) const {
+    auto it = std::upper_bound(
+        _locations.begin(), _locations.end(), offset,
+        [](size_t offset, const auto &location) { return offset < location.first; });
+    return _tokens[std::prev(it)->second];
+  }
+
+private:
+  std::vector<uint8_t> _code;
+  std::vector<LoxType> _constants;
+  std::vector<Token> _tokens;
+  mutable std::vector<LoxType *> _globals;
+  // The functions declared in the code, which it owns.
+  std::vector<FunctionCode> _functions;
+  std::vector<ClassInfo> _classes;
+  // Offsets of the instructions that can fail, in ascending order, and
+  // the index of their token.
+  std::vector<std::pair<size_t, size_t>> _locations;
+};
+
+// A function declaration compiled to bytecode, or the top level code of a
+// script. LoxFunctions created from the declaration run this code, and
+// keep it alive.
+struct Function : CompiledFunction {
+  const Stmt::FunctionStmt *declaration = nullptr;
+  FunctionInfo info;
+  // Most operands the code keeps on the stack above the locals at a time.
+  int stack = 0;
+  Token name{END_OF_FILE, ""};
+  Chunk chunk;
+};
+
+} // namespace Bytecode
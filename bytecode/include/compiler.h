@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chunk.h>
+#include <expression_visitor.h>
+#include <interpreter.h>
+#include <stmt_visitor.h>
+
+#include <memory>
+#include <vector>
+
+namespace Bytecode {
+
+// Translates resolved syntax trees to bytecode. Variables are addressed the
+// way the Resolver laid them out, so the VM's frames look like the tree
+// walker's (see Frame).
+class Compiler : public Expr::ExprVisitor, public Stmt::StmtVisitor {
+public:
+  // Compiles top level code, and every function declared in it. Returns
+  // nullptr if the code does not fit the instruction format.
+  std::unique_ptr<Function> compile(const std::vector<Stmt::Stmt *> &);
+
+  void visitExprStmt(const Stmt::ExprStmt *) override;
+  void visitPrintStmt(const Stmt::PrintStmt *) override;
+  void visitVarStmt(const Stmt::VarStmt *) override;
+  void visitBlock(const Stmt::Block *) override;
+  void visitIfStmt(const Stmt::IfStmt *) override;
+  void visitWhileStmt(const Stmt::WhileStmt *) override;
+  void visitForStmt(const Stmt::ForStmt *) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override;
+  void visitReturnStmt(const Stmt::ReturnStmt *) override;
+  void visitClassStmt(const Stmt::ClassStmt *) override;
+
+  void visitBinary(const Expr::BinaryExpr *) override;
+  void visitLiteral(const Expr::LiteralExpr *) override;
+  void visitUnary(const Expr::UnaryExpr *) override;
+  void visitGrouping(const Expr::GroupingExpr *) override;
+  void visitTernary(const Expr::TernaryExpr *) override;
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitAssign(const Expr::AssignExpr *) override;
+  void visitLogic(const Expr::LogicExpr *) override;
+  void visitCall(const Expr::CallExpr *) override;
+  void visitGet(const Expr::GetExpr *) override;
+  void visitSet(const Expr::SetExpr *) override;
+  void visitThis(const Expr::ThisExpr *) override;
+  void visitSuper(const Expr::SuperExpr *) override;
+  void visitInline(const Expr::InlineExpr *) override;
+
+private:
+  void compile(const Stmt::Stmt *);
+  void compile(const Expr::Expr *);
+  FunctionCode compileFunction(const Stmt::FunctionStmt *);
+
+  void emit(OpCode);
+  void emit(OpCode, size_t operand);
+  void emitByte(uint8_t);
+  // Tracks how many operands the code pushes, see Function::stack.
+  void adjust(int);
+  void emitAt(const Token &, OpCode);
+  size_t emitJump(OpCode);
+  void patchJump(size_t);
+  void emitLoop(size_t start);
+
+  void emitGet(const Local *, const Token &);
+  void emitSet(const Local *, const Token &);
+  // Stores the value on top of the stack into a new variable and pops it.
+  // Declared variables already got their cell from emitDeclare.
+  void emitDefine(const Local *, const Token &, bool declared = false);
+  // Functions and classes may capture themselves, so captured ones get
+  // their cell before they are created.
+  void emitDeclare(const Local *);
+
+  uint16_t operand(size_t, const Token &);
+
+  Chunk &chunk() { return _function->chunk; }
+
+  Function *_function = nullptr;
+  int _depth = 0;
+  bool _hadError = false;
+};
+
+} // namespace Bytecode
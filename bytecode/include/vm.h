@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chunk.h>
+#include <compiler.h>
+#include <environment.h>
+#include <frame.h>
+#include <heap.h>
+#include <interpreter.h>
+
+#include <memory>
+#include <vector>
+
+class LoxClass;
+
+namespace Bytecode {
+
+// Runs compiled code on a stack machine. Values live on one stack: the
+// locals of each call, laid out as the Resolver assigned their slots, and
+// above them the operands of the instructions being executed. Calls leave
+// their arguments where the callee's parameters go.
+class VM : public RootSource {
+public:
+  VM();
+  ~VM();
+
+  // Compiles and runs resolved top level code. The Interpreter that
+  // resolved it provides the layout of its variables.
+  void interpret(const std::vector<Stmt::Stmt *> &, const Interpreter &);
+
+  void markRoots(Heap &) override;
+
+private:
+  static constexpr size_t STACK_SLOTS = 64 * 1024;
+  static constexpr size_t MAX_FRAMES = 16 * 1024;
+
+  struct CallFrame {
+    const Function *function;
+    const uint8_t *ip;
+    Frame frame;
+    // Keeps the running function, and with it its upvalues, alive.
+    LoxType callee;
+    // Where the result goes, the slot the callee was called from.
+    LoxType *result;
+    // Initializers return their instance, which sits in the first slot.
+    bool initializer;
+  };
+
+  void run();
+  void call(size_t argc, const Token &paren);
+  void callFunction(const LoxFunction *, const LoxType &receiver,
+                    LoxType *result, bool initializer);
+
+  void push(const LoxType &value) { *_sp++ = value; }
+  LoxType pop() { return std::move(*--_sp); }
+  LoxType &peek(size_t distance = 0) { return _sp[-1 - distance]; }
+
+  // Reports an error at the instruction that is executing.
+  [[noreturn]] void error(const char *message);
+  const Token &location() const;
+  void reset();
+
+  std::unique_ptr<LoxType[]> _stack;
+  std::unique_ptr<Upvalue *[]> _cells;
+  LoxType *_sp;
+  std::vector<CallFrame> _frames;
+  std::shared_ptr<Environment> _globals;
+};
+
+} // namespace Bytecode
@@ -0,0 +1,464 @@
+#include <compiler.h>
+#include <lox.h>
+
+#include <limits>
+
+namespace Bytecode {
+
+std::unique_ptr<Function> Compiler::compile(
+    const std::vector<Stmt::Stmt *> &statements) {
+  auto script = std::make_unique<Function>();
+  _function = script.get();
+  _depth = 0;
+  _hadError = false;
+
+  for (const Stmt::Stmt *statement : statements)
+    compile(statement);
+
+  emit(OP_NIL);
+  emit(OP_RETURN);
+
+  if (_hadError)
+    return nullptr;
+  return script;
+}
+
+void Compiler::visitExprStmt(const Stmt::ExprStmt *stmt) {
+  compile(stmt->expr());
+  emit(OP_POP);
+}
+
+void Compiler::visitPrintStmt(const Stmt::PrintStmt *stmt) {
+  compile(stmt->expr());
+  emit(OP_PRINT);
+}
+
+void Compiler::visitVarStmt(const Stmt::VarStmt *stmt) {
+  if (stmt->init() != nullptr)
+    compile(stmt->init());
+  else
+    emit(OP_NIL);
+
+  emitDefine(stmt->local(), stmt->name());
+}
+
+void Compiler::visitBlock(const Stmt::Block *block) {
+  for (const Stmt::Stmt *statement : block->statements())
+    compile(statement);
+}
+
+void Compiler::visitIfStmt(const Stmt::IfStmt *stmt) {
+  compile(stmt->condition());
+  size_t elseJump = emitJump(OP_JUMP_IF_FALSE);
+  compile(stmt->thenBranch());
+
+  if (stmt->elseBranch() == nullptr) {
+    patchJump(elseJump);
+    return;
+  }
+
+  size_t endJump = emitJump(OP_JUMP);
+  patchJump(elseJump);
+  compile(stmt->elseBranch());
+  patchJump(endJump);
+}
+
+void Compiler::visitWhileStmt(const Stmt::WhileStmt *stmt) {
+  size_t start = chunk().size();
+  compile(stmt->condition());
+  size_t exitJump = emitJump(OP_JUMP_IF_FALSE);
+  compile(stmt->body());
+  emitLoop(start);
+  patchJump(exitJump);
+}
+
+void Compiler::visitForStmt(const Stmt::ForStmt *stmt) {
+  if (stmt->init() != nullptr)
+    compile(stmt->init());
+
+  size_t start = chunk().size();
+  size_t exitJump = 0;
+  if (stmt->condition() != nullptr) {
+    compile(stmt->condition());
+    exitJump = emitJump(OP_JUMP_IF_FALSE);
+  }
+
+  compile(stmt->body());
+  if (stmt->after() != nullptr) {
+    compile(stmt->after());
+    emit(OP_POP);
+  }
+  emitLoop(start);
+
+  if (stmt->condition() != nullptr)
+    patchJump(exitJump);
+}
+
+void Compiler::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  const Local *local = stmt->local();
+  emitDeclare(local);
+
+  emit(OP_CLOSURE, chunk().addFunction(compileFunction(stmt)));
+  emitDefine(local, stmt->name(), true);
+}
+
+void Compiler::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
+  if (stmt->expr() != nullptr)
+    compile(stmt->expr());
+  else
+    emit(OP_NIL);
+
+  emit(OP_RETURN);
+}
+
+void Compiler::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  const Local *local = stmt->local();
+  emitDeclare(local);
+
+  ClassInfo info{stmt->name().lexeme(), {}, std::nullopt};
+  // The methods of a subclass capture super, which is defined first.
+  if (const Stmt::VarStmt *super = stmt->superDeclaration()) {
+    compile(super);
+    emitGet(super->local(), super->name());
+    info.superclass = stmt->superclass()->name();
+  }
+
+  for (const Stmt::FunctionStmt *method : stmt->methods())
+    info.methods.push_back(compileFunction(method));
+
+  bool inherits = info.superclass.has_value();
+  emit(OP_CLASS, chunk().addClass(std::move(info)));
+  if (inherits)
+    adjust(-1);
+  emitDefine(local, stmt->name(), true);
+}
+
+void Compiler::visitBinary(const Expr::BinaryExpr *expr) {
+  compile(expr->left());
+  compile(expr->right());
+
+  switch (expr->op().type()) {
+  case GREATER:
+    emitAt(expr->op(), OP_GREATER);
+    break;
+  case GREATER_EQUAL:
+    emitAt(expr->op(), OP_GREATER_EQUAL);
+    break;
+  case LESS:
+    emitAt(expr->op(), OP_LESS);
+    break;
+  case LESS_EQUAL:
+    emitAt(expr->op(), OP_LESS_EQUAL);
+    break;
+  case MINUS:
+    emitAt(expr->op(), OP_SUBTRACT);
+    break;
+  case PLUS:
+    emitAt(expr->op(), OP_ADD);
+    break;
+  case SLASH:
+    emitAt(expr->op(), OP_DIVIDE);
+    break;
+  case STAR:
+    emit(OP_MULTIPLY);
+    break;
+  case BANG_EQUAL:
+    emit(OP_NOT_EQUAL);
+    break;
+  case EQUAL_EQUAL:
+    emit(OP_EQUAL);
+    break;
+  default:
+    Lox::error(expr->op().line(), "Invalid operator for binary expression");
+    _hadError = true;
+  }
+}
+
+void Compiler::visitLiteral(const Expr::LiteralExpr *expr) {
+  const LoxType &value = expr->value();
+
+  if (value.empty())
+    emit(OP_NIL);
+  else if (value.isType<bool>())
+    emit(value.getValue<bool>() ? OP_TRUE : OP_FALSE);
+  else
+    emit(OP_CONSTANT, chunk().addConstant(value));
+}
+
+void Compiler::visitUnary(const Expr::UnaryExpr *expr) {
+  compile(expr->right());
+
+  switch (expr->op().type()) {
+  case MINUS:
+    emit(OP_NEGATE);
+    break;
+  case BANG:
+    emit(OP_NOT);
+    break;
+  default:
+    Lox::error(expr->op().line(), "Invalid operator to Unary expression");
+    _hadError = true;
+  }
+}
+
+void Compiler::visitGrouping(const Expr::GroupingExpr *expr) {
+  compile(expr->expr());
+}
+
+void Compiler::visitTernary(const Expr::TernaryExpr *expr) {
+  compile(expr->condition());
+  size_t elseJump = emitJump(OP_JUMP_IF_FALSE);
+  compile(expr->first());
+  size_t endJump = emitJump(OP_JUMP);
+  patchJump(elseJump);
+  // Only one of the branches runs.
+  adjust(-1);
+  compile(expr->second());
+  patchJump(endJump);
+}
+
+void Compiler::visitVariable(const Expr::VariableExpr *expr) {
+  emitGet(expr->local(), expr->name());
+}
+
+void Compiler::visitAssign(const Expr::AssignExpr *expr) {
+  compile(expr->value());
+  emitSet(expr->local(), expr->name());
+}
+
+// Both operators produce a bool rather than one of their operands.
+void Compiler::visitLogic(const Expr::LogicExpr *expr) {
+  compile(expr->first());
+  size_t endJump = emitJump(expr->op().type() == OR ? OP_JUMP_IF_TRUE_OR_POP
+                                                    : OP_JUMP_IF_FALSE_OR_POP);
+  compile(expr->second());
+  emit(OP_TRUTH);
+  patchJump(endJump);
+}
+
+void Compiler::visitCall(const Expr::CallExpr *expr) {
+  compile(expr->callee());
+  for (const Expr::Expr *arg : expr->arguments())
+    compile(arg);
+
+  // Calls report their errors at the token they carry, rather than one
+  // looked up by location on every call.
+  emit(OP_CALL, chunk().addToken(expr->paren()));
+  emitByte(expr->arguments().size());
+  adjust(-expr->arguments().size());
+}
+
+void Compiler::visitGet(const Expr::GetExpr *expr) {
+  compile(expr->object());
+  emit(OP_GET_PROPERTY, chunk().addToken(expr->name()));
+}
+
+void Compiler::visitSet(const Expr::SetExpr *expr) {
+  compile(expr->object());
+  compile(expr->value());
+  emit(OP_SET_PROPERTY, chunk().addToken(expr->name()));
+}
+
+void Compiler::visitThis(const Expr::ThisExpr *expr) {
+  emitGet(expr->local(), expr->keyword());
+}
+
+void Compiler::visitSuper(const Expr::SuperExpr *expr) {
+  compile(expr->self());
+  emitGet(expr->local(), expr->keyword());
+  emit(OP_GET_SUPER, chunk().addToken(expr->method()));
+}
+
+// Only the tree walker runs inlined bodies, the call is compiled instead.
+void Compiler::visitInline(const Expr::InlineExpr *expr) {
+  visitCall(expr->call());
+}
+
+void Compiler::compile(const Stmt::Stmt *stmt) { stmt->accept(this); }
+
+void Compiler::compile(const Expr::Expr *expr) { expr->accept(this); }
+
+FunctionCode Compiler::compileFunction(const Stmt::FunctionStmt *stmt) {
+  auto function = std::make_shared<Function>();
+  function->declaration = stmt;
+  function->info = stmt->info();
+  function->name = stmt->name();
+
+  Function *enclosing = _function;
+  int depth = _depth;
+  _function = function.get();
+  _depth = 0;
+
+  for (const Stmt::Stmt *statement : stmt->body())
+    compile(statement);
+  emit(OP_NIL);
+  emit(OP_RETURN);
+
+  _function = enclosing;
+  _depth = depth;
+
+  return {stmt, &function->info, function};
+}
+
+// How many operands each instruction pushes or pops. The arguments popped
+// by OP_CALL are accounted for by visitCall.
+static int stackEffect(OpCode op) {
+  switch (op) {
+  case OP_CONSTANT:
+  case OP_NIL:
+  case OP_TRUE:
+  case OP_FALSE:
+  case OP_GET_SLOT:
+  case OP_GET_CELL:
+  case OP_GET_UPVALUE:
+  case OP_GET_GLOBAL:
+  case OP_CLOSURE:
+  case OP_CLASS:
+    return 1;
+  case OP_POP:
+  case OP_DEFINE_SLOT:
+  case OP_DEFINE_CELL:
+  case OP_DEFINE_GLOBAL:
+  case OP_SET_PROPERTY:
+  case OP_GET_SUPER:
+  case OP_EQUAL:
+  case OP_NOT_EQUAL:
+  case OP_GREATER:
+  case OP_GREATER_EQUAL:
+  case OP_LESS:
+  case OP_LESS_EQUAL:
+  case OP_ADD:
+  case OP_SUBTRACT:
+  case OP_MULTIPLY:
+  case OP_DIVIDE:
+  case OP_JUMP_IF_FALSE:
+  // The operand is only kept when jumping.
+  case OP_JUMP_IF_TRUE_OR_POP:
+  case OP_JUMP_IF_FALSE_OR_POP:
+  case OP_PRINT:
+  case OP_RETURN:
+    return -1;
+  default:
+    return 0;
+  }
+}
+
+void Compiler::emit(OpCode op) {
+  chunk().write(op);
+  adjust(stackEffect(op));
+}
+
+void Compiler::emit(OpCode op, size_t index) {
+  emit(op);
+  chunk().write16(operand(index, _function->name));
+}
+
+void Compiler::emitByte(uint8_t byte) { chunk().write(byte); }
+
+void Compiler::adjust(int effect) {
+  _depth += effect;
+  _function->stack = std::max(_function->stack, _depth);
+}
+
+void Compiler::emitAt(const Token &token, OpCode op) {
+  chunk().addLocation(token);
+  emit(op);
+}
+
+size_t Compiler::emitJump(OpCode op) {
+  emit(op);
+  chunk().write16(0);
+  return chunk().size() - 2;
+}
+
+// Jumps are relative to the end of the jump instruction.
+void Compiler::patchJump(size_t offset) {
+  chunk().patch16(offset, operand(chunk().size() - offset - 2, _function->name));
+}
+
+void Compiler::emitLoop(size_t start) {
+  emit(OP_LOOP);
+  chunk().write16(operand(chunk().size() + 2 - start, _function->name));
+}
+
+void Compiler::emitGet(const Local *local, const Token &name) {
+  if (local == nullptr) {
+    emit(OP_GET_GLOBAL, chunk().addToken(name));
+    return;
+  }
+
+  switch (local->type) {
+  case Local::SLOT:
+    emit(OP_GET_SLOT, local->index);
+    break;
+  case Local::CELL:
+    emit(OP_GET_CELL, local->index);
+    break;
+  case Local::UPVALUE:
+    emit(OP_GET_UPVALUE, local->index);
+    break;
+  }
+}
+
+void Compiler::emitSet(const Local *local, const Token &name) {
+  if (local == nullptr) {
+    emit(OP_SET_GLOBAL, chunk().addToken(name));
+    return;
+  }
+
+  switch (local->type) {
+  case Local::SLOT:
+    emit(OP_SET_SLOT, local->index);
+    break;
+  case Local::CELL:
+    emit(OP_SET_CELL, local->index);
+    break;
+  case Local::UPVALUE:
+    emit(OP_SET_UPVALUE, local->index);
+    break;
+  }
+}
+
+void Compiler::emitDefine(const Local *local, const Token &name,
+                          bool declared) {
+  if (local == nullptr) {
+    emit(OP_DEFINE_GLOBAL, chunk().addToken(name));
+    return;
+  }
+
+  // Top level blocks use slots of the script, which are only known once
+  // all its declarations were compiled.
+  FunctionInfo &info = _function->info;
+  info.slots = std::max(info.slots, local->index + 1);
+
+  if (local->type == Local::SLOT) {
+    emit(OP_DEFINE_SLOT, local->index);
+  } else if (declared) {
+    emit(OP_SET_CELL, local->index);
+    emit(OP_POP);
+  } else {
+    info.hasCells = true;
+    emit(OP_DEFINE_CELL, local->index);
+  }
+}
+
+void Compiler::emitDeclare(const Local *local) {
+  if (local == nullptr || local->type != Local::CELL)
+    return;
+
+  _function->info.hasCells = true;
+  emit(OP_NIL);
+  emit(OP_DEFINE_CELL, local->index);
+}
+
+uint16_t Compiler::operand(size_t value, const Token &where) {
+  if (value > std::numeric_limits<uint16_t>::max()) {
+    Lox::error(where.line(), "Too much code or data in one function.");
+    _hadError = true;
+    return 0;
+  }
+
+  return value;
+}
+
+} // namespace Bytecode
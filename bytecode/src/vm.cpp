@@ -0,0 +1,451 @@
+#include <vm.h>
+#include <callables.h>
+#include <lox.h>
+#include <lox_class.h>
+#include <lox_function.h>
+#include <lox_instance.h>
+#include <native_func.h>
+#include <runtime_error.h>
+#include <upvalue.h>
+
+#include <iostream>
+
+namespace Bytecode {
+
+VM::VM()
+    : _stack(new LoxType[STACK_SLOTS]), _cells(new Upvalue *[STACK_SLOTS]()),
+      _sp(_stack.get()) {
+  _frames.reserve(MAX_FRAMES);
+  Heap::instance().addRootSource(this);
+
+  _globals = std::make_shared<Environment>();
+  _globals->define("clock", LoxType(Heap::instance().make<Clock>()));
+}
+
+VM::~VM() { Heap::instance().removeRootSource(this); }
+
+void VM::interpret(const std::vector<Stmt::Stmt *> &statements,
+                   const Interpreter &) {
+  Compiler compiler;
+  std::unique_ptr<Function> script = compiler.compile(statements);
+  if (script == nullptr)
+    return;
+
+  try {
+    LoxType *base = _stack.get();
+    if (script->info.slots + script->stack > (int)STACK_SLOTS)
+      throw RuntimeError(script->name, "Stack overflow.");
+
+    _sp = base + script->info.slots;
+    std::fill(base, _sp, LoxType());
+    _frames.push_back({script.get(), script->chunk.code(),
+                       Frame{base, _cells.get()}, LoxType(), nullptr, false});
+
+    run();
+  } catch (const RuntimeError &err) {
+    Lox::runtime_error(err);
+    reset();
+  }
+}
+
+void VM::run() {
+  Heap &heap = Heap::instance();
+  CallFrame *frame = &_frames.back();
+  const uint8_t *ip = frame->ip;
+  const Chunk *chunk = &frame->function->chunk;
+  LoxType *slots = frame->frame.slots;
+  // Kept in a local while running, _sp is only updated where calls,
+  // collections and returns need it.
+  LoxType *sp = _sp;
+
+  auto push = [&sp](const LoxType &value) { *sp++ = value; };
+  auto pop = [&sp]() { return std::move(*--sp); };
+  auto peek = [&sp](size_t distance = 0) -> LoxType & { return sp[-1 - distance]; };
+  auto read16 = [&ip]() {
+    uint16_t value = Chunk::read16(ip);
+    ip += 2;
+    return value;
+  };
+  // Binary operators check their right operand first, like the tree
+  // walker does.
+  auto numbers = [&]() {
+    if (!peek().isType<double>()) {
+      frame->ip = ip;
+      error("Operand must be a number.");
+    }
+  };
+  auto reload = [&]() {
+    frame = &_frames.back();
+    ip = frame->ip;
+    chunk = &frame->function->chunk;
+    slots = frame->frame.slots;
+  };
+
+  while (true) {
+    switch (static_cast<OpCode>(*ip++)) {
+    case OP_CONSTANT:
+      push(chunk->constant(read16()));
+      break;
+    case OP_NIL:
+      push(LoxType());
+      break;
+    case OP_TRUE:
+      push(true);
+      break;
+    case OP_FALSE:
+      push(false);
+      break;
+    case OP_POP:
+      sp--;
+      break;
+
+    case OP_GET_SLOT:
+      push(slots[read16()]);
+      break;
+    case OP_SET_SLOT:
+      slots[read16()] = peek();
+      break;
+    case OP_DEFINE_SLOT:
+      slots[read16()] = pop();
+      break;
+    case OP_GET_CELL:
+      push(frame->frame.cells[read16()]->get());
+      break;
+    case OP_SET_CELL:
+      frame->frame.cells[read16()]->set(peek());
+      break;
+    case OP_DEFINE_CELL:
+      frame->frame.cells[read16()] = heap.make<Upvalue>(pop());
+      break;
+    case OP_GET_UPVALUE:
+      push(frame->frame.upvalues[read16()]->get());
+      break;
+    case OP_SET_UPVALUE:
+      frame->frame.upvalues[read16()]->set(peek());
+      break;
+    // Globals are looked up once per instruction. A variable that is not
+    // defined yet, or holds nil, takes the slow path to report it.
+    case OP_GET_GLOBAL: {
+      size_t index = read16();
+      LoxType *&global = chunk->global(index);
+      if (global == nullptr)
+        global = _globals->find(chunk->token(index).symbol());
+      if (global == nullptr || global->empty())
+        push(_globals->get(chunk->token(index)));
+      else
+        push(*global);
+      break;
+    }
+    case OP_SET_GLOBAL: {
+      size_t index = read16();
+      LoxType *&global = chunk->global(index);
+      if (global == nullptr)
+        global = _globals->find(chunk->token(index).symbol());
+      if (global == nullptr)
+        _globals->assign(chunk->token(index), peek());
+      else
+        _globals->store(*global, peek());
+      break;
+    }
+    case OP_DEFINE_GLOBAL:
+      _globals->define(chunk->token(read16()).symbol(), pop());
+      break;
+
+    case OP_GET_PROPERTY: {
+      const Token &name = chunk->token(read16());
+      if (!peek().isType<LoxInstance *>())
+        throw RuntimeError(name, "Cannot get property of non-instance.");
+      peek() = peek().getValue<LoxInstance *>()->get(name);
+      break;
+    }
+    case OP_SET_PROPERTY: {
+      const Token &name = chunk->token(read16());
+      if (!peek(1).isType<LoxInstance *>())
+        throw RuntimeError(name, "Cannot set property of non-instance.");
+      LoxType value = pop();
+      peek().getValue<LoxInstance *>()->set(name, value);
+      peek() = value;
+      break;
+    }
+    case OP_GET_SUPER: {
+      const Token &name = chunk->token(read16());
+      LoxFunction *method = pop().getValue<LoxClass *>()->superMethod(name);
+      peek() = method->bind(peek().getValue<LoxInstance *>());
+      break;
+    }
+
+    case OP_EQUAL: {
+      bool equal = peek(1) == peek();
+      sp--;
+      peek() = equal;
+      break;
+    }
+    case OP_NOT_EQUAL: {
+      bool equal = peek(1) == peek();
+      sp--;
+      peek() = !equal;
+      break;
+    }
+    case OP_GREATER: {
+      numbers();
+      bool result = peek(1).getValue<double>() > peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_GREATER_EQUAL: {
+      numbers();
+      bool result = peek(1).getValue<double>() >= peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_LESS: {
+      numbers();
+      bool result = peek(1).getValue<double>() < peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_LESS_EQUAL: {
+      numbers();
+      bool result = peek(1).getValue<double>() <= peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_ADD: {
+      LoxType &left = peek(1), &right = peek();
+      if (left.isType<double>() && right.isType<double>()) {
+        left = left.getValue<double>() + right.getValue<double>();
+      } else if (left.isType<std::string>() && right.isType<std::string>()) {
+        left = LoxType::concat(left, right);
+      } else {
+        frame->ip = ip;
+        error("Operands must both be numbers or strings");
+      }
+      sp--;
+      break;
+    }
+    case OP_SUBTRACT: {
+      numbers();
+      double result = peek(1).getValue<double>() - peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_MULTIPLY: {
+      double result = peek(1).getValue<double>() * peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_DIVIDE: {
+      if (peek().getValue<double>() == 0) {
+        frame->ip = ip;
+        error("Division by Zero");
+      }
+      double result = peek(1).getValue<double>() / peek().getValue<double>();
+      sp--;
+      peek() = result;
+      break;
+    }
+    case OP_NOT:
+      peek() = !Interpreter::isTruthyVal(peek());
+      break;
+    case OP_NEGATE:
+      peek() = -peek().getValue<double>();
+      break;
+    case OP_TRUTH:
+      peek() = Interpreter::isTruthyVal(peek());
+      break;
+
+    case OP_JUMP: {
+      uint16_t offset = read16();
+      ip += offset;
+      break;
+    }
+    case OP_JUMP_IF_FALSE: {
+      uint16_t offset = read16();
+      if (!Interpreter::isTruthyVal(pop()))
+        ip += offset;
+      break;
+    }
+    case OP_JUMP_IF_TRUE_OR_POP: {
+      uint16_t offset = read16();
+      if (Interpreter::isTruthyVal(peek())) {
+        peek() = true;
+        ip += offset;
+      } else {
+        sp--;
+      }
+      break;
+    }
+    case OP_JUMP_IF_FALSE_OR_POP: {
+      uint16_t offset = read16();
+      if (!Interpreter::isTruthyVal(peek())) {
+        peek() = false;
+        ip += offset;
+      } else {
+        sp--;
+      }
+      break;
+    }
+    // Backward jumps and calls are the collector's safepoints, every value
+    // is on the stack there.
+    case OP_LOOP: {
+      uint16_t offset = read16();
+      ip -= offset;
+      if (heap.shouldCollect()) {
+        frame->ip = ip;
+        _sp = sp;
+        heap.collect();
+      }
+      break;
+    }
+
+    case OP_PRINT:
+      std::cout << pop() << std::endl;
+      break;
+
+    case OP_CALL: {
+      const Token &paren = chunk->token(read16());
+      size_t argc = *ip++;
+      frame->ip = ip;
+      _sp = sp;
+      if (heap.shouldCollect())
+        heap.collect();
+
+      call(argc, paren);
+      sp = _sp;
+      reload();
+      break;
+    }
+    case OP_CLOSURE: {
+      push(makeFunction(chunk->function(read16()), frame->frame));
+      break;
+    }
+    case OP_CLASS: {
+      const ClassInfo &info = chunk->classInfo(read16());
+      LoxClass *superclass = nullptr;
+      if (info.superclass)
+        superclass = superclassOf(pop(), *info.superclass);
+      push(makeClass(info.name, superclass, info.methods, frame->frame));
+      break;
+    }
+
+    case OP_RETURN: {
+      LoxType result = pop();
+      if (frame->initializer)
+        result = slots[0];
+      if (frame->function->info.hasCells) {
+        std::fill(frame->frame.cells,
+                  frame->frame.cells + frame->function->info.slots, nullptr);
+      }
+
+      LoxType *destination = frame->result;
+      _frames.pop_back();
+      if (_frames.empty()) {
+        _sp = _stack.get();
+        return;
+      }
+
+      sp = destination;
+      push(std::move(result));
+      reload();
+      break;
+    }
+    }
+  }
+}
+
+// Calls the value below the arguments on top of the stack. Its slot
+// receives the result.
+void VM::call(size_t argc, const Token &paren) {
+  LoxType *callee = _sp - argc - 1;
+  CallCache::Entry target = callTarget(*callee, paren);
+  checkArity(target.arity, argc, paren);
+
+  if (target.kind == CallCache::Kind::FUNCTION) {
+    callFunction(target.function, target.function->receiver(), callee, false);
+  } else if (target.kind == CallCache::Kind::CLASS) {
+    LoxType instance = Heap::instance().make<LoxInstance>(
+        static_cast<LoxClass *>(target.callable));
+
+    if (target.function != nullptr) {
+      callFunction(target.function, instance, callee, true);
+    } else {
+      _sp = callee;
+      push(instance);
+    }
+  } else {
+    // Native functions do not use the interpreter.
+    LoxType result =
+        target.callable->call(nullptr, std::span<const LoxType>(callee + 1, argc));
+    _sp = callee;
+    push(result);
+  }
+}
+
+// Pushes the frame of a call. The arguments already sit in the slots of the
+// parameters, after the callee's slot, which methods use for `this`.
+void VM::callFunction(const LoxFunction *function, const LoxType &receiver,
+                      LoxType *result, bool initializer) {
+  auto compiled = static_cast<const Function *>(function->compiled());
+  const FunctionInfo &info = compiled->info;
+  LoxType *base = info.method ? result : result + 1;
+
+  if (_frames.size() == MAX_FRAMES ||
+      base + info.slots + compiled->stack > _stack.get() + STACK_SLOTS)
+    throw RuntimeError(compiled->name, "Stack overflow.");
+
+  // The callee keeps the upvalues alive, methods overwrite it with their
+  // receiver.
+  LoxType callee = *result;
+  if (info.method)
+    base[0] = receiver;
+
+  _sp = base + info.slots;
+  std::fill(base + info.params.size(), _sp, LoxType());
+
+  Frame frame{base, _cells.get() + (base - _stack.get()), function->upvalues()};
+  if (info.hasCells) {
+    for (size_t i = 0; i < info.params.size(); i++) {
+      if (info.params[i].type == Local::CELL)
+        frame.cells[i] = Heap::instance().make<Upvalue>(base[i]);
+    }
+  }
+
+  _frames.push_back({compiled, compiled->chunk.code(), frame, std::move(callee),
+                     result, initializer});
+}
+
+void VM::markRoots(Heap &heap) {
+  heap.mark(_globals.get());
+
+  for (LoxType *slot = _stack.get(); slot < _sp; slot++)
+    heap.mark(*slot);
+  for (Upvalue **cell = _cells.get(); cell < _cells.get() + (_sp - _stack.get()); cell++)
+    heap.mark(*cell);
+  for (CallFrame &frame : _frames)
+    heap.mark(frame.callee);
+}
+
+void VM::error(const char *message) { throw RuntimeError(location(), message); }
+
+// The frame's ip has been saved past the failing instruction's opcode.
+const Token &VM::location() const {
+  const CallFrame &frame = _frames.back();
+  const Chunk &chunk = frame.function->chunk;
+  return chunk.tokenAt(frame.ip - chunk.code() - 1);
+}
+
+// Unwinds every call after a runtime error.
+void VM::reset() {
+  std::fill(_stack.get(), _sp, LoxType());
+  std::fill(_cells.get(), _cells.get() + (_sp - _stack.get()), nullptr);
+  _sp = _stack.get();
+  _frames.clear();
+}
+
+} // namespace Bytecode
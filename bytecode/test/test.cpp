@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <chunk.h>
+#include <interpreter.h>
+#include <parser.h>
+#include <resolver.h>
+#include <tokenizer.h>
+#include <vm.h>
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace Bytecode;
+
+namespace {
+
+// Runs source on a VM and returns what it printed, runtime errors
+// included.
+std::string run(const std::string &source) {
+  Tokenizer tokenizer{source};
+  Parser parser{tokenizer.getTokens()};
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
+  Interpreter resolution;
+  Resolver(resolution).resolve(unit->statements());
+
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+  VM().interpret(unit->statements(), resolution);
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+} // namespace
+
+TEST(ChunkTest, OperandsRoundTrip) {
+  Chunk chunk;
+  chunk.write(OP_CONSTANT);
+  chunk.write16(0xbeef);
+  chunk.write(OP_JUMP);
+  chunk.write16(0);
+  chunk.patch16(4, 513);
+
+  EXPECT_EQ(chunk.size(), 6u);
+  EXPECT_EQ(Chunk::read16(chunk.code() + 1), 0xbeef);
+  EXPECT_EQ(Chunk::read16(chunk.code() + 4), 513);
+}
+
+TEST(ChunkTest, ConstantsAreShared) {
+  Chunk chunk;
+  size_t one = chunk.addConstant(LoxType(1.0));
+  size_t lox = chunk.addConstant(LoxType(std::string("lox")));
+
+  EXPECT_EQ(chunk.addConstant(LoxType(1.0)), one);
+  EXPECT_EQ(chunk.addConstant(LoxType(std::string("lox"))), lox);
+  EXPECT_NE(one, lox);
+}
+
+TEST(ChunkTest, InstructionsMapToTheirToken) {
+  Chunk chunk;
+  Token plus(PLUS, "+", LoxType(), 1);
+  Token paren(RIGHT_PAREN, ")", LoxType(), 2);
+
+  chunk.write(OP_NIL);
+  chunk.addLocation(plus);
+  chunk.write(OP_ADD);
+  chunk.write(OP_NIL);
+  chunk.addLocation(paren);
+  chunk.write(OP_CALL);
+  chunk.write(0);
+
+  EXPECT_EQ(chunk.tokenAt(1).line(), 1u);
+  EXPECT_EQ(chunk.tokenAt(4).line(), 2u);
+  EXPECT_EQ(chunk.tokenAt(5).line(), 2u);
+}
+
+TEST(VMTest, CallsFunctions) {
+  EXPECT_EQ(run("fun add(a, b) { return a + b; }\n"
+                "print add(1, 2);\n"),
+            "3.000000\n");
+  EXPECT_EQ(run("fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+                "print fib(15);\n"),
+            "610.000000\n");
+  EXPECT_EQ(run("fun f() {}\n"
+                "print f();\n"),
+            "nil\n");
+}
+
+TEST(VMTest, ClosuresCaptureVariables) {
+  EXPECT_EQ(run("fun counter() {\n"
+                "  var n = 0;\n"
+                "  fun next() { n = n + 1; return n; }\n"
+                "  return next;\n"
+                "}\n"
+                "var a = counter();\n"
+                "var b = counter();\n"
+                "a(); a();\n"
+                "print a();\n"
+                "print b();\n"),
+            "3.000000\n1.000000\n");
+  // The innermost function captures n through the function between them.
+  EXPECT_EQ(run("fun outer(n) {\n"
+                "  fun middle() { fun inner() { return n; } return inner; }\n"
+                "  n = 7;\n"
+                "  return middle();\n"
+                "}\n"
+                "print outer(1)();\n"),
+            "7.000000\n");
+}
+
+TEST(VMTest, ClassesRunInitializersAndMethods) {
+  EXPECT_EQ(run("class Point {\n"
+                "  init(x, y) { this.x = x; this.y = y; }\n"
+                "  sum() { return this.x + this.y; }\n"
+                "}\n"
+                "var p = Point(1, 2);\n"
+                "print p.sum();\n"
+                "print Point(3, 4).x;\n"),
+            "3.000000\n3.000000\n");
+  EXPECT_EQ(run("class A { name() { return \"A\"; } }\n"
+                "class B < A { name() { return \"B\" + super.name(); } }\n"
+                "print B().name();\n"),
+            "BA\n");
+}
+
+TEST(VMTest, RuntimeErrorsReportTheirLine) {
+  EXPECT_EQ(run("print 1;\n"
+                "\n"
+                "print 1 + nil;\n"
+                "print 2;\n"),
+            "1.000000\n"
+            "Runtime Error. Operator + : Operands must both be numbers or strings\n"
+            "[line 3]\n");
+  // An error in a function reports the line in its body, not the call's.
+  EXPECT_EQ(run("fun f(n) {\n"
+                "  return n - nil;\n"
+                "}\n"
+                "f(1);\n"),
+            "Runtime Error. Operator - : Operand must be a number.\n"
+            "[line 2]\n");
+  EXPECT_EQ(run("fun f(a) {}\n"
+                "f(\n"
+                "  1, 2);\n"),
+            "Runtime Error. Operator ) : Expected 1 arguments but got 2.\n"
+            "[line 3]\n");
+  EXPECT_EQ(run("var A = 1;\n"
+                "class B < A {}\n"),
+            "Runtime Error. Operator A : Superclass must be a class.\n"
+            "[line 2]\n");
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <callables.h>
+#include <expression_visitor.h>
+#include <interpreter.h>
+#include <node.h>
+#include <stmt_visitor.h>
+
+#include <memory>
+#include <vector>
+
+namespace Closure {
+
+// Translates resolved syntax trees to nodes. Each node is built with the
+// nodes of its children and where its variables live, as the Resolver laid
+// them out, so the Engine's frames look like the tree walker's.
+class Compiler : public Expr::ExprVisitor, public Stmt::StmtVisitor {
+public:
+  // Compiles top level code, and every function declared in it. Returns
+  // nullptr if it has an operator no node exists for.
+  std::unique_ptr<Function> compile(const std::vector<Stmt::Stmt *> &);
+
+  void visitExprStmt(const Stmt::ExprStmt *) override;
+  void visitPrintStmt(const Stmt::PrintStmt *) override;
+  void visitVarStmt(const Stmt::VarStmt *) override;
+  void visitBlock(const Stmt::Block *) override;
+  void visitIfStmt(const Stmt::IfStmt *) override;
+  void visitWhileStmt(const Stmt::WhileStmt *) override;
+  void visitForStmt(const Stmt::ForStmt *) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override;
+  void visitReturnStmt(const Stmt::ReturnStmt *) override;
+  void visitClassStmt(const Stmt::ClassStmt *) override;
+
+  void visitBinary(const Expr::BinaryExpr *) override;
+  void visitLiteral(const Expr::LiteralExpr *) override;
+  void visitUnary(const Expr::UnaryExpr *) override;
+  void visitGrouping(const Expr::GroupingExpr *) override;
+  void visitTernary(const Expr::TernaryExpr *) override;
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitAssign(const Expr::AssignExpr *) override;
+  void visitLogic(const Expr::LogicExpr *) override;
+  void visitCall(const Expr::CallExpr *) override;
+  void visitGet(const Expr::GetExpr *) override;
+  void visitSet(const Expr::SetExpr *) override;
+  void visitThis(const Expr::ThisExpr *) override;
+  void visitSuper(const Expr::SuperExpr *) override;
+  void visitInline(const Expr::InlineExpr *) override;
+
+private:
+  const Statement *compile(const Stmt::Stmt *);
+  const Expression *compile(const Expr::Expr *);
+  // Compiles an expression, and tells whether it contains a call.
+  const Expression *compile(const Expr::Expr *, bool &calls);
+  FunctionCode compileFunction(const Stmt::FunctionStmt *);
+
+  template <typename T, typename... Args> const T *make(Args &&...args) {
+    return _function->nodes.make<T>(std::forward<Args>(args)...);
+  }
+  template <typename Op> void binary(const Expr::BinaryExpr *);
+
+  const Expression *get(const Local *, const Token &);
+  const Expression *set(const Local *, const Token &, const Expression *);
+  // Functions and classes may capture themselves, so captured ones get
+  // their cell before they are created.
+  const Statement *define(const Local *, const Token &, const Expression *,
+                          bool declared = false);
+
+  void error(const Token &, const char *);
+
+  Function *_function = nullptr;
+  const Expression *_expression = nullptr;
+  const Statement *_statement = nullptr;
+  // Calls compiled so far.
+  size_t _calls = 0;
+  bool _hadError = false;
+};
+
+} // namespace Closure
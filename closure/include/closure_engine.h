@@ -0,0 +1,65 @@
+#pragma once
+
+#include <call_stack.h>
+#include <environment.h>
+#include <heap.h>
+#include <interpreter.h>
+#include <node.h>
+
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Closure {
+
+// Runs syntax trees compiled to nodes (see Expression). Frames and values
+// are laid out like the tree walker's, the nodes only skip the dispatch on
+// node and operator types and the lookups of where variables live.
+class Engine : public RootSource {
+public:
+  Engine();
+  ~Engine();
+
+  // Compiles and runs resolved top level code. The Interpreter that
+  // resolved it provides the layout of its variables.
+  void interpret(const std::vector<Stmt::Stmt *> &, const Interpreter &);
+
+  void markRoots(Heap &) override;
+
+  // What the compiled nodes run on.
+  CallStack &stack() { return _stack; }
+  Environment &globals() { return *_globals; }
+
+  LoxType call(const LoxType &callee, std::span<const LoxType> args,
+               const Token &paren);
+  // Calls a method on a receiver, without binding it first.
+  LoxType callMethod(const LoxFunction *, const LoxType &receiver,
+                     std::span<const LoxType> args, const Token &paren);
+
+  // Runs the statements of a block or function body, stopping at a return.
+  Completion run(const std::vector<const Statement *> &, Frame &);
+  // Holds the returned value until the call that is returning takes it.
+  Completion complete(LoxType value) {
+    _value = std::move(value);
+    return Completion::RETURN;
+  }
+
+  // Statement boundaries are the collector's safepoints, like in the tree
+  // walker. Nodes root what they hold while running statements.
+  static void safepoint() {
+    Heap &heap = Heap::instance();
+    if (heap.shouldCollect())
+      heap.collect();
+  }
+
+private:
+  LoxType invoke(const LoxFunction *, const LoxType &receiver,
+                 std::span<const LoxType> args);
+
+  LoxType _value;
+  std::shared_ptr<Environment> _globals;
+  CallStack _stack;
+};
+
+} // namespace Closure
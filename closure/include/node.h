@@ -0,0 +1,45 @@
+#pragma once
+
+#include <arena.h>
+#include <completion.h>
+#include <frame.h>
+#include <lox_function.h>
+#include <lox_type.h>
+#include <resolution.h>
+#include <stmt.h>
+#include <token.h>
+
+#include <memory>
+#include <vector>
+
+namespace Closure {
+
+class Engine;
+
+// A syntax tree node compiled to an object that evaluates itself. Operators,
+// variable locations and children are bound when it is compiled, so running
+// it is a chain of direct calls that mirrors the shape of the tree.
+class Expression {
+public:
+  virtual ~Expression() = default;
+  virtual LoxType eval(Engine &, Frame &) const = 0;
+};
+
+class Statement {
+public:
+  virtual ~Statement() = default;
+  virtual Completion exec(Engine &, Frame &) const = 0;
+};
+
+// A compiled function declaration, or the top level code of a script. The
+// nodes of its body live in its arena; nested functions have their own, and
+// are owned by the nodes creating them and by the LoxFunctions created.
+struct Function : CompiledFunction {
+  const Stmt::FunctionStmt *declaration = nullptr;
+  FunctionInfo info;
+  Token name{END_OF_FILE, ""};
+  std::vector<const Statement *> body;
+  Arena nodes;
+};
+
+} // namespace Closure
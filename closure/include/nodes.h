@@ -0,0 +1,690 @@
+#pragma once
+
+#include <callables.h>
+#include <closure_engine.h>
+#include <heap.h>
+#include <lox_instance.h>
+#include <node.h>
+#include <runtime_error.h>
+#include <upvalue.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The node types the Compiler builds. There is one per operator and per kind
+// of variable, so that nothing is decided again when a node runs.
+namespace Closure {
+
+class Constant : public Expression {
+public:
+  explicit Constant(LoxType value) : _value(std::move(value)) {}
+  LoxType eval(Engine &, Frame &) const override { return _value; }
+
+private:
+  LoxType _value;
+};
+
+// Variables, where the Resolver put them.
+
+class GetSlot : public Expression {
+public:
+  explicit GetSlot(int index) : _index(index) {}
+  LoxType eval(Engine &, Frame &frame) const override {
+    return frame.slots[_index];
+  }
+
+private:
+  int _index;
+};
+
+class GetCell : public Expression {
+public:
+  explicit GetCell(int index) : _index(index) {}
+  LoxType eval(Engine &, Frame &frame) const override {
+    return frame.cells[_index]->get();
+  }
+
+private:
+  int _index;
+};
+
+class GetUpvalue : public Expression {
+public:
+  explicit GetUpvalue(int index) : _index(index) {}
+  LoxType eval(Engine &, Frame &frame) const override {
+    return frame.upvalues[_index]->get();
+  }
+
+private:
+  int _index;
+};
+
+// Globals are looked up the first time the node runs. A variable that is
+// not defined yet, or holds nil, takes the slow path to report it.
+class GetGlobal : public Expression {
+public:
+  explicit GetGlobal(const Token &name) : _name(name) {}
+  LoxType eval(Engine &engine, Frame &) const override {
+    if (_global == nullptr)
+      _global = engine.globals().find(_name.symbol());
+    if (_global == nullptr || _global->empty())
+      return engine.globals().get(_name);
+    return *_global;
+  }
+
+private:
+  Token _name;
+  mutable LoxType *_global = nullptr;
+};
+
+class SetSlot : public Expression {
+public:
+  SetSlot(int index, const Expression *value) : _index(index), _value(value) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    return frame.slots[_index] = _value->eval(engine, frame);
+  }
+
+private:
+  int _index;
+  const Expression *_value;
+};
+
+class SetCell : public Expression {
+public:
+  SetCell(int index, const Expression *value) : _index(index), _value(value) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType value = _value->eval(engine, frame);
+    frame.cells[_index]->set(value);
+    return value;
+  }
+
+private:
+  int _index;
+  const Expression *_value;
+};
+
+class SetUpvalue : public Expression {
+public:
+  SetUpvalue(int index, const Expression *value) : _index(index), _value(value) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType value = _value->eval(engine, frame);
+    frame.upvalues[_index]->set(value);
+    return value;
+  }
+
+private:
+  int _index;
+  const Expression *_value;
+};
+
+class SetGlobal : public Expression {
+public:
+  SetGlobal(const Token &name, const Expression *value)
+      : _name(name), _value(value) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType value = _value->eval(engine, frame);
+    if (_global == nullptr)
+      _global = engine.globals().find(_name.symbol());
+    if (_global == nullptr)
+      engine.globals().assign(_name, value);
+    else
+      engine.globals().store(*_global, value);
+    return value;
+  }
+
+private:
+  Token _name;
+  const Expression *_value;
+  mutable LoxType *_global = nullptr;
+};
+
+// Operators.
+
+class Negate : public Expression {
+public:
+  explicit Negate(const Expression *operand) : _operand(operand) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    return -_operand->eval(engine, frame).getValue<double>();
+  }
+
+private:
+  const Expression *_operand;
+};
+
+class Not : public Expression {
+public:
+  explicit Not(const Expression *operand) : _operand(operand) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    return !Interpreter::isTruthyVal(_operand->eval(engine, frame));
+  }
+
+private:
+  const Expression *_operand;
+};
+
+// Binary operators check their right operand first, like the tree walker.
+inline void checkNumber(const LoxType &operand, const Token &op) {
+  if (!operand.isType<double>())
+    throw RuntimeError(op, "Operand must be a number.");
+}
+
+struct Greater {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    checkNumber(right, op);
+    return left.getValue<double>() > right.getValue<double>();
+  }
+};
+
+struct GreaterEqual {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    checkNumber(right, op);
+    return left.getValue<double>() >= right.getValue<double>();
+  }
+};
+
+struct Less {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    checkNumber(right, op);
+    return left.getValue<double>() < right.getValue<double>();
+  }
+};
+
+struct LessEqual {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    checkNumber(right, op);
+    return left.getValue<double>() <= right.getValue<double>();
+  }
+};
+
+struct Subtract {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    checkNumber(right, op);
+    return left.getValue<double>() - right.getValue<double>();
+  }
+};
+
+struct Add {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    if (left.isType<double>() && right.isType<double>())
+      return left.getValue<double>() + right.getValue<double>();
+    if (left.isType<std::string>() && right.isType<std::string>())
+      return LoxType::concat(left, right);
+    throw RuntimeError(op, "Operands must both be numbers or strings");
+  }
+};
+
+struct Multiply {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &) {
+    return left.getValue<double>() * right.getValue<double>();
+  }
+};
+
+struct Divide {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &op) {
+    if (right.getValue<double>() == 0)
+      throw RuntimeError(op, "Division by Zero");
+    return left.getValue<double>() / right.getValue<double>();
+  }
+};
+
+struct Equal {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &) {
+    return left == right;
+  }
+};
+
+struct NotEqual {
+  static LoxType apply(const LoxType &left, const LoxType &right, const Token &) {
+    return !(left == right);
+  }
+};
+
+// The left operand only needs to be rooted when the right one contains a
+// call, which may reach a safepoint.
+template <typename Op> class Binary : public Expression {
+public:
+  Binary(const Expression *left, const Expression *right, const Token &op,
+         bool protect)
+      : _left(left), _right(right), _op(op), _protect(protect) {}
+
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType left = _left->eval(engine, frame);
+    if (!_protect)
+      return Op::apply(left, _right->eval(engine, frame), _op);
+
+    RootGuard guard(&left);
+    LoxType right = _right->eval(engine, frame);
+    return Op::apply(left, right, _op);
+  }
+
+private:
+  const Expression *_left;
+  const Expression *_right;
+  Token _op;
+  bool _protect;
+};
+
+class Or : public Expression {
+public:
+  Or(const Expression *first, const Expression *second)
+      : _first(first), _second(second) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    if (Interpreter::isTruthyVal(_first->eval(engine, frame)))
+      return true;
+    return Interpreter::isTruthyVal(_second->eval(engine, frame));
+  }
+
+private:
+  const Expression *_first;
+  const Expression *_second;
+};
+
+class And : public Expression {
+public:
+  And(const Expression *first, const Expression *second)
+      : _first(first), _second(second) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    if (!Interpreter::isTruthyVal(_first->eval(engine, frame)))
+      return false;
+    return Interpreter::isTruthyVal(_second->eval(engine, frame));
+  }
+
+private:
+  const Expression *_first;
+  const Expression *_second;
+};
+
+class Ternary : public Expression {
+public:
+  Ternary(const Expression *condition, const Expression *first,
+          const Expression *second)
+      : _condition(condition), _first(first), _second(second) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    if (Interpreter::isTruthyVal(_condition->eval(engine, frame)))
+      return _first->eval(engine, frame);
+    return _second->eval(engine, frame);
+  }
+
+private:
+  const Expression *_condition;
+  const Expression *_first;
+  const Expression *_second;
+};
+
+// Calls, functions and objects.
+
+// The arguments are evaluated straight into the slots of the callee's
+// frame, after a slot for the receiver of a method.
+class Call : public Expression {
+public:
+  Call(const Expression *callee, std::vector<const Expression *> arguments,
+       const Token &paren)
+      : _callee(callee), _arguments(std::move(arguments)), _paren(paren) {}
+
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType callee = _callee->eval(engine, frame);
+    RootGuard calleeGuard(&callee);
+
+    CallStack &stack = engine.stack();
+    CallStack::Guard guard(stack);
+    stack.push(LoxType(), _paren);
+    std::span<const LoxType> args(stack.top(), _arguments.size());
+    for (const Expression *argument : _arguments)
+      stack.push(argument->eval(engine, frame), _paren);
+
+    return engine.call(callee, args, _paren);
+  }
+
+private:
+  const Expression *_callee;
+  std::vector<const Expression *> _arguments;
+  Token _paren;
+};
+
+// A method call, obj.name(args), that passes the object as the receiver
+// instead of binding the method to it.
+class Invoke : public Expression {
+public:
+  Invoke(const Expression *object, const Token &name,
+         std::vector<const Expression *> arguments, const Token &paren)
+      : _object(object), _name(name), _arguments(std::move(arguments)),
+        _paren(paren) {}
+
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType object = _object->eval(engine, frame);
+    if (!object.isType<LoxInstance *>())
+      throw RuntimeError(_name, "Cannot get property of non-instance.");
+
+    LoxInstance *instance = object.getValue<LoxInstance *>();
+    LoxFunction *method = instance->method(_name, _cache);
+    LoxType callee;
+    if (method == nullptr)
+      callee = instance->get(_name, _cache);
+    RootGuard calleeGuard(&callee);
+
+    CallStack &stack = engine.stack();
+    CallStack::Guard guard(stack);
+    LoxType *receiver = stack.top();
+    stack.push(object, _paren);
+    std::span<const LoxType> args(stack.top(), _arguments.size());
+    for (const Expression *argument : _arguments)
+      stack.push(argument->eval(engine, frame), _paren);
+
+    if (method == nullptr)
+      return engine.call(callee, args, _paren);
+    return engine.callMethod(method, *receiver, args, _paren);
+  }
+
+private:
+  const Expression *_object;
+  Token _name;
+  std::vector<const Expression *> _arguments;
+  Token _paren;
+  mutable PropertyCache _cache;
+};
+
+// super.name(args), invoked on this without binding the method.
+class InvokeSuper : public Expression {
+public:
+  InvokeSuper(const Expression *superclass, const Expression *self,
+              const Token &name, std::vector<const Expression *> arguments,
+              const Token &paren)
+      : _superclass(superclass), _self(self), _name(name),
+        _arguments(std::move(arguments)), _paren(paren) {}
+
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxFunction *method = _superclass->eval(engine, frame)
+                              .getValue<LoxClass *>()
+                              ->superMethod(_name);
+
+    CallStack &stack = engine.stack();
+    CallStack::Guard guard(stack);
+    LoxType *receiver = stack.top();
+    stack.push(_self->eval(engine, frame), _paren);
+    std::span<const LoxType> args(stack.top(), _arguments.size());
+    for (const Expression *argument : _arguments)
+      stack.push(argument->eval(engine, frame), _paren);
+
+    return engine.callMethod(method, *receiver, args, _paren);
+  }
+
+private:
+  const Expression *_superclass;
+  const Expression *_self;
+  Token _name;
+  std::vector<const Expression *> _arguments;
+  Token _paren;
+};
+
+class MakeFunction : public Expression {
+public:
+  explicit MakeFunction(FunctionCode function)
+      : _function(std::move(function)) {}
+  LoxType eval(Engine &, Frame &frame) const override {
+    return makeFunction(_function, frame);
+  }
+
+private:
+  FunctionCode _function;
+};
+
+class MakeClass : public Expression {
+public:
+  // superclass is nullptr unless the class has one, named by superName.
+  MakeClass(std::string name, const Expression *superclass,
+            const Token &superName,
+            std::vector<FunctionCode> methods)
+      : _name(std::move(name)), _superclass(superclass), _superName(superName),
+        _methods(std::move(methods)) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxClass *superclass = nullptr;
+    if (_superclass != nullptr)
+      superclass = superclassOf(_superclass->eval(engine, frame), _superName);
+    return makeClass(_name, superclass, _methods, frame);
+  }
+
+private:
+  std::string _name;
+  const Expression *_superclass;
+  Token _superName;
+  std::vector<FunctionCode> _methods;
+};
+
+class Super : public Expression {
+public:
+  Super(const Expression *superclass, const Expression *self, const Token &name)
+      : _superclass(superclass), _self(self), _name(name) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxFunction *method = _superclass->eval(engine, frame)
+                              .getValue<LoxClass *>()
+                              ->superMethod(_name);
+    return method->bind(_self->eval(engine, frame).getValue<LoxInstance *>());
+  }
+
+private:
+  const Expression *_superclass;
+  const Expression *_self;
+  Token _name;
+};
+
+class Get : public Expression {
+public:
+  Get(const Expression *object, const Token &name)
+      : _object(object), _name(name) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType object = _object->eval(engine, frame);
+    if (!object.isType<LoxInstance *>())
+      throw RuntimeError(_name, "Cannot get property of non-instance.");
+    return object.getValue<LoxInstance *>()->get(_name, _cache);
+  }
+
+private:
+  const Expression *_object;
+  Token _name;
+  mutable PropertyCache _cache;
+};
+
+class Set : public Expression {
+public:
+  Set(const Expression *object, const Token &name, const Expression *value,
+      bool protect)
+      : _object(object), _name(name), _value(value), _protect(protect) {}
+  LoxType eval(Engine &engine, Frame &frame) const override {
+    LoxType object = _object->eval(engine, frame);
+    if (!object.isType<LoxInstance *>())
+      throw RuntimeError(_name, "Cannot set property of non-instance.");
+
+    LoxType value;
+    if (_protect) {
+      RootGuard guard(&object);
+      value = _value->eval(engine, frame);
+    } else {
+      value = _value->eval(engine, frame);
+    }
+    object.getValue<LoxInstance *>()->set(_name, value, _cache);
+    return value;
+  }
+
+private:
+  const Expression *_object;
+  Token _name;
+  const Expression *_value;
+  bool _protect;
+  mutable PropertyCache _cache;
+};
+
+// Statements.
+
+class Evaluate : public Statement {
+public:
+  explicit Evaluate(const Expression *expr) : _expr(expr) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    _expr->eval(engine, frame);
+    return Completion::NORMAL;
+  }
+
+private:
+  const Expression *_expr;
+};
+
+class Print : public Statement {
+public:
+  explicit Print(const Expression *expr) : _expr(expr) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    std::cout << _expr->eval(engine, frame) << std::endl;
+    return Completion::NORMAL;
+  }
+
+private:
+  const Expression *_expr;
+};
+
+class DefineSlot : public Statement {
+public:
+  DefineSlot(int index, const Expression *init) : _index(index), _init(init) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    frame.slots[_index] = _init != nullptr ? _init->eval(engine, frame) : LoxType();
+    return Completion::NORMAL;
+  }
+
+private:
+  int _index;
+  const Expression *_init;
+};
+
+// A captured variable gets a new cell every time it is declared.
+class DefineCell : public Statement {
+public:
+  DefineCell(int index, const Expression *init) : _index(index), _init(init) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    LoxType value = _init != nullptr ? _init->eval(engine, frame) : LoxType();
+    frame.cells[_index] = Heap::instance().make<Upvalue>(value);
+    return Completion::NORMAL;
+  }
+
+private:
+  int _index;
+  const Expression *_init;
+};
+
+// Functions and classes may capture themselves, so their cell is created
+// before they are.
+class DeclareCell : public Statement {
+public:
+  DeclareCell(int index, const Expression *init) : _index(index), _init(init) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    frame.cells[_index] = Heap::instance().make<Upvalue>();
+    LoxType value = _init->eval(engine, frame);
+    frame.cells[_index]->set(value);
+    return Completion::NORMAL;
+  }
+
+private:
+  int _index;
+  const Expression *_init;
+};
+
+class DefineGlobal : public Statement {
+public:
+  DefineGlobal(const Token &name, const Expression *init)
+      : _name(name), _init(init) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    LoxType value = _init != nullptr ? _init->eval(engine, frame) : LoxType();
+    engine.globals().define(_name.symbol(), value);
+    return Completion::NORMAL;
+  }
+
+private:
+  Token _name;
+  const Expression *_init;
+};
+
+class Block : public Statement {
+public:
+  explicit Block(std::vector<const Statement *> statements)
+      : _statements(std::move(statements)) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    return engine.run(_statements, frame);
+  }
+
+private:
+  std::vector<const Statement *> _statements;
+};
+
+class If : public Statement {
+public:
+  If(const Expression *condition, const Statement *thenBranch,
+     const Statement *elseBranch)
+      : _condition(condition), _then(thenBranch), _else(elseBranch) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    if (Interpreter::isTruthyVal(_condition->eval(engine, frame)))
+      return _then->exec(engine, frame);
+    if (_else != nullptr)
+      return _else->exec(engine, frame);
+    return Completion::NORMAL;
+  }
+
+private:
+  const Expression *_condition;
+  const Statement *_then;
+  const Statement *_else;
+};
+
+class While : public Statement {
+public:
+  While(const Expression *condition, const Statement *body)
+      : _condition(condition), _body(body) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    while (Interpreter::isTruthyVal(_condition->eval(engine, frame))) {
+      Engine::safepoint();
+      if (_body->exec(engine, frame) != Completion::NORMAL)
+        return Completion::RETURN;
+    }
+    return Completion::NORMAL;
+  }
+
+private:
+  const Expression *_condition;
+  const Statement *_body;
+};
+
+// Initializer and condition are optional, the increment too.
+class For : public Statement {
+public:
+  For(const Statement *init, const Expression *condition,
+      const Expression *after, const Statement *body)
+      : _init(init), _condition(condition), _after(after), _body(body) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    if (_init != nullptr)
+      _init->exec(engine, frame);
+    while (_condition == nullptr ||
+           Interpreter::isTruthyVal(_condition->eval(engine, frame))) {
+      Engine::safepoint();
+      if (_body->exec(engine, frame) != Completion::NORMAL)
+        return Completion::RETURN;
+      if (_after != nullptr)
+        _after->eval(engine, frame);
+    }
+    return Completion::NORMAL;
+  }
+
+private:
+  const Statement *_init;
+  const Expression *_condition;
+  const Expression *_after;
+  const Statement *_body;
+};
+
+class Return : public Statement {
+public:
+  explicit Return(const Expression *expr) : _expr(expr) {}
+  Completion exec(Engine &engine, Frame &frame) const override {
+    return engine.complete(_expr != nullptr ? _expr->eval(engine, frame) : LoxType());
+  }
+
+private:
+  const Expression *_expr;
+};
+
+} // namespace Closure
@@ -0,0 +1,348 @@
+#include <closure_compiler.h>
+#include <lox.h>
+#include <nodes.h>
+
+#include <algorithm>
+
+namespace Closure {
+
+std::unique_ptr<Function> Compiler::compile(
+    const std::vector<Stmt::Stmt *> &statements) {
+  auto script = std::make_unique<Function>();
+  _function = script.get();
+  _hadError = false;
+
+  for (const Stmt::Stmt *statement : statements)
+    script->body.push_back(compile(statement));
+
+  if (_hadError)
+    return nullptr;
+  return script;
+}
+
+void Compiler::visitExprStmt(const Stmt::ExprStmt *stmt) {
+  _statement = make<Evaluate>(compile(stmt->expr()));
+}
+
+void Compiler::visitPrintStmt(const Stmt::PrintStmt *stmt) {
+  _statement = make<Print>(compile(stmt->expr()));
+}
+
+void Compiler::visitVarStmt(const Stmt::VarStmt *stmt) {
+  const Expression *init = nullptr;
+  if (stmt->init() != nullptr)
+    init = compile(stmt->init());
+
+  _statement = define(stmt->local(), stmt->name(), init);
+}
+
+void Compiler::visitBlock(const Stmt::Block *block) {
+  std::vector<const Statement *> statements;
+  statements.reserve(block->statements().size());
+  for (const Stmt::Stmt *statement : block->statements())
+    statements.push_back(compile(statement));
+
+  _statement = make<Block>(std::move(statements));
+}
+
+void Compiler::visitIfStmt(const Stmt::IfStmt *stmt) {
+  const Expression *condition = compile(stmt->condition());
+  const Statement *thenBranch = compile(stmt->thenBranch());
+  const Statement *elseBranch = nullptr;
+  if (stmt->elseBranch() != nullptr)
+    elseBranch = compile(stmt->elseBranch());
+
+  _statement = make<If>(condition, thenBranch, elseBranch);
+}
+
+void Compiler::visitWhileStmt(const Stmt::WhileStmt *stmt) {
+  const Expression *condition = compile(stmt->condition());
+  _statement = make<While>(condition, compile(stmt->body()));
+}
+
+void Compiler::visitForStmt(const Stmt::ForStmt *stmt) {
+  const Statement *init = nullptr;
+  if (stmt->init() != nullptr)
+    init = compile(stmt->init());
+  const Expression *condition = nullptr;
+  if (stmt->condition() != nullptr)
+    condition = compile(stmt->condition());
+  const Expression *after = nullptr;
+  if (stmt->after() != nullptr)
+    after = compile(stmt->after());
+
+  _statement = make<For>(init, condition, after, compile(stmt->body()));
+}
+
+void Compiler::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  _statement = define(stmt->local(), stmt->name(),
+                      make<MakeFunction>(compileFunction(stmt)), true);
+}
+
+void Compiler::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
+  const Expression *expr = nullptr;
+  if (stmt->expr() != nullptr)
+    expr = compile(stmt->expr());
+
+  _statement = make<Return>(expr);
+}
+
+void Compiler::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  // The methods of a subclass capture super, which is defined first.
+  const Statement *super = nullptr;
+  const Expression *superclass = nullptr;
+  Token superName = stmt->name();
+  if (const Stmt::VarStmt *declaration = stmt->superDeclaration()) {
+    super = compile(declaration);
+    superclass = get(declaration->local(), declaration->name());
+    superName = stmt->superclass()->name();
+  }
+
+  std::vector<FunctionCode> methods;
+  for (const Stmt::FunctionStmt *method : stmt->methods())
+    methods.push_back(compileFunction(method));
+
+  _statement = define(stmt->local(), stmt->name(),
+                      make<MakeClass>(stmt->name().lexeme(), superclass,
+                                      superName, std::move(methods)),
+                      true);
+  if (super != nullptr)
+    _statement = make<Block>(std::vector<const Statement *>{super, _statement});
+}
+
+void Compiler::visitBinary(const Expr::BinaryExpr *expr) {
+  switch (expr->op().type()) {
+  case GREATER:
+    binary<Greater>(expr);
+    break;
+  case GREATER_EQUAL:
+    binary<GreaterEqual>(expr);
+    break;
+  case LESS:
+    binary<Less>(expr);
+    break;
+  case LESS_EQUAL:
+    binary<LessEqual>(expr);
+    break;
+  case MINUS:
+    binary<Subtract>(expr);
+    break;
+  case PLUS:
+    binary<Add>(expr);
+    break;
+  case SLASH:
+    binary<Divide>(expr);
+    break;
+  case STAR:
+    binary<Multiply>(expr);
+    break;
+  case BANG_EQUAL:
+    binary<NotEqual>(expr);
+    break;
+  case EQUAL_EQUAL:
+    binary<Equal>(expr);
+    break;
+  default:
+    error(expr->op(), "Invalid operator for binary expression");
+  }
+}
+
+template <typename Op> void Compiler::binary(const Expr::BinaryExpr *expr) {
+  const Expression *left = compile(expr->left());
+  bool calls;
+  const Expression *right = compile(expr->right(), calls);
+  _expression = make<Binary<Op>>(left, right, expr->op(), calls);
+}
+
+void Compiler::visitLiteral(const Expr::LiteralExpr *expr) {
+  _expression = make<Constant>(expr->value());
+}
+
+void Compiler::visitUnary(const Expr::UnaryExpr *expr) {
+  const Expression *operand = compile(expr->right());
+
+  switch (expr->op().type()) {
+  case MINUS:
+    _expression = make<Negate>(operand);
+    break;
+  case BANG:
+    _expression = make<Not>(operand);
+    break;
+  default:
+    error(expr->op(), "Invalid operator to Unary expression");
+  }
+}
+
+// Groupings leave no node behind.
+void Compiler::visitGrouping(const Expr::GroupingExpr *expr) {
+  _expression = compile(expr->expr());
+}
+
+void Compiler::visitTernary(const Expr::TernaryExpr *expr) {
+  const Expression *condition = compile(expr->condition());
+  const Expression *first = compile(expr->first());
+  _expression = make<Ternary>(condition, first, compile(expr->second()));
+}
+
+void Compiler::visitVariable(const Expr::VariableExpr *expr) {
+  _expression = get(expr->local(), expr->name());
+}
+
+void Compiler::visitAssign(const Expr::AssignExpr *expr) {
+  _expression = set(expr->local(), expr->name(), compile(expr->value()));
+}
+
+void Compiler::visitLogic(const Expr::LogicExpr *expr) {
+  const Expression *first = compile(expr->first());
+  const Expression *second = compile(expr->second());
+
+  switch (expr->op().type()) {
+  case OR:
+    _expression = make<Or>(first, second);
+    break;
+  case AND:
+    _expression = make<And>(first, second);
+    break;
+  default:
+    error(expr->op(), "Invalid operator for logic expression");
+  }
+}
+
+void Compiler::visitCall(const Expr::CallExpr *expr) {
+  const Expr::GetExpr *method = expr->method();
+  const Expr::SuperExpr *super = expr->superMethod();
+  const Expression *callee = nullptr;
+  if (super == nullptr)
+    callee = compile(method != nullptr ? method->object() : expr->callee());
+  std::vector<const Expression *> arguments;
+  arguments.reserve(expr->arguments().size());
+  for (const Expr::Expr *arg : expr->arguments())
+    arguments.push_back(compile(arg));
+
+  _calls++;
+  if (super != nullptr) {
+    _expression = make<InvokeSuper>(
+        get(super->local(), super->keyword()),
+        compile(super->self()), super->method(), std::move(arguments),
+        expr->paren());
+  } else if (method != nullptr) {
+    _expression = make<Invoke>(callee, method->name(), std::move(arguments),
+                               expr->paren());
+  } else {
+    _expression = make<Call>(callee, std::move(arguments), expr->paren());
+  }
+}
+
+void Compiler::visitGet(const Expr::GetExpr *expr) {
+  _expression = make<Get>(compile(expr->object()), expr->name());
+}
+
+void Compiler::visitSet(const Expr::SetExpr *expr) {
+  const Expression *object = compile(expr->object());
+  bool calls;
+  const Expression *value = compile(expr->value(), calls);
+  _expression = make<Set>(object, expr->name(), value, calls);
+}
+
+void Compiler::visitThis(const Expr::ThisExpr *expr) {
+  _expression = get(expr->local(), expr->keyword());
+}
+
+void Compiler::visitSuper(const Expr::SuperExpr *expr) {
+  _expression = make<Super>(get(expr->local(), expr->keyword()),
+                            compile(expr->self()), expr->method());
+}
+
+// Only the tree walker runs inlined bodies, the call is compiled instead.
+void Compiler::visitInline(const Expr::InlineExpr *expr) {
+  visitCall(expr->call());
+}
+
+const Statement *Compiler::compile(const Stmt::Stmt *stmt) {
+  stmt->accept(this);
+  return _statement;
+}
+
+const Expression *Compiler::compile(const Expr::Expr *expr) {
+  expr->accept(this);
+  return _expression;
+}
+
+const Expression *Compiler::compile(const Expr::Expr *expr, bool &calls) {
+  size_t before = _calls;
+  const Expression *compiled = compile(expr);
+  calls = _calls != before;
+  return compiled;
+}
+
+FunctionCode Compiler::compileFunction(const Stmt::FunctionStmt *stmt) {
+  auto function = std::make_shared<Function>();
+  function->declaration = stmt;
+  function->info = stmt->info();
+  function->name = stmt->name();
+
+  Function *enclosing = _function;
+  _function = function.get();
+  for (const Stmt::Stmt *statement : stmt->body())
+    function->body.push_back(compile(statement));
+  _function = enclosing;
+
+  return {stmt, &function->info, function};
+}
+
+const Expression *Compiler::get(const Local *local, const Token &name) {
+  if (local == nullptr)
+    return make<GetGlobal>(name);
+
+  switch (local->type) {
+  case Local::SLOT:
+    return make<GetSlot>(local->index);
+  case Local::CELL:
+    return make<GetCell>(local->index);
+  case Local::UPVALUE:
+    return make<GetUpvalue>(local->index);
+  }
+
+  return nullptr;
+}
+
+const Expression *Compiler::set(const Local *local, const Token &name,
+                                const Expression *value) {
+  if (local == nullptr)
+    return make<SetGlobal>(name, value);
+
+  switch (local->type) {
+  case Local::SLOT:
+    return make<SetSlot>(local->index, value);
+  case Local::CELL:
+    return make<SetCell>(local->index, value);
+  case Local::UPVALUE:
+    return make<SetUpvalue>(local->index, value);
+  }
+
+  return nullptr;
+}
+
+const Statement *Compiler::define(const Local *local, const Token &name,
+                                  const Expression *init, bool declared) {
+  if (local == nullptr)
+    return make<DefineGlobal>(name, init);
+
+  // Top level blocks use slots of the script, which are only known once
+  // all its declarations were compiled.
+  FunctionInfo &info = _function->info;
+  info.slots = std::max(info.slots, local->index + 1);
+
+  if (local->type == Local::SLOT)
+    return make<DefineSlot>(local->index, init);
+  if (declared)
+    return make<DeclareCell>(local->index, init);
+  return make<DefineCell>(local->index, init);
+}
+
+void Compiler::error(const Token &token, const char *message) {
+  Lox::error(token.line(), message);
+  _hadError = true;
+}
+
+} // namespace Closure
@@ -0,0 +1,103 @@
+#include <callables.h>
+#include <closure_compiler.h>
+#include <closure_engine.h>
+#include <lox.h>
+#include <lox_class.h>
+#include <lox_function.h>
+#include <lox_instance.h>
+#include <native_func.h>
+#include <runtime_error.h>
+
+namespace Closure {
+
+Engine::Engine() {
+  Heap::instance().addRootSource(this);
+
+  _globals = std::make_shared<Environment>();
+  _globals->define("clock", LoxType(Heap::instance().make<Clock>()));
+}
+
+Engine::~Engine() { Heap::instance().removeRootSource(this); }
+
+void Engine::interpret(const std::vector<Stmt::Stmt *> &statements,
+                       const Interpreter &) {
+  Compiler compiler;
+  std::unique_ptr<Function> script = compiler.compile(statements);
+  if (script == nullptr)
+    return;
+
+  try {
+    _stack.reserve(script->info.slots);
+    Frame frame = _stack.script();
+    // A return outside of any function ends the script.
+    if (run(script->body, frame) == Completion::RETURN)
+      _value = LoxType();
+  } catch (const RuntimeError &err) {
+    Lox::runtime_error(err);
+  }
+}
+
+Completion Engine::run(const std::vector<const Statement *> &statements,
+                       Frame &frame) {
+  for (const Statement *statement : statements) {
+    safepoint();
+    if (statement->exec(*this, frame) != Completion::NORMAL)
+      return Completion::RETURN;
+  }
+
+  return Completion::NORMAL;
+}
+
+LoxType Engine::call(const LoxType &callee, std::span<const LoxType> args,
+                     const Token &paren) {
+  CallCache::Entry target = callTarget(callee, paren);
+  checkArity(target.arity, args.size(), paren);
+
+  if (target.kind == CallCache::Kind::FUNCTION)
+    return invoke(target.function, target.function->receiver(), args);
+
+  if (target.kind == CallCache::Kind::CLASS) {
+    LoxType instance = Heap::instance().make<LoxInstance>(
+        static_cast<LoxClass *>(target.callable));
+    RootGuard guard(&instance);
+
+    if (target.function != nullptr)
+      invoke(target.function, instance, args);
+    return instance;
+  }
+
+  // Native functions do not use the interpreter.
+  return target.callable->call(nullptr, args);
+}
+
+LoxType Engine::callMethod(const LoxFunction *method, const LoxType &receiver,
+                           std::span<const LoxType> args, const Token &paren) {
+  checkArity(method->arity(), args.size(), paren);
+  return invoke(method, receiver, args);
+}
+
+// The caller keeps the function alive, and with it its upvalues.
+LoxType Engine::invoke(const LoxFunction *function, const LoxType &receiver,
+                       std::span<const LoxType> args) {
+  const Function &compiled = *static_cast<const Function *>(function->compiled());
+
+  CallStack::Guard guard(_stack);
+  Frame frame = _stack.pushFrame(compiled.info, receiver, args, compiled.name);
+  frame.upvalues = function->upvalues();
+
+  if (run(compiled.body, frame) == Completion::RETURN) {
+    LoxType value = std::move(_value);
+    _value = LoxType();
+    return value;
+  }
+
+  return LoxType();
+}
+
+void Engine::markRoots(Heap &heap) {
+  heap.mark(_value);
+  heap.mark(_globals.get());
+  _stack.mark(heap);
+}
+
+} // namespace Closure
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include <closure_engine.h>
+#include <nodes.h>
+
+#include <string>
+
+using namespace Closure;
+
+TEST(NodeTest, OperatorsAreBound) {
+  Engine engine;
+  Frame frame;
+  Token plus(PLUS, "+");
+  Token less(LESS, "<");
+
+  Constant one(1.0), two(2.0);
+  Binary<Add> sum(&one, &two, plus, false);
+  Binary<Less> compare(&sum, &two, less, false);
+
+  EXPECT_EQ(sum.eval(engine, frame).getValue<double>(), 3.0);
+  EXPECT_FALSE(compare.eval(engine, frame).getValue<bool>());
+}
+
+TEST(NodeTest, SlotsIndexTheFrame) {
+  Engine engine;
+  LoxType slots[2] = {LoxType(1.0), LoxType(std::string("lox"))};
+  Frame frame{slots};
+
+  Constant value(5.0);
+  SetSlot set(0, &value);
+  GetSlot get(1);
+
+  EXPECT_EQ(set.eval(engine, frame).getValue<double>(), 5.0);
+  EXPECT_EQ(slots[0].getValue<double>(), 5.0);
+  EXPECT_EQ(get.eval(engine, frame).getValue<std::string>(), "lox");
+}
+
+TEST(NodeTest, ErrorsReportTheOperator) {
+  Engine engine;
+  Frame frame;
+  Token slash(SLASH, "/");
+
+  Constant one(1.0), zero(0.0);
+  Binary<Divide> divide(&one, &zero, slash, false);
+
+  try {
+    divide.eval(engine, frame);
+    FAIL();
+  } catch (const RuntimeError &err) {
+    EXPECT_STREQ(err.what(), "Division by Zero");
+  }
+}
@@ -1,40 +1,76 @@
 #pragma once
 
+#include <call_cache.h>
+#include <local.h>
+#include <property_cache.h>
 #include <token.h>
 
 #include <any>
-#include <memory>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
+namespace Stmt {
+class FunctionStmt;
+}
+
 namespace Expr {
 
 class Expr;
 class ExprVisitor;
 
-typedef std::unique_ptr<const Expr> expr_ptr;
-
+// Nodes do not own their children, all nodes of a compilation unit live in
+// its arena (see CompilationUnit).
 class Expr {
 public:
   virtual void accept(ExprVisitor *) const = 0;
 };
 
-class BinaryExpr : public Expr,
-                   public std::enable_shared_from_this<BinaryExpr> {
+// A node that refers to a variable by name. The Resolver stores where the
+// variable lives in it, so that running the node needs no lookup.
+class Reference : public Expr {
+public:
+  // nullptr for a global.
+  const Local *local() const { return _global ? nullptr : &_local; }
+  void resolve(Local local) const {
+    _local = local;
+    _global = false;
+  }
+  void resolveGlobal() const { _global = true; }
+
+private:
+  mutable Local _local{Local::SLOT, 0};
+  mutable bool _global = true;
+};
+
+class BinaryExpr : public Expr {
 public:
+  // The operand types the tree walker handles this node for. It starts out
+  // UNINITIALIZED and is rewritten to the types seen when it first runs;
+  // when a guard fails it is rewritten again, until it settles on GENERIC.
+  enum class Specialization : uint8_t { UNINITIALIZED, NUMBERS, STRINGS, GENERIC };
+
   BinaryExpr(const Expr *left, Token op, const Expr *right)
       : _left(left), _op(std::move(op)), _right(right) {}
 
   void accept(ExprVisitor *) const override;
 
-  const Expr *left() const { return _left.get(); }
-  Token op() const { return _op; }
-  const Expr *right() const { return _right.get(); }
+  const Expr *left() const { return _left; }
+  const Token &op() const { return _op; }
+  const Expr *right() const { return _right; }
+
+  Specialization specialization() const { return _specialization; }
+  void specialize(Specialization) const;
 
 private:
-  const expr_ptr _left;
+  // Rewrites before a node whose operand types keep changing goes generic.
+  static constexpr uint8_t MAX_REWRITES = 4;
+
+  const Expr *const _left;
   const Token _op;
-  const expr_ptr _right;
+  const Expr *const _right;
+  mutable Specialization _specialization = Specialization::UNINITIALIZED;
+  mutable uint8_t _rewrites = 0;
 };
 
 class LiteralExpr : public Expr {
@@ -56,11 +92,11 @@ public:
   void accept(ExprVisitor *) const override;
 
   Token op() const { return _op; }
-  const Expr *right() const { return _right.get(); }
+  const Expr *right() const { return _right; }
 
 private:
   const Token _op;
-  const expr_ptr _right;
+  const Expr *const _right;
 };
 
 class GroupingExpr : public Expr {
@@ -69,10 +105,10 @@ public:
 
   void accept(ExprVisitor *) const override;
 
-  const Expr *expr() const { return _expression.get(); }
+  const Expr *expr() const { return _expression; }
 
 private:
-  const expr_ptr _expression;
+  const Expr *const _expression;
 };
 
 class TernaryExpr : public Expr {
@@ -83,17 +119,17 @@ public:
 
   void accept(ExprVisitor *) const override;
 
-  const Expr *condition() const { return _condition.get(); }
-  const Expr *first() const { return _first.get(); }
-  const Expr *second() const { return _second.get(); }
+  const Expr *condition() const { return _condition; }
+  const Expr *first() const { return _first; }
+  const Expr *second() const { return _second; }
 
 private:
-  const expr_ptr _condition;
-  const expr_ptr _first;
-  const expr_ptr _second;
+  const Expr *const _condition;
+  const Expr *const _first;
+  const Expr *const _second;
 };
 
-class VariableExpr : public Expr {
+class VariableExpr : public Reference {
 public:
   explicit VariableExpr(Token name) : _name(std::move(name)) {}
   void accept(ExprVisitor *) const override;
@@ -103,9 +139,9 @@ private:
   Token _name;
 };
 
-class AssignExpr : public Expr {
+class AssignExpr : public Reference {
 public:
-  explicit AssignExpr(Token name, Expr *value)
+  explicit AssignExpr(Token name, const Expr *value)
       : _name(std::move(name)), _value(std::move(value)) {}
 
   void accept(ExprVisitor *) const override;
@@ -115,12 +151,12 @@ public:
 
 private:
   Token _name;
-  Expr *_value;
+  const Expr *_value;
 };
 
 class LogicExpr : public Expr {
 public:
-  explicit LogicExpr(Token op, Expr *first, Expr *second)
+  explicit LogicExpr(Token op, const Expr *first, const Expr *second)
       : _op(op), _first(first), _second(second) {}
 
   void accept(ExprVisitor *visitor) const override;
@@ -131,38 +167,54 @@ public:
 
 private:
   Token _op;
-  Expr *_first;
-  Expr *_second;
+  const Expr *_first;
+  const Expr *_second;
 };
 
+class GetExpr;
+class SuperExpr;
+
 class CallExpr : public Expr {
 public:
-  explicit CallExpr(Expr *callee, Token paren,
-                    const std::vector<Expr *> &arguments)
-      : _callee(callee), _paren(paren), _arguments(arguments){};
+  explicit CallExpr(const Expr *callee, Token paren,
+                    const std::vector<Expr *> &arguments);
   void accept(ExprVisitor *) const override;
 
   const Expr *callee() const { return _callee; }
-  const Token paren() const { return _paren; }
-  const std::vector<Expr *> arguments() const { return _arguments; }
+  const Token &paren() const { return _paren; }
+  const std::vector<Expr *> &arguments() const { return _arguments; }
+  // The callee of a method call, obj.name(args), which is invoked on the
+  // object without binding the method to it. nullptr for other calls.
+  const GetExpr *method() const { return _method; }
+  // The same for super.name(args), invoked on this.
+  const SuperExpr *superMethod() const { return _superMethod; }
+  // Unused by method calls, which look the method up in the cache of
+  // their GetExpr.
+  CallCache &cache() const { return _cache; }
 
 private:
-  Expr *_callee;
+  const Expr *_callee;
   Token _paren;
   const std::vector<Expr *> _arguments;
+  const GetExpr *_method;
+  const SuperExpr *_superMethod;
+  mutable CallCache _cache;
 };
 
 class GetExpr : public Expr {
 public:
-  explicit GetExpr(Expr *object, Token name) : _object(object), _name(name) {}
+  explicit GetExpr(const Expr *object, Token name) : _object(object), _name(name) {}
   void accept(ExprVisitor *) const override;
 
   const Expr *object() const { return _object; }
-  const Token name() const { return _name; }
+  const Token &name() const { return _name; }
+  // The tree walker's inline cache for this site.
+  PropertyCache &cache() const { return _cache; }
 
 private:
-  Expr *_object;
+  const Expr *_object;
   Token _name;
+  mutable PropertyCache _cache;
 };
 
 class SetExpr : public Expr {
@@ -172,16 +224,19 @@ public:
   void accept(ExprVisitor *) const override;
 
   const Expr *object() const { return _object; }
-  const Token name() const { return _name; }
+  const Token &name() const { return _name; }
   const Expr *value() const { return _value; }
+  // The tree walker's inline cache for this site.
+  PropertyCache &cache() const { return _cache; }
 
 private:
   const Expr *_object;
   Token _name;
   const Expr *_value;
+  mutable PropertyCache _cache;
 };
 
-class ThisExpr : public Expr {
+class ThisExpr : public Reference {
 public:
   explicit ThisExpr(Token keyword) : _keyword(keyword) {}
   
@@ -193,4 +248,45 @@ private:
   Token _keyword;
 };
 
+// super.method, the method of the superclass of the class it is used in,
+// bound to this.
+class SuperExpr : public Reference {
+public:
+  SuperExpr(Token keyword, Token method, const ThisExpr *self)
+      : _keyword(keyword), _method(method), _this(self) {}
+
+  void accept(ExprVisitor *) const override;
+
+  const Token &keyword() const { return _keyword; }
+  const Token &method() const { return _method; }
+  // The receiver the method is bound to, resolved like any use of this.
+  const ThisExpr *self() const { return _this; }
+
+private:
+  Token _keyword;
+  Token _method;
+  const ThisExpr *_this;
+};
+
+// A call to a function declared at the top level, with the returned
+// expression of the function substituted for it. The body is only used
+// while the callee still is the function, otherwise the call is made.
+class InlineExpr : public Expr {
+public:
+  InlineExpr(const CallExpr *call, const Stmt::FunctionStmt *function,
+             const Expr *body)
+      : _call(call), _function(function), _body(body) {}
+
+  void accept(ExprVisitor *) const override;
+
+  const CallExpr *call() const { return _call; }
+  const Stmt::FunctionStmt *function() const { return _function; }
+  const Expr *body() const { return _body; }
+
+private:
+  const CallExpr *_call;
+  const Stmt::FunctionStmt *_function;
+  const Expr *_body;
+};
+
 } // namespace Expr
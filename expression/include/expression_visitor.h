@@ -18,6 +18,8 @@ public:
   virtual void visitGet(const GetExpr *) = 0;
   virtual void visitSet(const SetExpr *) = 0;
   virtual void visitThis(const ThisExpr *) = 0;
+  virtual void visitSuper(const SuperExpr *) = 0;
+  virtual void visitInline(const InlineExpr *) = 0;
 };
 
 } // namespace Expr
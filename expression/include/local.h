@@ -0,0 +1,11 @@
+#pragma once
+
+// Where the Resolver put a local variable. SLOT and CELL index the frame of
+// the running function; a variable lives in a CELL when an inner function
+// captures it. UPVALUE indexes the variables the running function captured.
+struct Local {
+  enum Type { SLOT, CELL, UPVALUE };
+
+  Type type;
+  int index;
+};
@@ -11,6 +11,18 @@ void BinaryExpr::accept(ExprVisitor *visitor) const {
   visitor->visitBinary(this);
 }
 
+void BinaryExpr::specialize(Specialization specialization) const {
+  if (++_rewrites > MAX_REWRITES)
+    specialization = Specialization::GENERIC;
+  _specialization = specialization;
+}
+
+CallExpr::CallExpr(const Expr *callee, Token paren,
+                   const std::vector<Expr *> &arguments)
+    : _callee(callee), _paren(paren), _arguments(arguments),
+      _method(dynamic_cast<const GetExpr *>(callee)),
+      _superMethod(dynamic_cast<const SuperExpr *>(callee)) {}
+
 void UnaryExpr::accept(ExprVisitor *visitor) const {
   visitor->visitUnary(this);
 }
@@ -55,4 +67,12 @@ void ThisExpr::accept(ExprVisitor* visitor) const {
   visitor->visitThis(this);
 }
 
+void SuperExpr::accept(ExprVisitor *visitor) const {
+  visitor->visitSuper(this);
+}
+
+void InlineExpr::accept(ExprVisitor *visitor) const {
+  visitor->visitInline(this);
+}
+
 } // namespace Expr
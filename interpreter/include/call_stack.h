@@ -0,0 +1,64 @@
+#pragma once
+
+#include <frame.h>
+#include <heap.h>
+#include <lox_type.h>
+#include <resolution.h>
+#include <token.h>
+#include <upvalue.h>
+
+#include <memory>
+#include <span>
+
+// Holds the frames of all running calls, and the arguments of calls being
+// set up, on top of the locals of the top level code. Everything above
+// top() is nil.
+//
+// The engines using it also recurse on the native stack for every call,
+// which usually runs out before SLOTS do. A frame is refused once less
+// than NATIVE_RESERVE bytes of the native stack would be left below it,
+// measured from where the CallStack was created, on the main thread.
+class CallStack {
+public:
+  static constexpr size_t SLOTS = 64 * 1024;
+  static constexpr size_t NATIVE_RESERVE = 256 * 1024;
+
+  CallStack();
+
+  // The frame of the top level code, at the bottom of the stack.
+  Frame script() const { return Frame{_slots.get(), _cells.get()}; }
+  LoxType *top() const { return _top; }
+
+  // Sets up the frame of a call. Arguments that were pushed onto the top
+  // of the stack already sit where the parameters go.
+  Frame pushFrame(const FunctionInfo &, const LoxType &receiver,
+                  std::span<const LoxType> args, const Token &name);
+  void push(const LoxType &, const Token &);
+  void popTo(LoxType *);
+  // The top level frame grows as new scripts are resolved, nothing is
+  // above it while top level code runs.
+  void reserve(size_t slots);
+
+  void mark(Heap &) const;
+
+  // Pops everything that was pushed onto the stack while it was in scope.
+  class Guard {
+  public:
+    explicit Guard(CallStack &stack) : _stack(stack), _top(stack._top) {}
+    ~Guard() { _stack.popTo(_top); }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+  private:
+    CallStack &_stack;
+    LoxType *_top;
+  };
+
+private:
+  std::unique_ptr<LoxType[]> _slots;
+  std::unique_ptr<Upvalue *[]> _cells;
+  LoxType *_top;
+  // The lowest native stack address a frame may be pushed from.
+  const char *_nativeLimit;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <call_cache.h>
+#include <frame.h>
+#include <lox_class.h>
+#include <lox_function.h>
+#include <lox_type.h>
+#include <resolution.h>
+#include <stmt.h>
+#include <token.h>
+#include <upvalue.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Calling, and creating functions and classes, the same way in every
+// engine. How a call then runs is up to the engine.
+
+// What calling callee takes: the function, or the class and its
+// initializer, or the native function. Throws a RuntimeError at paren if
+// callee cannot be called.
+CallCache::Entry callTarget(const LoxType &callee, const Token &paren);
+// Throws a RuntimeError at paren unless args is the callee's arity.
+void checkArity(size_t arity, size_t args, const Token &paren);
+
+// A function declaration, and what the engine compiled it to, if it
+// compiles functions (see LoxFunction::compiled).
+struct FunctionCode {
+  const Stmt::FunctionStmt *declaration = nullptr;
+  const FunctionInfo *info = nullptr;
+  std::shared_ptr<const CompiledFunction> compiled;
+};
+
+// The upvalues of a function created in frame: the cells of the locals it
+// captures, and the upvalues of frame it captures in turn.
+std::vector<Upvalue *> capture(const FunctionInfo &, const Frame &);
+LoxType makeFunction(const FunctionCode &, const Frame &);
+
+// The class a class declaration names as its superclass. Throws a
+// RuntimeError at name if the value is not a class.
+LoxClass *superclassOf(const LoxType &value, const Token &name);
+// superclass is nullptr unless the class has one.
+LoxType makeClass(const std::string &name, LoxClass *superclass,
+                  const std::vector<FunctionCode> &methods, const Frame &);
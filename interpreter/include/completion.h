@@ -0,0 +1,7 @@
+#pragma once
+
+// How a statement finished. Anything other than NORMAL skips the rest of
+// the enclosing statements until it reaches the construct that handles it:
+// RETURN is handled by the call of the running function, and so is
+// TAIL_CALL, a return of a call that the running call is replaced by.
+enum class Completion { NORMAL, RETURN, TAIL_CALL };
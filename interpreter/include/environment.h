@@ -1,22 +1,31 @@
 #pragma once
 
+#include <heap.h>
 #include <runtime_error.h>
 #include <lox_type.h>
 #include <token.h>
 #include <unordered_map>
 
+// Variables looked up by name, which are the globals. Locals live in
+// frames (see Frame).
 class Environment {
 public:
   explicit Environment() : _enclosing(nullptr) {}
-  explicit Environment(std::unordered_map<std::string, LoxType> vals) : _values(vals) {}
-  Environment(const Environment& other) : _values(other._values), _enclosing(other._enclosing) {}
+  explicit Environment(std::unordered_map<StringRef, LoxType> vals) : _values(vals) { rememberAll(); }
+  Environment(const Environment& other) : _values(other._values), _enclosing(other._enclosing) { rememberAll(); }
   explicit Environment(std::shared_ptr<Environment> enclosing) : _enclosing(enclosing) {}
+  ~Environment() {
+    if (_remembered)
+      Heap::instance().forget(this);
+  }
 
-  void define(std::string name, LoxType value) { _values[name] = value; }
+  void define(const StringRef &name, LoxType value) { store(_values[name], value); }
+  void define(std::string_view name, LoxType value) { define(StringRef(name), value); }
 
-  void assign(const Token name, LoxType value) {
-    if (_values.contains(name.lexeme())) {
-      _values[name.lexeme()] = value;
+  void assign(const Token &name, LoxType value) {
+    auto it = _values.find(name.symbol());
+    if (it != _values.end()) {
+      store(it->second, value);
     } else if (_enclosing != nullptr) {
       _enclosing->assign(name, value);
     } else {
@@ -24,38 +33,40 @@ public:
     }
   }
 
-  void assignAt(int distance, const Token name, LoxType value) {
-    ancestor(distance)->_values[name.lexeme()] = value;
-  }
-
-  LoxType get(Token name) const {
-    if (_values.contains(name.lexeme())) {
-      LoxType val = _values.at(name.lexeme());
-      if (val.isType<std::monostate>()) {
+  LoxType get(const Token &name) const {
+    auto it = _values.find(name.symbol());
+    if (it != _values.end()) {
+      if (it->second.isType<std::monostate>()) {
         throw RuntimeError(name, "Undefined variable '" + name.lexeme() + "'.");
       }
-      return _values.at(name.lexeme());
+      return it->second;
     } else if (_enclosing != nullptr) {
       return _enclosing->get(name);
     }
     throw RuntimeError(name, "Undefined variable '" + name.lexeme() + "'.");
   }
-
-  LoxType getAt(int distance, Token name) {
-    auto env = ancestor(distance);
-    if (env->_values.contains(name.lexeme()))
-      return env->_values[name.lexeme()];
-    throw RuntimeError(name, "Undefined variable '" + name.lexeme() + "'.");
-  }
   
   void printAll() {
     for (auto p : _values) {
-      std::cout << p.first << std::endl;
+      std::cout << p.first.str() << std::endl;
     }
     if (_enclosing != nullptr)
       _enclosing->printAll();
   } 
 
+  // Where the variable is stored, or nullptr. Variables are never removed,
+  // and stay where they are when others are added.
+  LoxType *find(const StringRef &name) {
+    auto it = _values.find(name);
+    return it != _values.end() ? &it->second : nullptr;
+  }
+
+  // Writes a variable found with find.
+  void store(LoxType &slot, LoxType value) {
+    Heap::instance().writeBarrier(this, value);
+    slot = std::move(value);
+  }
+
   Environment* ancestor(int distance) {
     Environment* env = this;
     for (int i = 0; i < distance; i++) {
@@ -69,9 +80,20 @@ public:
   Environment& operator=(const Environment other) {
     _values = other._values;
     _enclosing = other._enclosing;
+    rememberAll();
     return *this;
   }
 private:
-  std::unordered_map<std::string, LoxType> _values;
+  friend class Heap;
+
+  void rememberAll() {
+    for (auto &[name, value] : _values)
+      Heap::instance().writeBarrier(this, value);
+  }
+
+  std::unordered_map<StringRef, LoxType> _values;
   std::shared_ptr<Environment> _enclosing;
+  unsigned _epoch = 0;
+  bool _old = false;
+  bool _remembered = false;
 };
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <lox_type.h>
+#include <upvalue.h>
+
+// Locals of one function call, or of the top level code, as a window into
+// the interpreter's stack. Blocks share the frame of the function they are
+// in. cells runs parallel to slots and holds the Upvalue of every captured
+// local.
+struct Frame {
+  LoxType *slots = nullptr;
+  Upvalue **cells = nullptr;
+  Upvalue *const *upvalues = nullptr;
+};
@@ -2,18 +2,33 @@
 
 #include "stmt.h"
 #include "stmt_visitor.h"
+#include <call_stack.h>
+#include <completion.h>
 #include <environment.h>
 #include <expression_visitor.h>
+#include <frame.h>
+#include <heap.h>
+#include <jit.h>
 #include <lox_function.h>
+#include <resolution.h>
 
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-class Interpreter : public Expr::ExprVisitor, public Stmt::StmtVisitor {
+class Interpreter : public Expr::ExprVisitor,
+                    public Stmt::StmtVisitor,
+                    public RootSource {
 public:
   Interpreter();
+  ~Interpreter();
 
   LoxType eval(const Expr::Expr *);
-  void interpret(const std::vector<Stmt::Stmt *>);
+  void interpret(const std::vector<Stmt::Stmt *> &);
 
   void visitExprStmt(const Stmt::ExprStmt *) override;
   void visitPrintStmt(const Stmt::PrintStmt *) override;
@@ -38,22 +53,110 @@ public:
   void visitGet(const Expr::GetExpr *) override;
   void visitSet(const Expr::SetExpr *) override;
   void visitThis(const Expr::ThisExpr *) override;
+  void visitSuper(const Expr::SuperExpr *) override;
+  void visitInline(const Expr::InlineExpr *) override;
 
-  void resolve(const Expr::Expr*, int);
+  void resolveScript(FunctionInfo);
+
+  // The slots the top level code of the last resolved script uses for the
+  // locals of its blocks.
+  const FunctionInfo &script() const { return _scriptInfo; }
+
+  // Caches the results of the calls to a pure function, see Memo, as long
+  // as the globals it depends on keep the values their declarations in its
+  // unit gave them.
+  void memoize(const Stmt::FunctionStmt *, size_t capacity,
+               const std::unordered_map<std::string, const Stmt::Declaration *>
+                   &dependencies);
+  void reportMemoStats(std::ostream &) const;
+
+  void markRoots(Heap &) override;
+
+  static bool isTruthyVal(const LoxType &);
 
   friend class LoxFunction;
 
 private:
+  // Makes a frame current for as long as it is in scope.
+  class FrameGuard {
+  public:
+    FrameGuard(Interpreter &interpreter, Frame &frame)
+        : _interpreter(interpreter), _prev(interpreter._frame) {
+      interpreter._frame = &frame;
+    }
+    ~FrameGuard() { _interpreter._frame = _prev; }
+
+    FrameGuard(const FrameGuard &) = delete;
+    FrameGuard &operator=(const FrameGuard &) = delete;
+
+  private:
+    Interpreter &_interpreter;
+    Frame *_prev;
+  };
+
+  // A call made by a return in tail position: it is not made by the return
+  // but left here, for the call of the running function to make in its own
+  // place.
+  struct TailCall {
+    // A function value, or nil for a method of a class.
+    LoxType callee;
+    LoxFunction *method = nullptr;
+    LoxType receiver;
+    std::vector<LoxType> args;
+  };
+
   void evalutate(const Expr::Expr *);
-  void execute(const Stmt::Stmt *);
-  void executeBlock(std::shared_ptr<Environment>, const std::vector<const Stmt::Stmt *> &);
+  Completion execute(const Stmt::Stmt *);
+  Completion executeBlock(Frame &, const std::vector<const Stmt::Stmt *> &);
+  LoxType takeReturnValue();
+  // Handles a tail call that ended the running function, whose frame starts
+  // at base: pushes the receiver and arguments of the call there, sets args
+  // to them and returns the function to call. callee and receiver are set
+  // to the values that keep it alive.
+  LoxFunction *takeTailCall(LoxType *base, LoxType &callee, LoxType &receiver,
+                            std::span<const LoxType> &args);
+  void call(const Expr::CallExpr *, bool tail);
+  // What calling the callee of a call site takes, from its CallCache.
+  const CallCache::Entry &callTarget(const Expr::CallExpr *, const LoxType &);
+  void tailCall(LoxType callee, LoxFunction *method, const LoxType &receiver,
+                std::span<const LoxType> args);
+  // visitBinary's handlers for the specializations of a BinaryExpr.
+  void binaryNumbers(const Expr::BinaryExpr *, double, double);
+  void binaryStrings(const Expr::BinaryExpr *, const LoxType &, const LoxType &);
+  void binaryGeneric(const Expr::BinaryExpr *, const LoxType &, const LoxType &);
   void enforceDouble(Token, const LoxType &);
   bool isTruthyExpr(const Expr::Expr *);
-  bool isTruthyVal(const LoxType &);
-  LoxType lookupVariable(const Token&, const Expr::Expr*);
+  LoxType lookupVariable(const Token&, const Expr::Reference*);
+  void declare(const Stmt::Declaration *);
+  void define(const Stmt::Declaration *, const Token &, LoxType);
+  void globalWritten(const Token &, const Stmt::Declaration *);
+  void store(Frame &, const Local &, LoxType);
 
   LoxType _value;
+  // Set by return, and reset by whoever handles it. The returned value is
+  // held in _value meanwhile.
+  Completion _completion = Completion::NORMAL;
   std::shared_ptr<Environment> _globals;
-  std::shared_ptr<Environment> _environment;
-  std::unordered_map<const Expr::Expr*, int> _locals;
+  CallStack _stack;
+  Frame _script;
+  Frame *_frame;
+  TailCall _tailCall;
+  FunctionInfo _scriptInfo;
+  // Every cache handed out, kept for their stats.
+  std::vector<std::shared_ptr<Memo>> _memos;
+  // A memoized function, which gets its Memo once `pending` reaches zero,
+  // see globalWritten.
+  struct MemoWatch {
+    const Stmt::FunctionStmt *function;
+    std::shared_ptr<Memo> memo;
+    size_t pending;
+    bool dropped = false;
+  };
+  // The memoized functions depending on each global, with the declaration
+  // expected to write it.
+  std::unordered_map<
+      std::string,
+      std::vector<std::pair<const Stmt::Declaration *, std::shared_ptr<MemoWatch>>>>
+      _memoWatches;
+  Jit::Compiler _jit;
 };
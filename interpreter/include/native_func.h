@@ -4,8 +4,9 @@
 
 class Clock : public LoxCallable {
 public:
-  LoxType call(Interpreter* interpreter, const std::vector<LoxType>& args) override {
+  LoxType call(Interpreter* interpreter, std::span<const LoxType> args) override {
     return time(nullptr) / 1000.0;
   }
   size_t arity() const override {return 0;}
+  size_t size() const override {return sizeof(Clock);}
 };
@@ -0,0 +1,83 @@
+#include <call_stack.h>
+#include <runtime_error.h>
+
+#include <algorithm>
+
+#include <sys/resource.h>
+
+namespace {
+
+// The size of the main thread's stack, which grows up to its limit.
+size_t nativeStackSize() {
+  rlimit limit;
+  if (getrlimit(RLIMIT_STACK, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY)
+    return 8 * 1024 * 1024;
+  return limit.rlim_cur;
+}
+
+} // namespace
+
+CallStack::CallStack()
+    : _slots(new LoxType[SLOTS]), _cells(new Upvalue *[SLOTS]()),
+      _top(_slots.get()) {
+  size_t size = nativeStackSize();
+  size_t usable = size > 2 * NATIVE_RESERVE ? size - NATIVE_RESERVE : size / 2;
+  _nativeLimit =
+      static_cast<const char *>(__builtin_frame_address(0)) - usable;
+}
+
+Frame CallStack::pushFrame(const FunctionInfo &info, const LoxType &receiver,
+                           std::span<const LoxType> args, const Token &name) {
+  if (static_cast<const char *>(__builtin_frame_address(0)) < _nativeLimit)
+    throw RuntimeError(name, "Stack overflow.");
+
+  size_t offset = info.method ? 1 : 0;
+  LoxType *base = const_cast<LoxType *>(args.data()) - offset;
+
+  if (args.data() + args.size() != _top || base < _slots.get()) {
+    base = _top;
+    if (base + offset + args.size() > _slots.get() + SLOTS)
+      throw RuntimeError(name, "Stack overflow.");
+    std::copy(args.begin(), args.end(), base + offset);
+  }
+
+  if (base + info.slots > _slots.get() + SLOTS)
+    throw RuntimeError(name, "Stack overflow.");
+  _top = std::max(_top, base + info.slots);
+
+  Frame frame{base, _cells.get() + (base - _slots.get())};
+  if (info.method)
+    base[0] = receiver;
+  for (size_t i = 0; i < info.params.size(); i++) {
+    if (info.params[i].type == Local::CELL)
+      frame.cells[i] = Heap::instance().make<Upvalue>(base[i]);
+  }
+
+  return frame;
+}
+
+void CallStack::push(const LoxType &value, const Token &token) {
+  if (_top == _slots.get() + SLOTS)
+    throw RuntimeError(token, "Stack overflow.");
+  *_top++ = value;
+}
+
+void CallStack::popTo(LoxType *top) {
+  Upvalue **cell = _cells.get() + (top - _slots.get());
+  for (LoxType *slot = top; slot < _top; slot++, cell++) {
+    *slot = LoxType();
+    *cell = nullptr;
+  }
+  _top = top;
+}
+
+void CallStack::reserve(size_t slots) {
+  _top = std::max(_top, _slots.get() + slots);
+}
+
+void CallStack::mark(Heap &heap) const {
+  for (LoxType *slot = _slots.get(); slot < _top; slot++)
+    heap.mark(*slot);
+  for (Upvalue **cell = _cells.get(); cell < _cells.get() + (_top - _slots.get()); cell++)
+    heap.mark(*cell);
+}
@@ -0,0 +1,79 @@
+#include <callables.h>
+#include <heap.h>
+#include <lox_callable.h>
+#include <runtime_error.h>
+
+#include <map>
+#include <sstream>
+
+CallCache::Entry callTarget(const LoxType &callee, const Token &paren) {
+  CallCache::Entry entry;
+  entry.callee = callee;
+  if (callee.isType<LoxFunction *>()) {
+    entry.kind = CallCache::Kind::FUNCTION;
+    entry.function = callee.getValue<LoxFunction *>();
+    entry.arity = entry.function->arity();
+  } else if (callee.isType<LoxCallable *>()) {
+    entry.kind = CallCache::Kind::NATIVE;
+    entry.callable = callee.getValue<LoxCallable *>();
+    entry.arity = entry.callable->arity();
+  } else if (callee.isType<LoxClass *>()) {
+    LoxClass *klass = callee.getValue<LoxClass *>();
+    entry.kind = CallCache::Kind::CLASS;
+    entry.callable = klass;
+    entry.function = klass->initializer();
+    entry.arity = klass->arity();
+  } else {
+    throw RuntimeError(paren, "Can only call functions or classes.");
+  }
+
+  return entry;
+}
+
+void checkArity(size_t arity, size_t args, const Token &paren) {
+  if (args != arity) {
+    std::stringstream error;
+    error << "Expected " << arity << " arguments but got " << args << ".";
+    throw RuntimeError(paren, error.str());
+  }
+}
+
+std::vector<Upvalue *> capture(const FunctionInfo &info, const Frame &frame) {
+  std::vector<Upvalue *> upvalues;
+  upvalues.reserve(info.captures.size());
+
+  for (const Capture &capture : info.captures) {
+    if (capture.local)
+      upvalues.push_back(frame.cells[capture.index]);
+    else
+      upvalues.push_back(frame.upvalues[capture.index]);
+  }
+
+  return upvalues;
+}
+
+LoxType makeFunction(const FunctionCode &function, const Frame &frame) {
+  return Heap::instance().make<LoxFunction>(function.declaration,
+                                            function.info,
+                                            capture(*function.info, frame),
+                                            function.compiled);
+}
+
+LoxClass *superclassOf(const LoxType &value, const Token &name) {
+  if (!value.isType<LoxClass *>())
+    throw RuntimeError(name, "Superclass must be a class.");
+  return value.getValue<LoxClass *>();
+}
+
+LoxType makeClass(const std::string &name, LoxClass *superclass,
+                  const std::vector<FunctionCode> &methods,
+                  const Frame &frame) {
+  std::map<std::string, LoxFunction> table;
+  for (const FunctionCode &method : methods) {
+    table.insert({method.declaration->name().lexeme(),
+                  LoxFunction(method.declaration, method.info,
+                              capture(*method.info, frame), method.compiled)});
+  }
+
+  return Heap::instance().make<LoxClass>(name, superclass, table);
+}
@@ -1,26 +1,36 @@
 #include "interpreter.h"
+#include "callables.h"
 #include "lox.h"
 #include "lox_callable.h"
 #include "lox_class.h"
 #include "native_func.h"
-#include "return.h"
 #include "runtime_error.h"
 #include "token_type.h"
 #include <lox_instance.h>
+#include <memo.h>
+#include <upvalue.h>
 
-#include <sstream>
+#include <algorithm>
+
+Interpreter::Interpreter() : _script(_stack.script()) {
+  Heap::instance().addRootSource(this);
 
-Interpreter::Interpreter() {
   _globals = std::make_shared<Environment>();
 
-  _globals->define("clock", LoxType(new Clock()));
-  _environment = _globals;
+  _globals->define("clock", LoxType(Heap::instance().make<Clock>()));
+  _frame = &_script;
 }
 
-void Interpreter::interpret(const std::vector<Stmt::Stmt *> statements) {
+Interpreter::~Interpreter() { Heap::instance().removeRootSource(this); }
+
+void Interpreter::interpret(const std::vector<Stmt::Stmt *> &statements) {
   try {
     for (const Stmt::Stmt *statement : statements) {
-      statement->accept(this);
+      // A return outside of any function ends the script.
+      if (execute(statement) == Completion::RETURN) {
+        _completion = Completion::NORMAL;
+        break;
+      }
     }
   } catch (RuntimeError err) {
     Lox::runtime_error(err);
@@ -48,27 +58,31 @@ void Interpreter::visitVarStmt(const Stmt::VarStmt *stmt) {
     val = eval(stmt->init());
   }
 
-  _environment->define(stmt->name().lexeme(), val);
+  declare(stmt);
+  define(stmt, stmt->name(), val);
 }
 
+// Blocks have no storage of their own, their locals are slots in the frame
+// of the enclosing function.
 void Interpreter::visitBlock(const Stmt::Block *block) {
-  std::shared_ptr<Environment> env =
-      std::make_shared<Environment>(_environment);
-
-  executeBlock(env, block->statements());
+  for (const Stmt::Stmt *statement : block->statements()) {
+    if (execute(statement) != Completion::NORMAL)
+      return;
+  }
 }
 
 void Interpreter::visitIfStmt(const Stmt::IfStmt *stmt) {
   if (isTruthyExpr(stmt->condition())) {
     execute(stmt->thenBranch());
-  } else {
+  } else if (stmt->elseBranch() != nullptr) {
     execute(stmt->elseBranch());
   }
 }
 
 void Interpreter::visitWhileStmt(const Stmt::WhileStmt *stmt) {
   while (isTruthyExpr(stmt->condition())) {
-    execute(stmt->body());
+    if (execute(stmt->body()) != Completion::NORMAL)
+      return;
   }
 }
 
@@ -76,38 +90,56 @@ void Interpreter::visitForStmt(const Stmt::ForStmt *stmt) {
   if (stmt->init() != nullptr)
     execute(stmt->init());
   while (stmt->condition() == nullptr || isTruthyExpr(stmt->condition())) {
-    execute(stmt->body());
+    if (execute(stmt->body()) != Completion::NORMAL)
+      return;
     if (stmt->after() != nullptr)
       evalutate(stmt->after());
   }
 }
 
 void Interpreter::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
-  LoxType function = new LoxFunction(*stmt, _environment);
-  _environment->define(stmt->name().lexeme(), function);
+  // Declared first, so that a local function can capture itself.
+  declare(stmt);
+  LoxType function = makeFunction({stmt, &stmt->info(), nullptr}, *_frame);
+  define(stmt, stmt->name(), function);
 }
 
 void Interpreter::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
-  LoxType val;
+  if (stmt->tailCall()) {
+    call(static_cast<const Expr::CallExpr *>(stmt->expr()), true);
+    // A class or native function was called right away.
+    if (_completion == Completion::NORMAL)
+      _completion = Completion::RETURN;
+    return;
+  }
 
   if (stmt->expr() != nullptr)
-    val = eval(stmt->expr());
+    evalutate(stmt->expr());
+  else
+    _value = LoxType();
 
-  throw Return(_value);
+  _completion = Completion::RETURN;
 }
 
 void Interpreter::visitClassStmt(const Stmt::ClassStmt *stmt) {
-  _environment->define(stmt->name().lexeme(), 0.0);
-
-  std::map<std::string, LoxFunction> methods;
-  for (Stmt::FunctionStmt *method : stmt->methods()) {
-    methods.insert(
-        {method->name().lexeme(), LoxFunction(*method, _environment)});
+  declare(stmt);
+
+  LoxClass *superclass = nullptr;
+  if (const Expr::VariableExpr *name = stmt->superclass()) {
+    LoxType value = eval(name);
+    superclass = superclassOf(value, name->name());
+    const Stmt::VarStmt *super = stmt->superDeclaration();
+    declare(super);
+    define(super, super->name(), value);
   }
 
-  LoxType loxClass(new LoxClass(stmt->name().lexeme(), methods));
+  std::vector<FunctionCode> methods;
+  for (const Stmt::FunctionStmt *method : stmt->methods())
+    methods.push_back({method, &method->info(), nullptr});
 
-  _environment->assign(stmt->name(), loxClass);
+  LoxType loxClass =
+      makeClass(stmt->name().lexeme(), superclass, methods, *_frame);
+  define(stmt, stmt->name(), loxClass);
 }
 
 void Interpreter::visitLiteral(const Expr::LiteralExpr *expr) {
@@ -137,9 +169,103 @@ void Interpreter::visitUnary(const Expr::UnaryExpr *expr) {
 void Interpreter::visitBinary(const Expr::BinaryExpr *expr) {
   evalutate(expr->left());
   LoxType left = _value;
+  RootGuard guard(&left);
   evalutate(expr->right());
   LoxType right = _value;
 
+  typedef Expr::BinaryExpr::Specialization Specialization;
+  switch (expr->specialization()) {
+  case Specialization::NUMBERS:
+    if (left.isType<double>() && right.isType<double>()) {
+      binaryNumbers(expr, left.getValue<double>(), right.getValue<double>());
+      return;
+    }
+    break;
+  case Specialization::STRINGS:
+    if (left.isType<std::string>() && right.isType<std::string>()) {
+      binaryStrings(expr, left, right);
+      return;
+    }
+    break;
+  case Specialization::GENERIC:
+    binaryGeneric(expr, left, right);
+    return;
+  case Specialization::UNINITIALIZED:
+    break;
+  }
+
+  // First run, or the guard of the specialization failed: specialize for
+  // the operands seen now, and handle them generically this time.
+  TOKEN_TYPE op = expr->op().type();
+  bool stringOp = op == PLUS || op == EQUAL_EQUAL || op == BANG_EQUAL;
+  if (left.isType<double>() && right.isType<double>())
+    expr->specialize(Specialization::NUMBERS);
+  else if (stringOp && left.isType<std::string>() && right.isType<std::string>())
+    expr->specialize(Specialization::STRINGS);
+  else
+    expr->specialize(Specialization::GENERIC);
+
+  binaryGeneric(expr, left, right);
+}
+
+void Interpreter::binaryNumbers(const Expr::BinaryExpr *expr, double left,
+                                double right) {
+  switch (expr->op().type()) {
+  case GREATER:
+    _value = left > right;
+    break;
+  case GREATER_EQUAL:
+    _value = left >= right;
+    break;
+  case LESS:
+    _value = left < right;
+    break;
+  case LESS_EQUAL:
+    _value = left <= right;
+    break;
+  case MINUS:
+    _value = left - right;
+    break;
+  case PLUS:
+    _value = left + right;
+    break;
+  case SLASH:
+    if (right == 0)
+      throw RuntimeError(expr->op(), "Division by Zero");
+    _value = left / right;
+    break;
+  case STAR:
+    _value = left * right;
+    break;
+  case BANG_EQUAL:
+    _value = left != right;
+    break;
+  case EQUAL_EQUAL:
+    _value = left == right;
+    break;
+  default:
+    throw RuntimeError(expr->op(), "Invalid operator for binary expression");
+  }
+}
+
+// Only specialized for the operators strings support.
+void Interpreter::binaryStrings(const Expr::BinaryExpr *expr,
+                                const LoxType &left, const LoxType &right) {
+  switch (expr->op().type()) {
+  case PLUS:
+    _value = LoxType::concat(left, right);
+    break;
+  case BANG_EQUAL:
+    _value = left != right;
+    break;
+  default:
+    _value = left == right;
+    break;
+  }
+}
+
+void Interpreter::binaryGeneric(const Expr::BinaryExpr *expr,
+                                const LoxType &left, const LoxType &right) {
   switch (expr->op().type()) {
   case GREATER:
     enforceDouble(expr->op(), right);
@@ -163,7 +289,7 @@ void Interpreter::visitBinary(const Expr::BinaryExpr *expr) {
     break;
   case PLUS:
     if (left.isType<std::string>() && right.isType<std::string>()) {
-      _value = left.getValue<std::string>() + right.getValue<std::string>();
+      _value = LoxType::concat(left, right);
     } else if (left.isType<double>() && right.isType<double>()) {
       _value = left.getValue<double>() + right.getValue<double>();
     } else {
@@ -205,11 +331,11 @@ void Interpreter::visitVariable(const Expr::VariableExpr *expr) {
 void Interpreter::visitAssign(const Expr::AssignExpr *expr) {
   evalutate(expr->value());
 
-  if (_locals.contains(expr)) {
-    int distance = _locals[expr];
-    _environment->assignAt(distance, expr->name(), _value);
+  if (const Local *local = expr->local()) {
+    store(*_frame, *local, _value);
   } else {
     _globals->assign(expr->name(), _value);
+    globalWritten(expr->name(), nullptr);
   }
 }
 
@@ -232,38 +358,96 @@ void Interpreter::visitLogic(const Expr::LogicExpr *expr) {
   }
 }
 
-void Interpreter::visitCall(const Expr::CallExpr *expr) {
-  LoxType callee = eval(expr->callee());
+void Interpreter::visitCall(const Expr::CallExpr *expr) { call(expr, false); }
+
+// A tail call to a Lox function is not made, but completes the running
+// function with TAIL_CALL; calls to classes and native functions are made
+// as usual, leaving their value for visitReturnStmt to return.
+void Interpreter::call(const Expr::CallExpr *expr, bool tail) {
+  // A method call looks the method up where the callee would be evaluated,
+  // and passes the object as the receiver instead of binding it.
+  LoxType callee, receiver;
+  LoxFunction *method = nullptr;
+  if (const Expr::GetExpr *get = expr->method()) {
+    receiver = eval(get->object());
+    if (!receiver.isType<LoxInstance *>())
+      throw RuntimeError(get->name(), "Cannot get property of non-instance.");
+
+    LoxInstance *instance = receiver.getValue<LoxInstance *>();
+    method = instance->method(get->name(), get->cache());
+    if (method == nullptr)
+      callee = instance->get(get->name(), get->cache());
+  } else if (const Expr::SuperExpr *super = expr->superMethod()) {
+    method = lookupVariable(super->keyword(), super)
+                 .getValue<LoxClass *>()
+                 ->superMethod(super->method());
+    receiver = eval(super->self());
+  } else {
+    callee = eval(expr->callee());
+  }
+  RootGuard calleeGuard(&callee);
+
+  // The arguments are evaluated straight into the slots of the callee's
+  // frame, after a slot for the receiver of a method, which also roots it.
+  CallStack::Guard guard(_stack);
+  LoxType *self = _stack.top();
+  _stack.push(receiver, expr->paren());
+  std::span<const LoxType> args(_stack.top(), expr->arguments().size());
+  for (const Expr::Expr *arg : expr->arguments())
+    _stack.push(eval(arg), expr->paren());
+
+  if (method != nullptr) {
+    checkArity(method->arity(), args.size(), expr->paren());
+    if (tail)
+      tailCall(LoxType(), method, *self, args);
+    else
+      _value = method->invoke(this, *self, args);
+    return;
+  }
 
-  std::vector<LoxType> args;
-  for (const Expr::Expr *arg : expr->arguments()) {
-    args.push_back(eval(arg));
+  const CallCache::Entry &target = callTarget(expr, callee);
+  checkArity(target.arity, args.size(), expr->paren());
+  switch (target.kind) {
+  case CallCache::Kind::FUNCTION:
+    if (tail)
+      tailCall(callee, nullptr, target.function->receiver(), args);
+    else
+      _value = target.function->invoke(this, target.function->receiver(), args);
+    break;
+  case CallCache::Kind::CLASS:
+    _value = static_cast<LoxClass *>(target.callable)
+                 ->instantiate(this, target.function, args);
+    break;
+  case CallCache::Kind::NATIVE:
+    _value = target.callable->call(this, args);
+    break;
   }
+}
 
-  LoxCallable *function;
+const CallCache::Entry &Interpreter::callTarget(const Expr::CallExpr *expr,
+                                                const LoxType &callee) {
+  CallCache &cache = expr->cache();
+  unsigned epoch = Heap::instance().epoch();
+  if (const CallCache::Entry *entry = cache.find(callee, epoch))
+    return *entry;
 
-  if (callee.isType<LoxFunction *>())
-    function = callee.getValue<LoxFunction *>();
-  else if (callee.isType<LoxCallable *>())
-    function = callee.getValue<LoxCallable *>();
-  else if (callee.isType<LoxClass *>())
-    function = callee.getValue<LoxClass *>();
-  else
-    throw RuntimeError(expr->paren(), "Can only call functions or classes.");
+  return cache.set(::callTarget(callee, expr->paren()), epoch);
+}
 
-  if (args.size() != function->arity()) {
-    std::stringstream error;
-    error << "Expected " << function->arity() << " arguments but got "
-          << args.size() << ".";
-    throw RuntimeError(expr->paren(), error.str());
-  }
-  _value = function->call(this, args);
+void Interpreter::tailCall(LoxType callee, LoxFunction *method,
+                           const LoxType &receiver,
+                           std::span<const LoxType> args) {
+  _tailCall.callee = callee;
+  _tailCall.method = method;
+  _tailCall.receiver = receiver;
+  _tailCall.args.assign(args.begin(), args.end());
+  _completion = Completion::TAIL_CALL;
 }
 
 void Interpreter::visitGet(const Expr::GetExpr *expr) {
   LoxType object = eval(expr->object());
   if (object.isType<LoxInstance *>()) {
-    _value = object.getValue<LoxInstance *>()->get(expr->name());
+    _value = object.getValue<LoxInstance *>()->get(expr->name(), expr->cache());
     return;
   }
 
@@ -274,9 +458,10 @@ void Interpreter::visitSet(const Expr::SetExpr *expr) {
   LoxType object = eval(expr->object());
 
   if (object.isType<LoxInstance *>()) {
+    RootGuard guard(&object);
     LoxType val = eval(expr->value());
 
-    object.getValue<LoxInstance *>()->set(expr->name(), val);
+    object.getValue<LoxInstance *>()->set(expr->name(), val, expr->cache());
 
     return;
   }
@@ -288,32 +473,111 @@ void Interpreter::visitThis(const Expr::ThisExpr *expr) {
   _value = lookupVariable(expr->keyword(), expr);
 }
 
-void Interpreter::resolve(const Expr::Expr *expr, int depth) {
-  _locals[expr] = depth;
+void Interpreter::visitSuper(const Expr::SuperExpr *expr) {
+  LoxFunction *method = lookupVariable(expr->keyword(), expr)
+                            .getValue<LoxClass *>()
+                            ->superMethod(expr->method());
+  _value = method->bind(eval(expr->self()).getValue<LoxInstance *>());
+}
+
+void Interpreter::visitInline(const Expr::InlineExpr *expr) {
+  LoxType callee = eval(expr->call()->callee());
+  if (callee.isType<LoxFunction *>() &&
+      callee.getValue<LoxFunction *>()->declaration() == expr->function())
+    evalutate(expr->body());
+  else
+    visitCall(expr->call());
+}
+
+void Interpreter::resolveScript(FunctionInfo info) {
+  _scriptInfo = std::move(info);
+}
+
+void Interpreter::memoize(
+    const Stmt::FunctionStmt *stmt, size_t capacity,
+    const std::unordered_map<std::string, const Stmt::Declaration *> &dependencies) {
+  auto watch = std::make_shared<MemoWatch>();
+  watch->function = stmt;
+  watch->memo = std::make_shared<Memo>(stmt->name().lexeme(), capacity);
+  watch->pending = dependencies.size();
+  _memos.push_back(watch->memo);
+
+  if (watch->pending == 0)
+    stmt->memoize(watch->memo);
+  for (const auto &[name, declaration] : dependencies)
+    _memoWatches[name].emplace_back(declaration, watch);
+}
+
+void Interpreter::reportMemoStats(std::ostream &outs) const {
+  for (const std::shared_ptr<Memo> &memo : _memos)
+    memo->reportStats(outs);
+}
+
+void Interpreter::markRoots(Heap &heap) {
+  heap.mark(_value);
+  heap.mark(_globals.get());
+  heap.mark(_tailCall.callee);
+  heap.mark(_tailCall.receiver);
+  for (LoxType &arg : _tailCall.args)
+    heap.mark(arg);
+  _stack.mark(heap);
 }
 
 void Interpreter::evalutate(const Expr::Expr *expr) { expr->accept(this); }
 
-void Interpreter::execute(const Stmt::Stmt *statement) {
+// Statement boundaries are the collector's safepoints.
+Completion Interpreter::execute(const Stmt::Stmt *statement) {
+  Heap &heap = Heap::instance();
+  if (heap.shouldCollect())
+    heap.collect();
+
   statement->accept(this);
+  return _completion;
 }
 
-void Interpreter::executeBlock(
-    std::shared_ptr<Environment> env,
-    const std::vector<const Stmt::Stmt *> &statements) {
-  std::shared_ptr<Environment> prev = _environment;
-
-  try {
-    _environment = env;
+Completion Interpreter::executeBlock(
+    Frame &frame, const std::vector<const Stmt::Stmt *> &statements) {
+  FrameGuard guard(*this, frame);
 
-    for (const Stmt::Stmt *statement : statements) {
-      execute(statement);
-    }
-    _environment = prev;
-  } catch (RuntimeError err) {
-    _environment = prev;
-    throw err;
+  for (const Stmt::Stmt *statement : statements) {
+    Completion completion = execute(statement);
+    if (completion != Completion::NORMAL)
+      return completion;
   }
+
+  return Completion::NORMAL;
+}
+
+// Handles a return that ended the running function.
+LoxType Interpreter::takeReturnValue() {
+  _completion = Completion::NORMAL;
+  return _value;
+}
+
+LoxFunction *Interpreter::takeTailCall(LoxType *base, LoxType &callee,
+                                       LoxType &receiver,
+                                       std::span<const LoxType> &args) {
+  _completion = Completion::NORMAL;
+  callee = _tailCall.callee;
+  receiver = _tailCall.receiver;
+  LoxFunction *function = _tailCall.method != nullptr
+                              ? _tailCall.method
+                              : callee.getValue<LoxFunction *>();
+
+  const Token &name = function->declaration()->name();
+  _stack.popTo(base);
+  if (function->info().method)
+    _stack.push(receiver, name);
+  LoxType *first = _stack.top();
+  for (const LoxType &arg : _tailCall.args)
+    _stack.push(arg, name);
+  args = std::span<const LoxType>(first, _tailCall.args.size());
+
+  // The buffer of the arguments is kept for the next tail call.
+  _tailCall.callee = LoxType();
+  _tailCall.receiver = LoxType();
+  _tailCall.args.clear();
+  return function;
 }
 
 void Interpreter::enforceDouble(Token op, const LoxType &val) {
@@ -342,11 +606,88 @@ bool Interpreter::isTruthyVal(const LoxType &val) {
                      "Cannot determine if value is truthy");
 }
 
-LoxType Interpreter::lookupVariable(const Token &name, const Expr::Expr *expr) {
-  if (_locals.contains(expr)) {
-    int distance = _locals[expr];
+LoxType Interpreter::lookupVariable(const Token &name,
+                                    const Expr::Reference *expr) {
+  const Local *local = expr->local();
+  if (local == nullptr)
+    return _globals->get(name);
+
+  switch (local->type) {
+  case Local::SLOT:
+    return _frame->slots[local->index];
+  case Local::CELL:
+    return _frame->cells[local->index]->get();
+  case Local::UPVALUE:
+    return _frame->upvalues[local->index]->get();
+  }
+
+  return LoxType();
+}
+
+// Creates the storage of a local declaration, globals need none. Cells are
+// created before the initializer runs, so that a function can capture
+// itself.
+void Interpreter::declare(const Stmt::Declaration *stmt) {
+  const Local *local = stmt->local();
+  if (local == nullptr)
+    return;
+
+  if (_frame == &_script)
+    _stack.reserve(local->index + 1);
+  if (local->type == Local::CELL)
+    _frame->cells[local->index] = Heap::instance().make<Upvalue>();
+}
 
-    return _environment->getAt(distance, name);
+void Interpreter::define(const Stmt::Declaration *stmt, const Token &name,
+                         LoxType value) {
+  if (const Local *local = stmt->local()) {
+    store(*_frame, *local, value);
+  } else {
+    _globals->define(name.symbol(), value);
+    globalWritten(name, stmt);
   }
-  return _globals->get(name);
 }
+
+// Hands a memoized function its Memo once the declarations of the globals
+// it depends on have all run. Any other write to one of them, an assignment
+// or a declaration at a later prompt, takes the Memo away for good: the
+// function may now see another value or call an impure function.
+void Interpreter::globalWritten(const Token &name,
+                                const Stmt::Declaration *declaration) {
+  if (_memoWatches.empty())
+    return;
+  auto it = _memoWatches.find(name.lexeme());
+  if (it == _memoWatches.end())
+    return;
+
+  for (auto &[expected, watch] : it->second) {
+    if (watch->dropped)
+      continue;
+    if (declaration == expected) {
+      if (--watch->pending == 0)
+        watch->function->memoize(watch->memo);
+    } else {
+      watch->dropped = true;
+      watch->function->memoize(nullptr);
+    }
+  }
+
+  std::erase_if(it->second, [](const auto &entry) { return entry.second->dropped; });
+  if (it->second.empty())
+    _memoWatches.erase(it);
+}
+
+void Interpreter::store(Frame &frame, const Local &local, LoxType value) {
+  switch (local.type) {
+  case Local::SLOT:
+    frame.slots[local.index] = value;
+    break;
+  case Local::CELL:
+    frame.cells[local.index]->set(value);
+    break;
+  case Local::UPVALUE:
+    frame.upvalues[local.index]->set(value);
+    break;
+  }
+}
+
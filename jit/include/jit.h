@@ -0,0 +1,69 @@
+#pragma once
+
+#include <compilation_unit.h>
+#include <lox_type.h>
+#include <stmt.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+struct FunctionInfo;
+
+namespace Jit {
+
+// Calls a LoxFunction is interpreted for before it is compiled.
+constexpr uint32_t THRESHOLD = 10;
+
+// Machine code of one function, mapped into executable memory.
+class Code {
+public:
+  // How the code returned. BAIL means it could not run the call, and the
+  // interpreter has to.
+  enum Exit { NUMBER, NIL, FALSE, TRUE, BAIL };
+
+  // Returns nullptr if the platform can not run the code.
+  static std::unique_ptr<Code> load(const std::vector<uint8_t> &);
+  ~Code();
+
+  Code(const Code &) = delete;
+  Code &operator=(const Code &) = delete;
+
+  // Runs a call, returns false if it bailed out.
+  bool run(std::span<const LoxType> args, LoxType &result) const;
+
+private:
+  typedef int (*Entry)(const LoxType *, double *);
+
+  Code(void *memory, size_t size) : _memory(memory), _size(size) {}
+
+  void *_memory;
+  size_t _size;
+};
+
+// Compiles functions that only compute with numbers: their parameters and
+// locals, arithmetic, comparisons, conditionals and loops. Anything else,
+// calls, globals, captured variables, strings, printing, is left to the
+// interpreter. Since the code has no side effects besides its own frame,
+// a call that bails out halfway is simply run again by the interpreter.
+// The code checks that the arguments are numbers and bails out otherwise,
+// and bails out of divisions by zero so the interpreter reports them.
+class Compiler {
+public:
+  // Returns the code of a function, or nullptr if it can not be compiled.
+  // Each declaration is compiled once.
+  const Code *compile(const Stmt::FunctionStmt *, const FunctionInfo &);
+
+private:
+  struct Entry {
+    // Keeps the declaration from being freed, and its address reused.
+    std::shared_ptr<CompilationUnit> unit;
+    std::unique_ptr<Code> code;
+  };
+
+  std::unordered_map<const Stmt::FunctionStmt *, Entry> _code;
+};
+
+} // namespace Jit
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Jit {
+
+// Emits the x86-64 instructions compiled functions are built from. Numbers
+// are computed in the SSE registers, locals live in the machine frame below
+// rbp, one double per slot. Compiled code is called as
+//   int code(const LoxType *args, double *result)
+// and returns one of the exits of Code.
+class Assembler {
+public:
+  // Registers expressions are evaluated in, the rest are scratch.
+  static constexpr int REGISTERS = 14;
+  static constexpr int SCRATCH = 14;
+  static constexpr int ZERO = 15;
+
+  // A register, a slot of the frame or a constant.
+  struct Operand {
+    enum Kind { XMM, SLOT, CONSTANT };
+
+    Kind kind;
+    int index;
+
+    static Operand xmm(int index) { return {XMM, index}; }
+    static Operand slot(int index) { return {SLOT, index}; }
+    static Operand constant(int index) { return {CONSTANT, index}; }
+  };
+
+  // Flags tested by conditional jumps, as encoded in Jcc. ucomisd sets
+  // them like an unsigned compare, and sets all of ZF, PF and CF when
+  // either operand is NaN.
+  enum Condition : uint8_t {
+    BELOW = 0x2,
+    ABOVE_EQUAL = 0x3,
+    EQUAL = 0x4,
+    NOT_EQUAL = 0x5,
+    BELOW_EQUAL = 0x6,
+    ABOVE = 0x7,
+    PARITY = 0xa,
+  };
+
+  enum Arithmetic : uint8_t {
+    ADD = 0x58,
+    MULTIPLY = 0x59,
+    SUBTRACT = 0x5c,
+    DIVIDE = 0x5e,
+  };
+
+  // A position in the code, jumps to it are patched once it is bound.
+  struct Label {
+    std::ptrdiff_t position = -1;
+    std::vector<size_t> uses;
+  };
+
+  // Sets up a frame of the given number of slots.
+  void enter(int slots);
+  // Copies an argument to a slot, jumping to bail if it is not a number.
+  void loadArgument(int arg, int slot, Label &bail);
+  // Returns the exit to the caller.
+  void leave(int exit);
+  // Stores a register to the result.
+  void storeResult(int xmm);
+
+  void movsd(Operand to, Operand from);
+  void arithmetic(Arithmetic, int xmm, Operand);
+  void ucomisd(int xmm, Operand);
+  void xorpd(int xmm, int other);
+
+  void jump(Label &);
+  void jump(Condition, Label &);
+  void bind(Label &);
+
+  int addConstant(double);
+
+  // The machine code, followed by the constants it reads.
+  std::vector<uint8_t> finish();
+
+private:
+  struct Fixup {
+    size_t position;
+    int constant;
+  };
+
+  void emit(uint8_t byte) { _code.push_back(byte); }
+  void emit32(int32_t);
+  void emit64(uint64_t);
+  void sse(uint8_t prefix, uint8_t opcode, int reg, Operand);
+  void patch(size_t use, size_t target);
+
+  std::vector<uint8_t> _code;
+  std::vector<double> _constants;
+  std::vector<Fixup> _fixups;
+};
+
+} // namespace Jit
@@ -0,0 +1,514 @@
+#include <jit.h>
+#include <interpreter.h>
+#include <x64_assembler.h>
+
+#include <cstring>
+
+#if LOX_JIT
+#include <sys/mman.h>
+#endif
+
+namespace Jit {
+
+namespace {
+
+typedef Assembler::Operand Operand;
+typedef Assembler::Label Label;
+
+// What an expression evaluates to, if the JIT can compile it. Numbers are
+// computed in registers, booleans only decide where to jump.
+enum Type { NONE, NUMBER, BOOL };
+
+const Expr::Expr *ungroup(const Expr::Expr *expr) {
+  while (auto grouping = dynamic_cast<const Expr::GroupingExpr *>(expr))
+    expr = grouping->expr();
+  return expr;
+}
+
+// Translates one function declaration. Values are computed in the
+// register given as target, subexpressions use the registers above it.
+class FunctionCompiler : public Expr::ExprVisitor, public Stmt::StmtVisitor {
+public:
+  // Returns no code if the function uses anything the JIT does not support.
+  std::vector<uint8_t> compile(const Stmt::FunctionStmt *declaration,
+                               const FunctionInfo &info) {
+    if (info.method || info.hasCells || !info.captures.empty())
+      return {};
+
+    _asm.enter(info.slots);
+    for (size_t i = 0; i < info.params.size(); i++) {
+      if (info.params[i].type != Local::SLOT)
+        return {};
+      _asm.loadArgument(i, info.params[i].index, _bail);
+    }
+
+    for (const Stmt::Stmt *stmt : declaration->body())
+      compile(stmt);
+    _asm.leave(Code::NIL);
+    _asm.bind(_bail);
+    _asm.leave(Code::BAIL);
+
+    if (!_supported)
+      return {};
+    return _asm.finish();
+  }
+
+  void visitExprStmt(const Stmt::ExprStmt *stmt) override {
+    discard(stmt->expr());
+  }
+
+  void visitPrintStmt(const Stmt::PrintStmt *) override { _supported = false; }
+
+  void visitVarStmt(const Stmt::VarStmt *stmt) override {
+    const Local *local = stmt->local();
+    if (local == nullptr || local->type != Local::SLOT ||
+        stmt->init() == nullptr || type(stmt->init()) != NUMBER) {
+      _supported = false;
+      return;
+    }
+
+    compile(stmt->init(), 0);
+    _asm.movsd(Operand::slot(local->index), Operand::xmm(0));
+  }
+
+  void visitBlock(const Stmt::Block *stmt) override {
+    for (const Stmt::Stmt *inner : stmt->statements())
+      compile(inner);
+  }
+
+  void visitIfStmt(const Stmt::IfStmt *stmt) override {
+    Label otherwise, end;
+    branch(stmt->condition(), false, otherwise, 0);
+    compile(stmt->thenBranch());
+    if (stmt->elseBranch() != nullptr)
+      _asm.jump(end);
+    _asm.bind(otherwise);
+    if (stmt->elseBranch() != nullptr)
+      compile(stmt->elseBranch());
+    _asm.bind(end);
+  }
+
+  void visitWhileStmt(const Stmt::WhileStmt *stmt) override {
+    Label loop, exit;
+    _asm.bind(loop);
+    branch(stmt->condition(), false, exit, 0);
+    compile(stmt->body());
+    _asm.jump(loop);
+    _asm.bind(exit);
+  }
+
+  void visitForStmt(const Stmt::ForStmt *stmt) override {
+    if (stmt->init() != nullptr)
+      compile(stmt->init());
+
+    Label loop, exit;
+    _asm.bind(loop);
+    if (stmt->condition() != nullptr)
+      branch(stmt->condition(), false, exit, 0);
+    compile(stmt->body());
+    if (stmt->after() != nullptr)
+      discard(stmt->after());
+    _asm.jump(loop);
+    _asm.bind(exit);
+  }
+
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override {
+    _supported = false;
+  }
+
+  void visitReturnStmt(const Stmt::ReturnStmt *stmt) override {
+    if (stmt->expr() == nullptr) {
+      _asm.leave(Code::NIL);
+      return;
+    }
+
+    switch (type(stmt->expr())) {
+    case NUMBER:
+      compile(stmt->expr(), 0);
+      _asm.storeResult(0);
+      _asm.leave(Code::NUMBER);
+      break;
+    case BOOL: {
+      Label otherwise;
+      branch(stmt->expr(), false, otherwise, 0);
+      _asm.leave(Code::TRUE);
+      _asm.bind(otherwise);
+      _asm.leave(Code::FALSE);
+      break;
+    }
+    case NONE:
+      _supported = false;
+      break;
+    }
+  }
+
+  void visitClassStmt(const Stmt::ClassStmt *) override { _supported = false; }
+
+  // Only expressions of type NUMBER are visited, the others are compiled by
+  // branch.
+  void visitBinary(const Expr::BinaryExpr *expr) override {
+    int target = _target;
+    compile(expr->left(), target);
+    Operand right = operand(expr->right(), target + 1);
+
+    switch (expr->op().type()) {
+    case PLUS:
+      _asm.arithmetic(Assembler::ADD, target, right);
+      break;
+    case MINUS:
+      _asm.arithmetic(Assembler::SUBTRACT, target, right);
+      break;
+    case STAR:
+      _asm.arithmetic(Assembler::MULTIPLY, target, right);
+      break;
+    case SLASH: {
+      auto divisor = dynamic_cast<const Expr::LiteralExpr *>(ungroup(expr->right()));
+      if (divisor == nullptr || divisor->value().getValue<double>() == 0) {
+        // The interpreter reports the division by zero.
+        if (right.kind != Operand::XMM) {
+          _asm.movsd(Operand::xmm(Assembler::SCRATCH), right);
+          right = Operand::xmm(Assembler::SCRATCH);
+        }
+        _asm.xorpd(Assembler::ZERO, Assembler::ZERO);
+        _asm.ucomisd(right.index, Operand::xmm(Assembler::ZERO));
+        jumpIfEqual(true, _bail);
+      }
+      _asm.arithmetic(Assembler::DIVIDE, target, right);
+      break;
+    }
+    default:
+      _supported = false;
+    }
+  }
+
+  void visitLiteral(const Expr::LiteralExpr *expr) override {
+    double value = expr->value().getValue<double>();
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(value));
+    if (bits == 0)
+      _asm.xorpd(_target, _target);
+    else
+      _asm.movsd(Operand::xmm(_target), Operand::constant(_asm.addConstant(value)));
+  }
+
+  void visitUnary(const Expr::UnaryExpr *expr) override {
+    compile(expr->right(), _target);
+    // Flips the sign bit, so that -0 is kept apart from 0.
+    _asm.movsd(Operand::xmm(Assembler::SCRATCH),
+               Operand::constant(_asm.addConstant(-0.0)));
+    _asm.xorpd(_target, Assembler::SCRATCH);
+  }
+
+  void visitGrouping(const Expr::GroupingExpr *expr) override {
+    compile(expr->expr(), _target);
+  }
+
+  void visitTernary(const Expr::TernaryExpr *expr) override {
+    int target = _target;
+    Label otherwise, end;
+    branch(expr->condition(), false, otherwise, target);
+    compile(expr->first(), target);
+    _asm.jump(end);
+    _asm.bind(otherwise);
+    compile(expr->second(), target);
+    _asm.bind(end);
+  }
+
+  void visitVariable(const Expr::VariableExpr *expr) override {
+    _asm.movsd(Operand::xmm(_target), Operand::slot(slot(expr)->index));
+  }
+
+  void visitAssign(const Expr::AssignExpr *expr) override {
+    int target = _target;
+    compile(expr->value(), target);
+    _asm.movsd(Operand::slot(slot(expr)->index), Operand::xmm(target));
+  }
+
+  void visitLogic(const Expr::LogicExpr *) override { _supported = false; }
+  void visitCall(const Expr::CallExpr *) override { _supported = false; }
+  void visitGet(const Expr::GetExpr *) override { _supported = false; }
+  void visitSet(const Expr::SetExpr *) override { _supported = false; }
+  void visitThis(const Expr::ThisExpr *) override { _supported = false; }
+  void visitSuper(const Expr::SuperExpr *) override { _supported = false; }
+  void visitInline(const Expr::InlineExpr *) override { _supported = false; }
+
+private:
+  void compile(const Stmt::Stmt *stmt) {
+    if (_supported)
+      stmt->accept(this);
+  }
+
+  void compile(const Expr::Expr *expr, int target) {
+    if (target >= Assembler::REGISTERS) {
+      _supported = false;
+      return;
+    }
+
+    int prev = _target;
+    _target = target;
+    expr->accept(this);
+    _target = prev;
+  }
+
+  // Evaluates an expression for its assignments.
+  void discard(const Expr::Expr *expr) {
+    switch (type(expr)) {
+    case NUMBER:
+      compile(expr, 0);
+      break;
+    case BOOL: {
+      Label next;
+      branch(expr, true, next, 0);
+      _asm.bind(next);
+      break;
+    }
+    case NONE:
+      _supported = false;
+      break;
+    }
+  }
+
+  // Locals and constants are read straight from memory, anything else is
+  // compiled into the given register.
+  Operand operand(const Expr::Expr *expr, int target) {
+    expr = ungroup(expr);
+    if (auto literal = dynamic_cast<const Expr::LiteralExpr *>(expr))
+      return Operand::constant(_asm.addConstant(literal->value().getValue<double>()));
+    if (auto variable = dynamic_cast<const Expr::VariableExpr *>(expr))
+      return Operand::slot(slot(variable)->index);
+
+    compile(expr, target);
+    return Operand::xmm(target);
+  }
+
+  // Jumps to the label if the truthiness of the expression is the given one,
+  // and falls through otherwise.
+  void branch(const Expr::Expr *expr, bool when, Label &label, int reg) {
+    if (type(expr) == NONE) {
+      _supported = false;
+      return;
+    }
+    expr = ungroup(expr);
+
+    if (auto literal = dynamic_cast<const Expr::LiteralExpr *>(expr)) {
+      if (Interpreter::isTruthyVal(literal->value()) == when)
+        _asm.jump(label);
+      return;
+    }
+
+    if (auto unary = dynamic_cast<const Expr::UnaryExpr *>(expr)) {
+      if (unary->op().type() == BANG) {
+        branch(unary->right(), !when, label, reg);
+        return;
+      }
+    }
+
+    if (auto logic = dynamic_cast<const Expr::LogicExpr *>(expr)) {
+      // The first operand decides an or when it is truthy, an and when it
+      // is not.
+      bool decides = logic->op().type() == OR;
+      if (decides == when) {
+        branch(logic->first(), when, label, reg);
+        branch(logic->second(), when, label, reg);
+      } else {
+        Label next;
+        branch(logic->first(), decides, next, reg);
+        branch(logic->second(), when, label, reg);
+        _asm.bind(next);
+      }
+      return;
+    }
+
+    if (auto ternary = dynamic_cast<const Expr::TernaryExpr *>(expr)) {
+      Label otherwise, end;
+      branch(ternary->condition(), false, otherwise, reg);
+      branch(ternary->first(), when, label, reg);
+      _asm.jump(end);
+      _asm.bind(otherwise);
+      branch(ternary->second(), when, label, reg);
+      _asm.bind(end);
+      return;
+    }
+
+    if (auto binary = dynamic_cast<const Expr::BinaryExpr *>(expr)) {
+      if (type(binary) == BOOL) {
+        compare(binary, when, label, reg);
+        return;
+      }
+    }
+
+    // A number is truthy unless it is 0.
+    compile(expr, reg);
+    _asm.xorpd(Assembler::ZERO, Assembler::ZERO);
+    _asm.ucomisd(reg, Operand::xmm(Assembler::ZERO));
+    jumpIfEqual(!when, label);
+  }
+
+  void compare(const Expr::BinaryExpr *expr, bool when, Label &label, int reg) {
+    compile(expr->left(), reg);
+    Operand right = operand(expr->right(), reg + 1);
+    TOKEN_TYPE op = expr->op().type();
+
+    if (op == EQUAL_EQUAL || op == BANG_EQUAL) {
+      _asm.ucomisd(reg, right);
+      jumpIfEqual(when == (op == EQUAL_EQUAL), label);
+      return;
+    }
+
+    // Only ABOVE and ABOVE_EQUAL are false for NaN, so the operands of
+    // LESS and LESS_EQUAL are swapped.
+    if (op == LESS || op == LESS_EQUAL) {
+      if (right.kind != Operand::XMM) {
+        _asm.movsd(Operand::xmm(Assembler::SCRATCH), right);
+        right = Operand::xmm(Assembler::SCRATCH);
+      }
+      _asm.ucomisd(right.index, Operand::xmm(reg));
+    } else {
+      _asm.ucomisd(reg, right);
+    }
+
+    bool orEqual = op == LESS_EQUAL || op == GREATER_EQUAL;
+    if (when)
+      _asm.jump(orEqual ? Assembler::ABOVE_EQUAL : Assembler::ABOVE, label);
+    else
+      _asm.jump(orEqual ? Assembler::BELOW : Assembler::BELOW_EQUAL, label);
+  }
+
+  // Jumps on the result of ucomisd, an unordered compare is not equal.
+  void jumpIfEqual(bool equal, Label &label) {
+    if (equal) {
+      Label unordered;
+      _asm.jump(Assembler::PARITY, unordered);
+      _asm.jump(Assembler::EQUAL, label);
+      _asm.bind(unordered);
+    } else {
+      _asm.jump(Assembler::PARITY, label);
+      _asm.jump(Assembler::NOT_EQUAL, label);
+    }
+  }
+
+  Type type(const Expr::Expr *expr) const {
+    expr = ungroup(expr);
+
+    if (auto literal = dynamic_cast<const Expr::LiteralExpr *>(expr)) {
+      if (literal->value().isType<double>())
+        return NUMBER;
+      return literal->value().isType<bool>() ? BOOL : NONE;
+    }
+    if (auto variable = dynamic_cast<const Expr::VariableExpr *>(expr))
+      return slot(variable) != nullptr ? NUMBER : NONE;
+    if (auto assign = dynamic_cast<const Expr::AssignExpr *>(expr)) {
+      return slot(assign) != nullptr && type(assign->value()) == NUMBER ? NUMBER
+                                                                         : NONE;
+    }
+    if (auto unary = dynamic_cast<const Expr::UnaryExpr *>(expr)) {
+      Type right = type(unary->right());
+      if (unary->op().type() == MINUS)
+        return right == NUMBER ? NUMBER : NONE;
+      return unary->op().type() == BANG && right != NONE ? BOOL : NONE;
+    }
+    if (auto binary = dynamic_cast<const Expr::BinaryExpr *>(expr)) {
+      if (type(binary->left()) != NUMBER || type(binary->right()) != NUMBER)
+        return NONE;
+      switch (binary->op().type()) {
+      case PLUS:
+      case MINUS:
+      case STAR:
+      case SLASH:
+        return NUMBER;
+      case GREATER:
+      case GREATER_EQUAL:
+      case LESS:
+      case LESS_EQUAL:
+      case EQUAL_EQUAL:
+      case BANG_EQUAL:
+        return BOOL;
+      default:
+        return NONE;
+      }
+    }
+    if (auto logic = dynamic_cast<const Expr::LogicExpr *>(expr)) {
+      return type(logic->first()) != NONE && type(logic->second()) != NONE
+                 ? BOOL
+                 : NONE;
+    }
+    if (auto ternary = dynamic_cast<const Expr::TernaryExpr *>(expr)) {
+      Type first = type(ternary->first());
+      return type(ternary->condition()) != NONE && first == type(ternary->second())
+                 ? first
+                 : NONE;
+    }
+    return NONE;
+  }
+
+  const Local *slot(const Expr::Reference *expr) const {
+    const Local *local = expr->local();
+    return local != nullptr && local->type == Local::SLOT ? local : nullptr;
+  }
+
+  Assembler _asm;
+  Label _bail;
+  int _target = 0;
+  bool _supported = true;
+};
+
+} // namespace
+
+std::unique_ptr<Code> Code::load(const std::vector<uint8_t> &code) {
+#if LOX_JIT
+  // Written while writable, then made executable instead.
+  void *memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return nullptr;
+
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, code.size());
+    return nullptr;
+  }
+  return std::unique_ptr<Code>(new Code(memory, code.size()));
+#else
+  return nullptr;
+#endif
+}
+
+Code::~Code() {
+#if LOX_JIT
+  munmap(_memory, _size);
+#endif
+}
+
+bool Code::run(std::span<const LoxType> args, LoxType &result) const {
+  double number;
+  switch (reinterpret_cast<Entry>(_memory)(args.data(), &number)) {
+  case NUMBER:
+    result = LoxType(number);
+    return true;
+  case NIL:
+    result = LoxType();
+    return true;
+  case FALSE:
+    result = false;
+    return true;
+  case TRUE:
+    result = true;
+    return true;
+  default:
+    return false;
+  }
+}
+
+const Code *Compiler::compile(const Stmt::FunctionStmt *declaration,
+                              const FunctionInfo &info) {
+  auto it = _code.find(declaration);
+  if (it == _code.end()) {
+    std::vector<uint8_t> code = FunctionCompiler().compile(declaration, info);
+    Entry entry{declaration->unit()->shared_from_this(),
+                code.empty() ? nullptr : Code::load(code)};
+    it = _code.emplace(declaration, std::move(entry)).first;
+  }
+  return it->second.code.get();
+}
+
+} // namespace Jit
@@ -0,0 +1,164 @@
+#include <x64_assembler.h>
+
+#include <cstring>
+
+namespace Jit {
+
+namespace {
+
+// LoxType boxes everything but numbers in a negative quiet NaN, so a value
+// is a number unless all of these bits are set.
+constexpr uint64_t BOX_MASK = 0xfff8000000000000;
+
+constexpr uint8_t REX = 0x40;
+constexpr uint8_t REX_W = 0x48;
+
+int32_t slotOffset(int slot) { return -8 * (slot + 1); }
+
+} // namespace
+
+void Assembler::enter(int slots) {
+  emit(0x55); // push rbp
+  emit(REX_W), emit(0x89), emit(0xe5); // mov rbp, rsp
+  emit(REX_W), emit(0x81), emit(0xec); // sub rsp, frame
+  emit32((8 * slots + 15) & ~15);
+  emit(REX_W), emit(0xb9); // mov rcx, BOX_MASK
+  emit64(BOX_MASK);
+}
+
+void Assembler::loadArgument(int arg, int slot, Label &bail) {
+  emit(REX_W), emit(0x8b), emit(0x87); // mov rax, [rdi + arg]
+  emit32(8 * arg);
+  emit(REX_W), emit(0x89), emit(0xc2); // mov rdx, rax
+  emit(REX_W), emit(0x21), emit(0xca); // and rdx, rcx
+  emit(REX_W), emit(0x39), emit(0xca); // cmp rdx, rcx
+  jump(EQUAL, bail);
+  emit(REX_W), emit(0x89), emit(0x85); // mov [rbp + slot], rax
+  emit32(slotOffset(slot));
+}
+
+void Assembler::leave(int exit) {
+  emit(0xb8); // mov eax, exit
+  emit32(exit);
+  emit(0xc9); // leave
+  emit(0xc3); // ret
+}
+
+void Assembler::storeResult(int xmm) {
+  emit(0xf2);
+  if (xmm >= 8)
+    emit(REX | 0x4);
+  emit(0x0f), emit(0x11); // movsd [rsi], xmm
+  emit(((xmm & 7) << 3) | 0x6);
+}
+
+void Assembler::movsd(Operand to, Operand from) {
+  if (to.kind != Operand::XMM)
+    sse(0xf2, 0x11, from.index, to);
+  else if (from.kind == Operand::XMM)
+    sse(0x66, 0x28, to.index, from); // movapd
+  else
+    sse(0xf2, 0x10, to.index, from);
+}
+
+void Assembler::arithmetic(Arithmetic op, int xmm, Operand operand) {
+  sse(0xf2, op, xmm, operand);
+}
+
+void Assembler::ucomisd(int xmm, Operand operand) {
+  sse(0x66, 0x2e, xmm, operand);
+}
+
+void Assembler::xorpd(int xmm, int other) {
+  sse(0x66, 0x57, xmm, Operand::xmm(other));
+}
+
+void Assembler::jump(Label &label) {
+  emit(0xe9);
+  label.uses.push_back(_code.size());
+  emit32(0);
+  if (label.position >= 0)
+    patch(label.uses.back(), label.position);
+}
+
+void Assembler::jump(Condition condition, Label &label) {
+  emit(0x0f), emit(0x80 | condition);
+  label.uses.push_back(_code.size());
+  emit32(0);
+  if (label.position >= 0)
+    patch(label.uses.back(), label.position);
+}
+
+void Assembler::bind(Label &label) {
+  label.position = _code.size();
+  for (size_t use : label.uses)
+    patch(use, label.position);
+}
+
+int Assembler::addConstant(double value) {
+  for (size_t i = 0; i < _constants.size(); i++) {
+    if (std::memcmp(&_constants[i], &value, sizeof(value)) == 0)
+      return i;
+  }
+  _constants.push_back(value);
+  return _constants.size() - 1;
+}
+
+std::vector<uint8_t> Assembler::finish() {
+  while (_code.size() % 8 != 0)
+    emit(0xcc); // int3
+  size_t constants = _code.size();
+  for (double value : _constants) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(value));
+    emit64(bits);
+  }
+
+  for (const Fixup &fixup : _fixups) {
+    int32_t offset = constants + 8 * fixup.constant - (fixup.position + 4);
+    std::memcpy(&_code[fixup.position], &offset, sizeof(offset));
+  }
+  return std::move(_code);
+}
+
+void Assembler::emit32(int32_t value) {
+  for (int i = 0; i < 4; i++)
+    emit(uint32_t(value) >> (8 * i));
+}
+
+void Assembler::emit64(uint64_t value) {
+  for (int i = 0; i < 8; i++)
+    emit(value >> (8 * i));
+}
+
+void Assembler::sse(uint8_t prefix, uint8_t opcode, int reg, Operand operand) {
+  emit(prefix);
+  uint8_t rex = REX | (reg >= 8 ? 0x4 : 0);
+  if (operand.kind == Operand::XMM && operand.index >= 8)
+    rex |= 0x1;
+  if (rex != REX)
+    emit(rex);
+  emit(0x0f), emit(opcode);
+
+  switch (operand.kind) {
+  case Operand::XMM:
+    emit(0xc0 | ((reg & 7) << 3) | (operand.index & 7));
+    break;
+  case Operand::SLOT: // [rbp + disp32]
+    emit(0x80 | ((reg & 7) << 3) | 0x5);
+    emit32(slotOffset(operand.index));
+    break;
+  case Operand::CONSTANT: // [rip + disp32], patched by finish
+    emit(((reg & 7) << 3) | 0x5);
+    _fixups.push_back({_code.size(), operand.index});
+    emit32(0);
+    break;
+  }
+}
+
+void Assembler::patch(size_t use, size_t target) {
+  int32_t offset = target - (use + 4);
+  std::memcpy(&_code[use], &offset, sizeof(offset));
+}
+
+} // namespace Jit
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <jit.h>
+#include <x64_assembler.h>
+
+#include <string>
+
+using namespace Jit;
+
+typedef Assembler::Operand Operand;
+
+TEST(AssemblerTest, ComputesWithConstants) {
+  Assembler assembler;
+  assembler.enter(0);
+  assembler.movsd(Operand::xmm(9), Operand::constant(assembler.addConstant(1.5)));
+  assembler.arithmetic(Assembler::MULTIPLY, 9,
+                       Operand::constant(assembler.addConstant(4)));
+  assembler.storeResult(9);
+  assembler.leave(Code::NUMBER);
+
+  std::unique_ptr<Code> code = Code::load(assembler.finish());
+  if (code == nullptr)
+    GTEST_SKIP() << "Machine code can not be run on this platform";
+
+  LoxType result;
+  ASSERT_TRUE(code->run({}, result));
+  EXPECT_EQ(result.getValue<double>(), 6.0);
+}
+
+TEST(AssemblerTest, ArgumentsMustBeNumbers) {
+  Assembler assembler;
+  Assembler::Label bail;
+  assembler.enter(2);
+  assembler.loadArgument(0, 1, bail);
+  assembler.movsd(Operand::xmm(0), Operand::slot(1));
+  assembler.arithmetic(Assembler::ADD, 0, Operand::slot(1));
+  assembler.storeResult(0);
+  assembler.leave(Code::NUMBER);
+  assembler.bind(bail);
+  assembler.leave(Code::BAIL);
+
+  std::unique_ptr<Code> code = Code::load(assembler.finish());
+  if (code == nullptr)
+    GTEST_SKIP() << "Machine code can not be run on this platform";
+
+  LoxType result;
+  LoxType number(2.5), string(std::string("lox"));
+  ASSERT_TRUE(code->run({&number, 1}, result));
+  EXPECT_EQ(result.getValue<double>(), 5.0);
+  EXPECT_FALSE(code->run({&string, 1}, result));
+}
+
+TEST(AssemblerTest, JumpsTestTheComparison) {
+  // Returns true if the argument is below 10, NaN is not.
+  Assembler assembler;
+  Assembler::Label bail, below;
+  assembler.enter(1);
+  assembler.loadArgument(0, 0, bail);
+  assembler.movsd(Operand::xmm(0), Operand::constant(assembler.addConstant(10)));
+  assembler.ucomisd(0, Operand::slot(0));
+  assembler.jump(Assembler::ABOVE, below);
+  assembler.leave(Code::FALSE);
+  assembler.bind(below);
+  assembler.leave(Code::TRUE);
+  assembler.bind(bail);
+  assembler.leave(Code::BAIL);
+
+  std::unique_ptr<Code> code = Code::load(assembler.finish());
+  if (code == nullptr)
+    GTEST_SKIP() << "Machine code can not be run on this platform";
+
+  LoxType result, one(1.0), twenty(20.0), nan(0.0 / 0.0);
+  ASSERT_TRUE(code->run({&one, 1}, result));
+  EXPECT_TRUE(result.getValue<bool>());
+  ASSERT_TRUE(code->run({&twenty, 1}, result));
+  EXPECT_FALSE(result.getValue<bool>());
+  ASSERT_TRUE(code->run({&nan, 1}, result));
+  EXPECT_FALSE(result.getValue<bool>());
+}
@@ -4,11 +4,39 @@
 #include <runtime_error.h>
 #include <parser.h>
 #include <interpreter.h>
+#include <pass.h>
 
+#include <memory>
+#include <ostream>
 #include <string>
 
+namespace Bytecode {
+class VM;
+}
+
+namespace Closure {
+class Engine;
+}
+
+namespace Register {
+class VM;
+}
+
+// How resolved code is executed.
+enum Engine { TREE_WALKER, CLOSURES, STACK_VM, REGISTER_VM };
+
 class Lox {
 public:
+  static void setEngine(Engine);
+  // The level of the passes run over the syntax tree, 0 runs none.
+  static void setOptimization(int level);
+  static void setInlineLimits(Optimizer::InlineLimits);
+  // Prints the syntax tree after the passes instead of running it.
+  static void setDumpAst(bool);
+  // Caches the results of calls to pure functions, keeping at most
+  // `capacity` per function, 0 caches none.
+  static void setMemoize(size_t capacity);
+  static void reportMemoStats(std::ostream &);
   static void runFile(const std::string &);
   static void runPrompt();
   static void run(const std::string &, bool);
@@ -16,6 +44,15 @@ public:
   static void report(size_t, const std::string &, const std::string &);
   static void runtime_error(RuntimeError err);
 private:
+  // Also holds the resolution of variables for the other engines.
   static Interpreter interpreter;
+  static std::unique_ptr<Closure::Engine> closures;
+  static std::unique_ptr<Bytecode::VM> vm;
+  static std::unique_ptr<Register::VM> registerVm;
+  static Engine engine;
+  static int optimization;
+  static Optimizer::InlineLimits inlineLimits;
+  static bool dumpAst;
+  static size_t memoize;
   static bool hadError;
 };
@@ -1,16 +1,46 @@
 #include "expr.h"
+#include <closure_engine.h>
+#include <compilation_unit.h>
 #include <file.h>
 #include <interpreter.h>
 #include <lox.h>
 #include <parser.h>
+#include <pass.h>
+#include <passes.h>
 #include <printer_visitor.h>
 #include <runtime_error.h>
 #include <tokenizer.h>
+#include <register_vm.h>
 #include <resolver.h>
+#include <vm.h>
 
 #include <iostream>
 #include <vector>
 
+void Lox::setEngine(Engine selected) {
+  engine = selected;
+  if (engine == CLOSURES && closures == nullptr)
+    closures = std::make_unique<Closure::Engine>();
+  if (engine == STACK_VM && vm == nullptr)
+    vm = std::make_unique<Bytecode::VM>();
+  if (engine == REGISTER_VM && registerVm == nullptr)
+    registerVm = std::make_unique<Register::VM>();
+}
+
+void Lox::setOptimization(int level) { optimization = level; }
+
+void Lox::setInlineLimits(Optimizer::InlineLimits limits) {
+  inlineLimits = limits;
+}
+
+void Lox::setDumpAst(bool dump) { dumpAst = dump; }
+
+void Lox::setMemoize(size_t capacity) { memoize = capacity; }
+
+void Lox::reportMemoStats(std::ostream &outs) {
+  interpreter.reportMemoStats(outs);
+}
+
 void Lox::runFile(const std::string &path) {
   std::string content = readFile(path);
   run(content, false);
@@ -23,7 +53,8 @@ void Lox::runPrompt() {
     line.clear();
 
     std::cout << "> ";
-    std::getline(std::cin, line);
+    if (!std::getline(std::cin, line))
+      break;
 
     run(line, true);
   }
@@ -36,18 +67,49 @@ void Lox::run(const std::string &source, bool is_repl) {
   std::vector<Token> tokens = tokenizer.getTokens();
 
   Parser parser{tokens, is_repl};
-  const std::vector<Stmt::Stmt *> statements = parser.parse();
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
   
   if (hadError)
     return;
 
   Resolver resolver(interpreter);
-  resolver.resolve(statements);
+  resolver.resolve(unit->statements());
 
   if (hadError)
     return;
 
-  interpreter.interpret(statements);
+  // The passes replace nodes, which have to be resolved again.
+  Optimizer::PassManager passes =
+      Optimizer::PassManager::forLevel(optimization, inlineLimits);
+  if (!passes.empty()) {
+    passes.run(*unit);
+    Resolver(interpreter).resolve(unit->statements());
+  }
+
+  // Only the tree walker looks up the caches.
+  if (memoize > 0 && engine == TREE_WALKER) {
+    Optimizer::PurityAnalysis purity;
+    purity.run(*unit);
+    for (const Stmt::Stmt *stmt : unit->statements()) {
+      auto function = dynamic_cast<const Stmt::FunctionStmt *>(stmt);
+      if (function != nullptr && purity.pure().contains(function))
+        interpreter.memoize(function, memoize, purity.dependencies(function));
+    }
+  }
+
+  if (dumpAst) {
+    std::cout << PrinterVisitor().print(unit->statements());
+    return;
+  }
+
+  if (engine == STACK_VM)
+    vm->interpret(unit->statements(), interpreter);
+  else if (engine == REGISTER_VM)
+    registerVm->interpret(unit->statements(), interpreter);
+  else if (engine == CLOSURES)
+    closures->interpret(unit->statements(), interpreter);
+  else
+    interpreter.interpret(unit->statements());
 }
 
 void Lox::error(size_t line, const std::string &message) {
@@ -64,10 +126,19 @@ void Lox::report(size_t line, const std::string &location,
 
 void Lox::runtime_error(RuntimeError err) {
   std::cout << "Runtime Error. Operator " << err._token << ": " << err.what()
-            << std::endl;
+            << std::endl
+            << "[line " << err._token.line() << "]" << std::endl;
 
   hadError = true;
 }
 
 bool Lox::hadError = false;
 Interpreter Lox::interpreter{};
+std::unique_ptr<Closure::Engine> Lox::closures;
+std::unique_ptr<Bytecode::VM> Lox::vm;
+std::unique_ptr<Register::VM> Lox::registerVm;
+Engine Lox::engine = TREE_WALKER;
+int Lox::optimization = 1;
+Optimizer::InlineLimits Lox::inlineLimits;
+bool Lox::dumpAst = false;
+size_t Lox::memoize = 0;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <compilation_unit.h>
+
+#include <memory>
+#include <vector>
+
+namespace Optimizer {
+
+// How much Inlining may inline: the number of nodes of an inlined body, and
+// how deep calls inside inlined bodies are inlined.
+struct InlineLimits {
+  size_t size = 16;
+  int depth = 3;
+};
+
+// A transformation of the syntax tree of a unit. Passes run after the unit
+// was resolved, and the unit is resolved again once they are done, so a
+// pass may replace any node with new ones allocated in the unit.
+class Pass {
+public:
+  virtual ~Pass() = default;
+  virtual void run(CompilationUnit &) = 0;
+};
+
+// Runs passes over a unit in the order they were added.
+class PassManager {
+public:
+  // The passes of an optimization level. Level 0 runs none.
+  static PassManager forLevel(int level, InlineLimits = InlineLimits());
+
+  void add(std::unique_ptr<Pass> pass) { _passes.push_back(std::move(pass)); }
+  bool empty() const { return _passes.empty(); }
+
+  void run(CompilationUnit &) const;
+
+private:
+  std::vector<std::unique_ptr<Pass>> _passes;
+};
+
+} // namespace Optimizer
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <rewriter.h>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <vector>
+
+namespace Optimizer {
+
+// Evaluates binary, unary and grouping expressions whose operands are
+// literals. Operations that would raise an error at runtime, like a
+// division by zero or adding a string to a number, are left alone so the
+// error is still reported when the script runs.
+class ConstantFolding : public Rewriter {
+public:
+  void visitBinary(const Expr::BinaryExpr *) override;
+  void visitUnary(const Expr::UnaryExpr *) override;
+  void visitGrouping(const Expr::GroupingExpr *) override;
+};
+
+// Removes the branches of if statements and ternaries that a literal
+// condition never takes, and loops whose literal condition is false.
+class DeadBranchElimination : public Rewriter {
+public:
+  void visitTernary(const Expr::TernaryExpr *) override;
+  void visitIfStmt(const Stmt::IfStmt *) override;
+  void visitWhileStmt(const Stmt::WhileStmt *) override;
+  void visitForStmt(const Stmt::ForStmt *) override;
+};
+
+// Replaces reads of local variables that are initialized with a literal and
+// never assigned with the literal.
+class ConstantPropagation : public LocalRewriter {
+public:
+  void run(CompilationUnit &) override;
+
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitVarStmt(const Stmt::VarStmt *) override;
+
+private:
+  // The literals the declarations of locals were initialized with.
+  std::unordered_map<const void *, const Expr::LiteralExpr *> _constants;
+};
+
+// Substitutes the bodies of small functions for calls to them. A function
+// is inlined if it is declared once at the top level of the unit, only
+// returns an expression that neither assigns nor refers to itself, and is
+// called with arguments that evaluating the body instead can not tell
+// apart: literals, this, and locals, which no closure may assign if the
+// body calls anything. Calls in inlined bodies are inlined in turn, up to
+// the depth of the limits. Every inlined call checks that the callee still
+// is the function, see Expr::InlineExpr.
+class Inlining : public LocalRewriter {
+public:
+  explicit Inlining(InlineLimits limits) : _limits(limits) {}
+
+  void run(CompilationUnit &) override;
+
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitCall(const Expr::CallExpr *) override;
+
+private:
+  struct Candidate {
+    const Stmt::FunctionStmt *function;
+    const Expr::Expr *body;
+    bool calls;
+    // The globals the body refers to, which must not be shadowed where it
+    // is inlined.
+    std::vector<std::string> globals;
+  };
+
+  void findCandidates(const CompilationUnit &);
+  bool canInline(const Candidate &, const Expr::CallExpr *) const;
+
+  InlineLimits _limits;
+  std::unordered_map<std::string, Candidate> _candidates;
+  // The functions being inlined, innermost last, and what their parameters
+  // are replaced with.
+  std::vector<const Candidate *> _inlining;
+  std::vector<std::unordered_map<std::string, const Expr::Expr *>> _arguments;
+};
+
+// Finds the functions declared at the top level of the unit that are pure:
+// they neither print, set properties, read them, nor assign globals, and
+// only call pure functions. Besides their own locals they only refer to
+// globals declared once in the unit and never assigned, so a call with the
+// same arguments always returns the same value. Rewrites nothing.
+//
+// That only holds for the unit itself: code run later can still write
+// those globals, see dependencies.
+class PurityAnalysis : public LocalRewriter {
+public:
+  // The globals a pure function reads or calls, by name, with the
+  // statement of the unit declaring each.
+  typedef std::unordered_map<std::string, const Stmt::Declaration *>
+      Dependencies;
+
+  void run(CompilationUnit &) override;
+
+  const std::unordered_set<const Stmt::FunctionStmt *> &pure() const {
+    return _pure;
+  }
+  const Dependencies &dependencies(const Stmt::FunctionStmt *function) const {
+    return _dependencies.at(function);
+  }
+
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitAssign(const Expr::AssignExpr *) override;
+  void visitCall(const Expr::CallExpr *) override;
+  void visitGet(const Expr::GetExpr *) override;
+  void visitSet(const Expr::SetExpr *) override;
+  void visitPrintStmt(const Stmt::PrintStmt *) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override;
+  void visitClassStmt(const Stmt::ClassStmt *) override;
+
+private:
+  struct Function {
+    bool impure = false;
+    std::unordered_set<std::string> globals;
+    std::unordered_set<std::string> callees;
+  };
+
+  // Marks the function being walked impure.
+  void impure();
+
+  std::unordered_map<const Stmt::FunctionStmt *, Function> _functions;
+  // The top level function being walked, if any.
+  Function *_current = nullptr;
+  std::unordered_set<std::string> _assignedGlobals;
+  std::unordered_set<const Stmt::FunctionStmt *> _pure;
+  std::unordered_map<const Stmt::FunctionStmt *, Dependencies> _dependencies;
+};
+
+} // namespace Optimizer
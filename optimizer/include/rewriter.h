@@ -0,0 +1,133 @@
+#pragma once
+
+#include <expression_visitor.h>
+#include <pass.h>
+#include <stmt_visitor.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Optimizer {
+
+// The name a fun, var or class statement declares, nullptr for others.
+const std::string *declaredName(const Stmt::Stmt *);
+
+// A pass that rebuilds the syntax tree bottom up. Each visit leaves the
+// node that replaces the one visited in _expr or _stmt; a node whose
+// children did not change is kept as it is, so only rewritten paths are
+// allocated again. A statement may also be replaced by nullptr, which
+// removes it. Passes override the visits of the nodes they transform,
+// usually calling the visit of the Rewriter first to rewrite the children.
+class Rewriter : public Pass,
+                 public Expr::ExprVisitor,
+                 public Stmt::StmtVisitor {
+public:
+  void run(CompilationUnit &) override;
+
+  void visitBinary(const Expr::BinaryExpr *) override;
+  void visitLiteral(const Expr::LiteralExpr *) override;
+  void visitUnary(const Expr::UnaryExpr *) override;
+  void visitGrouping(const Expr::GroupingExpr *) override;
+  void visitTernary(const Expr::TernaryExpr *) override;
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitAssign(const Expr::AssignExpr *) override;
+  void visitLogic(const Expr::LogicExpr *) override;
+  void visitCall(const Expr::CallExpr *) override;
+  void visitGet(const Expr::GetExpr *) override;
+  void visitSet(const Expr::SetExpr *) override;
+  void visitThis(const Expr::ThisExpr *) override;
+  void visitSuper(const Expr::SuperExpr *) override;
+  void visitInline(const Expr::InlineExpr *) override;
+
+  void visitExprStmt(const Stmt::ExprStmt *) override;
+  void visitPrintStmt(const Stmt::PrintStmt *) override;
+  void visitVarStmt(const Stmt::VarStmt *) override;
+  void visitBlock(const Stmt::Block *) override;
+  void visitIfStmt(const Stmt::IfStmt *) override;
+  void visitWhileStmt(const Stmt::WhileStmt *) override;
+  void visitForStmt(const Stmt::ForStmt *) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override;
+  void visitReturnStmt(const Stmt::ReturnStmt *) override;
+  void visitClassStmt(const Stmt::ClassStmt *) override;
+
+protected:
+  // Both accept nullptr, for the optional parts of a node.
+  const Expr::Expr *rewrite(const Expr::Expr *);
+  const Stmt::Stmt *rewrite(const Stmt::Stmt *);
+  // The body of a function or method.
+  virtual const Stmt::FunctionStmt *rewriteFunction(const Stmt::FunctionStmt *);
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    return _unit->make<T>(std::forward<Args>(args)...);
+  }
+
+  const Expr::Expr *_expr = nullptr;
+  const Stmt::Stmt *_stmt = nullptr;
+
+private:
+  // Rewrites a list of statements, leaving out the removed ones. Returns
+  // whether anything changed.
+  bool rewrite(const std::vector<const Stmt::Stmt *> &,
+               std::vector<const Stmt::Stmt *> &rewritten);
+  // A statement that must be kept, such as the body of a loop, is replaced
+  // by an empty block if it was removed.
+  const Stmt::Stmt *rewriteBody(const Stmt::Stmt *);
+
+  CompilationUnit *_unit = nullptr;
+};
+
+// A Rewriter that knows which local variables are in scope, and which of
+// them are ever assigned, by their own function or by functions nested in
+// it: the unit is walked once to find the assignments before it is
+// rewritten. Nothing may be rewritten during that first walk.
+// Globals are not tracked, any later code may assign them.
+class LocalRewriter : public Rewriter {
+public:
+  void run(CompilationUnit &) override;
+
+  void visitAssign(const Expr::AssignExpr *) override;
+  void visitVarStmt(const Stmt::VarStmt *) override;
+  void visitBlock(const Stmt::Block *) override;
+  void visitForStmt(const Stmt::ForStmt *) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override;
+  void visitClassStmt(const Stmt::ClassStmt *) override;
+
+protected:
+  const Stmt::FunctionStmt *rewriteFunction(const Stmt::FunctionStmt *) override;
+
+  bool collecting() const { return _collecting; }
+  // The declaration of the local a name refers to, or nullptr for a global.
+  // That is the VarStmt, FunctionStmt or ClassStmt, or the Token of a
+  // parameter.
+  const void *lookup(const std::string &name) const;
+  bool assigned(const void *declaration) const {
+    return _assigned.contains(declaration);
+  }
+  // Whether a local is assigned by a function nested in the one declaring
+  // it, which may run during any call.
+  bool assignedByClosure(const void *declaration) const {
+    return _assignedByClosures.contains(declaration);
+  }
+
+private:
+  struct Local {
+    const void *declaration;
+    // The nesting depth of the declaring function.
+    int function;
+  };
+  typedef std::unordered_map<std::string, Local> Scope;
+
+  void declare(const Token &name, const void *declaration);
+  const Local *find(const std::string &name) const;
+
+  bool _collecting = false;
+  std::vector<Scope> _scopes;
+  int _function = 0;
+  std::unordered_set<const void *> _assigned;
+  std::unordered_set<const void *> _assignedByClosures;
+};
+
+} // namespace Optimizer
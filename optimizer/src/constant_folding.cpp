@@ -0,0 +1,104 @@
+#include <passes.h>
+
+#include <interpreter.h>
+
+namespace Optimizer {
+
+namespace {
+
+const Expr::LiteralExpr *literal(const Expr::Expr *expr) {
+  return dynamic_cast<const Expr::LiteralExpr *>(expr);
+}
+
+// Sets result to the value of an operation on two numbers. Returns false
+// for the operations that raise an error.
+bool foldNumbers(TOKEN_TYPE op, double left, double right, LoxType &result) {
+  switch (op) {
+  case GREATER:
+    result = left > right;
+    return true;
+  case GREATER_EQUAL:
+    result = left >= right;
+    return true;
+  case LESS:
+    result = left < right;
+    return true;
+  case LESS_EQUAL:
+    result = left <= right;
+    return true;
+  case MINUS:
+    result = left - right;
+    return true;
+  case PLUS:
+    result = left + right;
+    return true;
+  case SLASH:
+    if (right == 0)
+      return false;
+    result = left / right;
+    return true;
+  case STAR:
+    result = left * right;
+    return true;
+  case BANG_EQUAL:
+    result = left != right;
+    return true;
+  case EQUAL_EQUAL:
+    result = left == right;
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+void ConstantFolding::visitBinary(const Expr::BinaryExpr *expr) {
+  Rewriter::visitBinary(expr);
+  const Expr::BinaryExpr *binary = static_cast<const Expr::BinaryExpr *>(_expr);
+  const Expr::LiteralExpr *left = literal(binary->left());
+  const Expr::LiteralExpr *right = literal(binary->right());
+  if (left == nullptr || right == nullptr)
+    return;
+
+  LoxType a = left->value(), b = right->value();
+  TOKEN_TYPE op = binary->op().type();
+  LoxType result;
+  if (a.isType<double>() && b.isType<double>()) {
+    if (!foldNumbers(op, a.getValue<double>(), b.getValue<double>(), result))
+      return;
+  } else if (op == EQUAL_EQUAL) {
+    result = a == b;
+  } else if (op == BANG_EQUAL) {
+    result = !(a == b);
+  } else if (op == PLUS && a.isType<std::string>() && b.isType<std::string>()) {
+    result = a.getValue<std::string>() + b.getValue<std::string>();
+  } else {
+    return;
+  }
+  _expr = make<Expr::LiteralExpr>(result);
+}
+
+void ConstantFolding::visitUnary(const Expr::UnaryExpr *expr) {
+  Rewriter::visitUnary(expr);
+  const Expr::UnaryExpr *unary = static_cast<const Expr::UnaryExpr *>(_expr);
+  const Expr::LiteralExpr *right = literal(unary->right());
+  if (right == nullptr)
+    return;
+
+  LoxType value = right->value();
+  if (unary->op().type() == MINUS && value.isType<double>())
+    _expr = make<Expr::LiteralExpr>(-value.getValue<double>());
+  else if (unary->op().type() == BANG)
+    _expr = make<Expr::LiteralExpr>(!Interpreter::isTruthyVal(value));
+}
+
+void ConstantFolding::visitGrouping(const Expr::GroupingExpr *expr) {
+  Rewriter::visitGrouping(expr);
+  const Expr::GroupingExpr *grouping =
+      static_cast<const Expr::GroupingExpr *>(_expr);
+  if (literal(grouping->expr()) != nullptr)
+    _expr = grouping->expr();
+}
+
+} // namespace Optimizer
@@ -0,0 +1,31 @@
+#include <passes.h>
+
+namespace Optimizer {
+
+void ConstantPropagation::run(CompilationUnit &unit) {
+  _constants.clear();
+  LocalRewriter::run(unit);
+}
+
+void ConstantPropagation::visitVariable(const Expr::VariableExpr *expr) {
+  _expr = expr;
+  if (collecting())
+    return;
+
+  const void *declaration = lookup(expr->name().lexeme());
+  if (declaration == nullptr || assigned(declaration))
+    return;
+
+  auto constant = _constants.find(declaration);
+  if (constant != _constants.end())
+    _expr = make<Expr::LiteralExpr>(constant->second->value());
+}
+
+void ConstantPropagation::visitVarStmt(const Stmt::VarStmt *stmt) {
+  LocalRewriter::visitVarStmt(stmt);
+  auto rewritten = static_cast<const Stmt::VarStmt *>(_stmt);
+  if (auto literal = dynamic_cast<const Expr::LiteralExpr *>(rewritten->init()))
+    _constants[stmt] = literal;
+}
+
+} // namespace Optimizer
@@ -0,0 +1,56 @@
+#include <passes.h>
+
+#include <interpreter.h>
+
+#include <optional>
+
+namespace Optimizer {
+
+namespace {
+
+// Whether a condition is a literal, and if so, whether it holds.
+std::optional<bool> constantCondition(const Expr::Expr *condition) {
+  auto literal = dynamic_cast<const Expr::LiteralExpr *>(condition);
+  if (literal == nullptr)
+    return std::nullopt;
+  return Interpreter::isTruthyVal(literal->value());
+}
+
+} // namespace
+
+void DeadBranchElimination::visitTernary(const Expr::TernaryExpr *expr) {
+  Rewriter::visitTernary(expr);
+  auto ternary = static_cast<const Expr::TernaryExpr *>(_expr);
+  if (std::optional<bool> taken = constantCondition(ternary->condition()))
+    _expr = *taken ? ternary->first() : ternary->second();
+}
+
+void DeadBranchElimination::visitIfStmt(const Stmt::IfStmt *stmt) {
+  Rewriter::visitIfStmt(stmt);
+  auto ifStmt = static_cast<const Stmt::IfStmt *>(_stmt);
+  // An if without an else whose condition is false is removed.
+  if (std::optional<bool> taken = constantCondition(ifStmt->condition()))
+    _stmt = *taken ? ifStmt->thenBranch() : ifStmt->elseBranch();
+}
+
+void DeadBranchElimination::visitWhileStmt(const Stmt::WhileStmt *stmt) {
+  Rewriter::visitWhileStmt(stmt);
+  auto whileStmt = static_cast<const Stmt::WhileStmt *>(_stmt);
+  if (constantCondition(whileStmt->condition()) == false)
+    _stmt = nullptr;
+}
+
+void DeadBranchElimination::visitForStmt(const Stmt::ForStmt *stmt) {
+  Rewriter::visitForStmt(stmt);
+  auto forStmt = static_cast<const Stmt::ForStmt *>(_stmt);
+  if (constantCondition(forStmt->condition()) != false)
+    return;
+
+  // The initializer still runs once, in the scope of the loop.
+  if (forStmt->init() == nullptr)
+    _stmt = nullptr;
+  else
+    _stmt = make<Stmt::Block>(std::vector<const Stmt::Stmt *>{forStmt->init()});
+}
+
+} // namespace Optimizer
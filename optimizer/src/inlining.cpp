@@ -0,0 +1,177 @@
+#include <passes.h>
+
+#include <algorithm>
+
+namespace Optimizer {
+
+namespace {
+
+// Works out whether the returned expression of a function can be inlined,
+// and how large it is.
+class BodyCheck : public Expr::ExprVisitor {
+public:
+  explicit BodyCheck(const Stmt::FunctionStmt *function) : _function(function) {}
+
+  bool inlinable = true;
+  size_t size = 0;
+  bool calls = false;
+  std::vector<std::string> globals;
+
+  void visitBinary(const Expr::BinaryExpr *expr) override {
+    visit({expr->left(), expr->right()});
+  }
+  void visitLiteral(const Expr::LiteralExpr *) override { size++; }
+  void visitUnary(const Expr::UnaryExpr *expr) override {
+    visit({expr->right()});
+  }
+  void visitGrouping(const Expr::GroupingExpr *expr) override {
+    visit({expr->expr()});
+  }
+  void visitTernary(const Expr::TernaryExpr *expr) override {
+    visit({expr->condition(), expr->first(), expr->second()});
+  }
+  void visitVariable(const Expr::VariableExpr *expr) override {
+    size++;
+    const std::string &name = expr->name().lexeme();
+    if (name == _function->name().lexeme())
+      inlinable = false;
+
+    const std::vector<Token> &params = _function->params();
+    bool param = std::any_of(params.begin(), params.end(), [&](const Token &p) {
+      return p.lexeme() == name;
+    });
+    if (!param && std::find(globals.begin(), globals.end(), name) == globals.end())
+      globals.push_back(name);
+  }
+  void visitLogic(const Expr::LogicExpr *expr) override {
+    visit({expr->first(), expr->second()});
+  }
+  void visitCall(const Expr::CallExpr *expr) override {
+    calls = true;
+    visit({expr->callee()});
+    for (const Expr::Expr *argument : expr->arguments())
+      argument->accept(this);
+  }
+  void visitGet(const Expr::GetExpr *expr) override { visit({expr->object()}); }
+
+  // Assignments to parameters would assign the arguments.
+  void visitAssign(const Expr::AssignExpr *) override { inlinable = false; }
+  void visitSet(const Expr::SetExpr *) override { inlinable = false; }
+  void visitThis(const Expr::ThisExpr *) override { inlinable = false; }
+  void visitSuper(const Expr::SuperExpr *) override { inlinable = false; }
+  void visitInline(const Expr::InlineExpr *) override { inlinable = false; }
+
+private:
+  void visit(std::initializer_list<const Expr::Expr *> children) {
+    size++;
+    for (const Expr::Expr *child : children)
+      child->accept(this);
+  }
+
+  const Stmt::FunctionStmt *_function;
+};
+
+} // namespace
+
+void Inlining::run(CompilationUnit &unit) {
+  findCandidates(unit);
+  if (!_candidates.empty())
+    LocalRewriter::run(unit);
+}
+
+void Inlining::visitVariable(const Expr::VariableExpr *expr) {
+  _expr = expr;
+  if (_arguments.empty())
+    return;
+
+  auto argument = _arguments.back().find(expr->name().lexeme());
+  if (argument != _arguments.back().end())
+    _expr = argument->second;
+}
+
+void Inlining::visitCall(const Expr::CallExpr *expr) {
+  Rewriter::visitCall(expr);
+  if (collecting())
+    return;
+
+  auto call = static_cast<const Expr::CallExpr *>(_expr);
+  auto callee = dynamic_cast<const Expr::VariableExpr *>(call->callee());
+  if (callee == nullptr)
+    return;
+  auto found = _candidates.find(callee->name().lexeme());
+  if (found == _candidates.end() || !canInline(found->second, call))
+    return;
+
+  const Candidate &candidate = found->second;
+  std::unordered_map<std::string, const Expr::Expr *> arguments;
+  for (size_t i = 0; i < call->arguments().size(); i++)
+    arguments[candidate.function->params()[i].lexeme()] = call->arguments()[i];
+
+  _inlining.push_back(&candidate);
+  _arguments.push_back(std::move(arguments));
+  const Expr::Expr *body = rewrite(candidate.body);
+  _arguments.pop_back();
+  _inlining.pop_back();
+
+  _expr = make<Expr::InlineExpr>(call, candidate.function, body);
+}
+
+void Inlining::findCandidates(const CompilationUnit &unit) {
+  _candidates.clear();
+
+  // A name declared twice refers to either declaration.
+  std::unordered_map<std::string, int> declarations;
+  for (const Stmt::Stmt *stmt : unit.statements()) {
+    if (const std::string *name = declaredName(stmt))
+      declarations[*name]++;
+  }
+
+  for (const Stmt::Stmt *stmt : unit.statements()) {
+    auto function = dynamic_cast<const Stmt::FunctionStmt *>(stmt);
+    if (function == nullptr || declarations[function->name().lexeme()] != 1 ||
+        function->body().size() != 1)
+      continue;
+    auto ret = dynamic_cast<const Stmt::ReturnStmt *>(function->body().front());
+    if (ret == nullptr || ret->expr() == nullptr)
+      continue;
+
+    BodyCheck check(function);
+    ret->expr()->accept(&check);
+    if (check.inlinable && check.size <= _limits.size)
+      _candidates[function->name().lexeme()] = {function, ret->expr(), check.calls,
+                                                std::move(check.globals)};
+  }
+}
+
+bool Inlining::canInline(const Candidate &candidate,
+                         const Expr::CallExpr *call) const {
+  if (call->arguments().size() != candidate.function->params().size() ||
+      _inlining.size() >= size_t(_limits.depth) ||
+      std::find(_inlining.begin(), _inlining.end(), &candidate) != _inlining.end())
+    return false;
+
+  // The callee and the globals of the body have to be the globals here.
+  if (lookup(candidate.function->name().lexeme()) != nullptr)
+    return false;
+  for (const std::string &global : candidate.globals) {
+    if (lookup(global) != nullptr)
+      return false;
+  }
+
+  // Reading an argument where the body uses it must give the value it had
+  // when the call was made, and have no effects of its own.
+  for (const Expr::Expr *argument : call->arguments()) {
+    if (dynamic_cast<const Expr::LiteralExpr *>(argument) != nullptr ||
+        dynamic_cast<const Expr::ThisExpr *>(argument) != nullptr)
+      continue;
+    auto variable = dynamic_cast<const Expr::VariableExpr *>(argument);
+    if (variable == nullptr)
+      return false;
+    const void *local = lookup(variable->name().lexeme());
+    if (local == nullptr || (candidate.calls && assignedByClosure(local)))
+      return false;
+  }
+  return true;
+}
+
+} // namespace Optimizer
@@ -0,0 +1,86 @@
+#include <rewriter.h>
+
+namespace Optimizer {
+
+void LocalRewriter::run(CompilationUnit &unit) {
+  _assigned.clear();
+  _assignedByClosures.clear();
+
+  _collecting = true;
+  Rewriter::run(unit);
+  _collecting = false;
+  Rewriter::run(unit);
+}
+
+void LocalRewriter::visitAssign(const Expr::AssignExpr *expr) {
+  Rewriter::visitAssign(expr);
+  if (!_collecting)
+    return;
+
+  if (const Local *local = find(expr->name().lexeme())) {
+    _assigned.insert(local->declaration);
+    if (local->function != _function)
+      _assignedByClosures.insert(local->declaration);
+  }
+}
+
+void LocalRewriter::visitVarStmt(const Stmt::VarStmt *stmt) {
+  // The initializer can not refer to the variable it initializes.
+  Rewriter::visitVarStmt(stmt);
+  declare(stmt->name(), stmt);
+}
+
+void LocalRewriter::visitBlock(const Stmt::Block *stmt) {
+  _scopes.emplace_back();
+  Rewriter::visitBlock(stmt);
+  _scopes.pop_back();
+}
+
+void LocalRewriter::visitForStmt(const Stmt::ForStmt *stmt) {
+  _scopes.emplace_back();
+  Rewriter::visitForStmt(stmt);
+  _scopes.pop_back();
+}
+
+void LocalRewriter::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  declare(stmt->name(), stmt);
+  Rewriter::visitFunctionStmt(stmt);
+}
+
+void LocalRewriter::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  declare(stmt->name(), stmt);
+  Rewriter::visitClassStmt(stmt);
+}
+
+const Stmt::FunctionStmt *
+LocalRewriter::rewriteFunction(const Stmt::FunctionStmt *stmt) {
+  _function++;
+  _scopes.emplace_back();
+  for (const Token &param : stmt->params())
+    declare(param, &param);
+  const Stmt::FunctionStmt *rewritten = Rewriter::rewriteFunction(stmt);
+  _scopes.pop_back();
+  _function--;
+  return rewritten;
+}
+
+void LocalRewriter::declare(const Token &name, const void *declaration) {
+  if (!_scopes.empty())
+    _scopes.back()[name.lexeme()] = {declaration, _function};
+}
+
+const void *LocalRewriter::lookup(const std::string &name) const {
+  const Local *local = find(name);
+  return local != nullptr ? local->declaration : nullptr;
+}
+
+const LocalRewriter::Local *LocalRewriter::find(const std::string &name) const {
+  for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); scope++) {
+    auto found = scope->find(name);
+    if (found != scope->end())
+      return &found->second;
+  }
+  return nullptr;
+}
+
+} // namespace Optimizer
@@ -0,0 +1,25 @@
+#include <pass.h>
+#include <passes.h>
+
+namespace Optimizer {
+
+PassManager PassManager::forLevel(int level, InlineLimits limits) {
+  PassManager manager;
+  if (level >= 1) {
+    manager.add(std::make_unique<Inlining>(limits));
+    manager.add(std::make_unique<ConstantFolding>());
+    // Propagated constants are folded again before branches on them are
+    // removed.
+    manager.add(std::make_unique<ConstantPropagation>());
+    manager.add(std::make_unique<ConstantFolding>());
+    manager.add(std::make_unique<DeadBranchElimination>());
+  }
+  return manager;
+}
+
+void PassManager::run(CompilationUnit &unit) const {
+  for (const std::unique_ptr<Pass> &pass : _passes)
+    pass->run(unit);
+}
+
+} // namespace Optimizer
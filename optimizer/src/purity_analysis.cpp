@@ -0,0 +1,137 @@
+#include <passes.h>
+
+namespace Optimizer {
+
+void PurityAnalysis::run(CompilationUnit &unit) {
+  _functions.clear();
+  _assignedGlobals.clear();
+  _pure.clear();
+  _dependencies.clear();
+
+  for (const Stmt::Stmt *stmt : unit.statements()) {
+    if (auto function = dynamic_cast<const Stmt::FunctionStmt *>(stmt))
+      _functions[function];
+  }
+  LocalRewriter::run(unit);
+
+  // A name declared twice refers to either declaration.
+  std::unordered_map<std::string, int> declarations;
+  std::unordered_map<std::string, const Stmt::Declaration *> declared;
+  for (const Stmt::Stmt *stmt : unit.statements()) {
+    if (const std::string *name = declaredName(stmt)) {
+      declarations[*name]++;
+      declared[*name] = static_cast<const Stmt::Declaration *>(stmt);
+    }
+  }
+  auto stable = [&](const std::string &name) {
+    return declarations[name] == 1 && !_assignedGlobals.contains(name);
+  };
+
+  std::unordered_map<std::string, const Stmt::FunctionStmt *> byName;
+  for (const auto &[function, facts] : _functions) {
+    const std::string &name = function->name().lexeme();
+    if (facts.impure || !stable(name))
+      continue;
+    bool globals = true;
+    for (const std::string &global : facts.globals)
+      globals = globals && stable(global);
+    if (globals)
+      byName[name] = function;
+  }
+
+  // Functions calling impure ones are impure, which may make their callers
+  // impure in turn.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = byName.begin(); it != byName.end();) {
+      bool callees = true;
+      for (const std::string &callee : _functions[it->second].callees)
+        callees = callees && byName.contains(callee);
+      if (callees) {
+        ++it;
+      } else {
+        it = byName.erase(it);
+        changed = true;
+      }
+    }
+  }
+
+  for (const auto &[name, function] : byName) {
+    _pure.insert(function);
+    Dependencies &dependencies = _dependencies[function];
+    for (const std::string &global : _functions[function].globals)
+      dependencies[global] = declared[global];
+    for (const std::string &callee : _functions[function].callees)
+      dependencies[callee] = declared[callee];
+  }
+}
+
+void PurityAnalysis::visitVariable(const Expr::VariableExpr *expr) {
+  LocalRewriter::visitVariable(expr);
+  if (_current != nullptr && lookup(expr->name().lexeme()) == nullptr)
+    _current->globals.insert(expr->name().lexeme());
+}
+
+void PurityAnalysis::visitAssign(const Expr::AssignExpr *expr) {
+  LocalRewriter::visitAssign(expr);
+  // The locals of a top level function are its own, since any nested
+  // function already made it impure.
+  if (lookup(expr->name().lexeme()) == nullptr) {
+    _assignedGlobals.insert(expr->name().lexeme());
+    impure();
+  }
+}
+
+void PurityAnalysis::visitCall(const Expr::CallExpr *expr) {
+  LocalRewriter::visitCall(expr);
+  if (_current == nullptr)
+    return;
+
+  // Only a global can be known to hold a pure function.
+  auto callee = dynamic_cast<const Expr::VariableExpr *>(expr->callee());
+  if (callee != nullptr && lookup(callee->name().lexeme()) == nullptr)
+    _current->callees.insert(callee->name().lexeme());
+  else
+    impure();
+}
+
+void PurityAnalysis::visitGet(const Expr::GetExpr *expr) {
+  LocalRewriter::visitGet(expr);
+  impure();
+}
+
+void PurityAnalysis::visitSet(const Expr::SetExpr *expr) {
+  LocalRewriter::visitSet(expr);
+  impure();
+}
+
+void PurityAnalysis::visitPrintStmt(const Stmt::PrintStmt *stmt) {
+  LocalRewriter::visitPrintStmt(stmt);
+  impure();
+}
+
+void PurityAnalysis::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  if (_current != nullptr) {
+    impure();
+    LocalRewriter::visitFunctionStmt(stmt);
+    return;
+  }
+
+  auto function = _functions.find(stmt);
+  _current = function != _functions.end() ? &function->second : nullptr;
+  LocalRewriter::visitFunctionStmt(stmt);
+  _current = nullptr;
+}
+
+void PurityAnalysis::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  impure();
+  LocalRewriter::visitClassStmt(stmt);
+}
+
+void PurityAnalysis::impure() {
+  if (_current != nullptr)
+    _current->impure = true;
+}
+
+} // namespace Optimizer
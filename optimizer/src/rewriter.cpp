@@ -0,0 +1,256 @@
+#include <rewriter.h>
+
+namespace Optimizer {
+
+const std::string *declaredName(const Stmt::Stmt *stmt) {
+  if (auto function = dynamic_cast<const Stmt::FunctionStmt *>(stmt))
+    return &function->name().lexeme();
+  if (auto var = dynamic_cast<const Stmt::VarStmt *>(stmt))
+    return &var->name().lexeme();
+  if (auto klass = dynamic_cast<const Stmt::ClassStmt *>(stmt))
+    return &klass->name().lexeme();
+  return nullptr;
+}
+
+void Rewriter::run(CompilationUnit &unit) {
+  _unit = &unit;
+
+  std::vector<const Stmt::Stmt *> statements(unit.statements().begin(),
+                                             unit.statements().end());
+  std::vector<const Stmt::Stmt *> rewritten;
+  if (!rewrite(statements, rewritten))
+    return;
+
+  // The engines take the statements of a unit as mutable, but no node is
+  // changed once it was built.
+  unit.statements().clear();
+  for (const Stmt::Stmt *statement : rewritten)
+    unit.statements().push_back(const_cast<Stmt::Stmt *>(statement));
+}
+
+void Rewriter::visitBinary(const Expr::BinaryExpr *expr) {
+  const Expr::Expr *left = rewrite(expr->left());
+  const Expr::Expr *right = rewrite(expr->right());
+  if (left == expr->left() && right == expr->right())
+    _expr = expr;
+  else
+    _expr = make<Expr::BinaryExpr>(left, expr->op(), right);
+}
+
+void Rewriter::visitLiteral(const Expr::LiteralExpr *expr) { _expr = expr; }
+
+void Rewriter::visitUnary(const Expr::UnaryExpr *expr) {
+  const Expr::Expr *right = rewrite(expr->right());
+  _expr = right == expr->right() ? expr : make<Expr::UnaryExpr>(expr->op(), right);
+}
+
+void Rewriter::visitGrouping(const Expr::GroupingExpr *expr) {
+  const Expr::Expr *inner = rewrite(expr->expr());
+  _expr = inner == expr->expr() ? expr : make<Expr::GroupingExpr>(inner);
+}
+
+void Rewriter::visitTernary(const Expr::TernaryExpr *expr) {
+  const Expr::Expr *condition = rewrite(expr->condition());
+  const Expr::Expr *first = rewrite(expr->first());
+  const Expr::Expr *second = rewrite(expr->second());
+  if (condition == expr->condition() && first == expr->first() &&
+      second == expr->second())
+    _expr = expr;
+  else
+    _expr = make<Expr::TernaryExpr>(condition, first, second);
+}
+
+void Rewriter::visitVariable(const Expr::VariableExpr *expr) { _expr = expr; }
+
+void Rewriter::visitAssign(const Expr::AssignExpr *expr) {
+  const Expr::Expr *value = rewrite(expr->value());
+  _expr = value == expr->value() ? expr
+                                 : make<Expr::AssignExpr>(expr->name(), value);
+}
+
+void Rewriter::visitLogic(const Expr::LogicExpr *expr) {
+  const Expr::Expr *first = rewrite(expr->first());
+  const Expr::Expr *second = rewrite(expr->second());
+  if (first == expr->first() && second == expr->second())
+    _expr = expr;
+  else
+    _expr = make<Expr::LogicExpr>(expr->op(), first, second);
+}
+
+void Rewriter::visitCall(const Expr::CallExpr *expr) {
+  const Expr::Expr *callee = rewrite(expr->callee());
+  bool changed = callee != expr->callee();
+
+  std::vector<Expr::Expr *> arguments;
+  arguments.reserve(expr->arguments().size());
+  for (const Expr::Expr *argument : expr->arguments()) {
+    const Expr::Expr *rewritten = rewrite(argument);
+    changed |= rewritten != argument;
+    arguments.push_back(const_cast<Expr::Expr *>(rewritten));
+  }
+
+  if (changed)
+    _expr = make<Expr::CallExpr>(callee, expr->paren(), arguments);
+  else
+    _expr = expr;
+}
+
+void Rewriter::visitGet(const Expr::GetExpr *expr) {
+  const Expr::Expr *object = rewrite(expr->object());
+  _expr = object == expr->object() ? expr
+                                   : make<Expr::GetExpr>(object, expr->name());
+}
+
+void Rewriter::visitSet(const Expr::SetExpr *expr) {
+  const Expr::Expr *object = rewrite(expr->object());
+  const Expr::Expr *value = rewrite(expr->value());
+  if (object == expr->object() && value == expr->value())
+    _expr = expr;
+  else
+    _expr = make<Expr::SetExpr>(object, expr->name(), value);
+}
+
+void Rewriter::visitThis(const Expr::ThisExpr *expr) { _expr = expr; }
+
+void Rewriter::visitSuper(const Expr::SuperExpr *expr) { _expr = expr; }
+
+void Rewriter::visitInline(const Expr::InlineExpr *expr) {
+  const Expr::Expr *call = rewrite(expr->call());
+  const Expr::Expr *body = rewrite(expr->body());
+  if (call == expr->call() && body == expr->body())
+    _expr = expr;
+  else if (auto rewritten = dynamic_cast<const Expr::CallExpr *>(call))
+    _expr = make<Expr::InlineExpr>(rewritten, expr->function(), body);
+  else
+    _expr = call;
+}
+
+void Rewriter::visitExprStmt(const Stmt::ExprStmt *stmt) {
+  const Expr::Expr *expr = rewrite(stmt->expr());
+  _stmt = expr == stmt->expr() ? stmt : make<Stmt::ExprStmt>(expr);
+}
+
+void Rewriter::visitPrintStmt(const Stmt::PrintStmt *stmt) {
+  const Expr::Expr *expr = rewrite(stmt->expr());
+  _stmt = expr == stmt->expr() ? stmt : make<Stmt::PrintStmt>(expr);
+}
+
+void Rewriter::visitVarStmt(const Stmt::VarStmt *stmt) {
+  const Expr::Expr *init = rewrite(stmt->init());
+  _stmt = init == stmt->init() ? stmt : make<Stmt::VarStmt>(stmt->name(), init);
+}
+
+void Rewriter::visitBlock(const Stmt::Block *stmt) {
+  std::vector<const Stmt::Stmt *> statements;
+  if (rewrite(stmt->statements(), statements))
+    _stmt = make<Stmt::Block>(std::move(statements));
+  else
+    _stmt = stmt;
+}
+
+void Rewriter::visitIfStmt(const Stmt::IfStmt *stmt) {
+  const Expr::Expr *condition = rewrite(stmt->condition());
+  const Stmt::Stmt *thenBranch = rewriteBody(stmt->thenBranch());
+  const Stmt::Stmt *elseBranch = rewrite(stmt->elseBranch());
+  if (condition == stmt->condition() && thenBranch == stmt->thenBranch() &&
+      elseBranch == stmt->elseBranch())
+    _stmt = stmt;
+  else if (elseBranch == nullptr)
+    _stmt = make<Stmt::IfStmt>(condition, thenBranch);
+  else
+    _stmt = make<Stmt::IfStmt>(condition, thenBranch, elseBranch);
+}
+
+void Rewriter::visitWhileStmt(const Stmt::WhileStmt *stmt) {
+  const Expr::Expr *condition = rewrite(stmt->condition());
+  const Stmt::Stmt *body = rewriteBody(stmt->body());
+  if (condition == stmt->condition() && body == stmt->body())
+    _stmt = stmt;
+  else
+    _stmt = make<Stmt::WhileStmt>(condition, body);
+}
+
+void Rewriter::visitForStmt(const Stmt::ForStmt *stmt) {
+  const Stmt::Stmt *init = rewrite(stmt->init());
+  const Expr::Expr *condition = rewrite(stmt->condition());
+  const Expr::Expr *after = rewrite(stmt->after());
+  const Stmt::Stmt *body = rewriteBody(stmt->body());
+  if (init == stmt->init() && condition == stmt->condition() &&
+      after == stmt->after() && body == stmt->body())
+    _stmt = stmt;
+  else
+    _stmt = make<Stmt::ForStmt>(init, condition, after, body);
+}
+
+void Rewriter::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  _stmt = rewriteFunction(stmt);
+}
+
+void Rewriter::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
+  const Expr::Expr *expr = rewrite(stmt->expr());
+  _stmt = expr == stmt->expr() ? stmt : make<Stmt::ReturnStmt>(stmt->ret(), expr);
+}
+
+void Rewriter::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  bool changed = false;
+  std::vector<const Stmt::FunctionStmt *> methods;
+  methods.reserve(stmt->methods().size());
+  for (const Stmt::FunctionStmt *method : stmt->methods()) {
+    methods.push_back(rewriteFunction(method));
+    changed |= methods.back() != method;
+  }
+
+  if (!changed)
+    _stmt = stmt;
+  else if (stmt->superDeclaration() != nullptr)
+    _stmt = make<Stmt::ClassStmt>(stmt->name(), stmt->superDeclaration(),
+                                  std::move(methods));
+  else
+    _stmt = make<Stmt::ClassStmt>(stmt->name(), std::move(methods));
+}
+
+const Expr::Expr *Rewriter::rewrite(const Expr::Expr *expr) {
+  if (expr == nullptr)
+    return nullptr;
+  expr->accept(this);
+  return _expr;
+}
+
+const Stmt::Stmt *Rewriter::rewrite(const Stmt::Stmt *stmt) {
+  if (stmt == nullptr)
+    return nullptr;
+  stmt->accept(this);
+  return _stmt;
+}
+
+const Stmt::FunctionStmt *
+Rewriter::rewriteFunction(const Stmt::FunctionStmt *stmt) {
+  std::vector<const Stmt::Stmt *> body;
+  if (!rewrite(stmt->body(), body))
+    return stmt;
+
+  std::vector<Token> params = stmt->params();
+  return make<Stmt::FunctionStmt>(stmt->name(), params, body, _unit);
+}
+
+bool Rewriter::rewrite(const std::vector<const Stmt::Stmt *> &statements,
+                       std::vector<const Stmt::Stmt *> &rewritten) {
+  bool changed = false;
+  rewritten.reserve(statements.size());
+  for (const Stmt::Stmt *statement : statements) {
+    const Stmt::Stmt *result = rewrite(statement);
+    changed |= result != statement;
+    if (result != nullptr)
+      rewritten.push_back(result);
+  }
+  return changed;
+}
+
+const Stmt::Stmt *Rewriter::rewriteBody(const Stmt::Stmt *stmt) {
+  const Stmt::Stmt *result = rewrite(stmt);
+  if (result == nullptr)
+    return make<Stmt::Block>(std::vector<const Stmt::Stmt *>());
+  return result;
+}
+
+} // namespace Optimizer
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <parser.h>
+#include <pass.h>
+#include <passes.h>
+#include <printer_visitor.h>
+#include <tokenizer.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Optimizer;
+
+namespace {
+
+// Parses source, runs the passes of a level and prints the result.
+std::string optimize(const std::string &source, int level = 1) {
+  Tokenizer tokenizer{source};
+  Parser parser{tokenizer.getTokens()};
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
+  PassManager::forLevel(level).run(*unit);
+  return PrinterVisitor().print(unit->statements());
+}
+
+// Parses source and names its pure functions, in alphabetical order.
+std::vector<std::string> pure(const std::string &source) {
+  Tokenizer tokenizer{source};
+  Parser parser{tokenizer.getTokens()};
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
+  PurityAnalysis purity;
+  purity.run(*unit);
+
+  std::vector<std::string> names;
+  for (const Stmt::FunctionStmt *function : purity.pure())
+    names.push_back(function->name().lexeme());
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+} // namespace
+
+TEST(ConstantFoldingTest, FoldsLiteralOperands) {
+  EXPECT_EQ(optimize("print (1 + 2) * 3;"), "(print 9.000000)\n");
+  EXPECT_EQ(optimize("print -(4 - 6) < 3;"), "(print true)\n");
+  EXPECT_EQ(optimize("print \"lo\" + \"x\" == \"lox\";"), "(print true)\n");
+  EXPECT_EQ(optimize("print !nil;"), "(print true)\n");
+}
+
+TEST(ConstantFoldingTest, LeavesErrorsToRuntime) {
+  EXPECT_EQ(optimize("print 1 / 0;"), "(print (/ 1.000000 0.000000))\n");
+  EXPECT_EQ(optimize("print \"a\" + 1;"), "(print (+ \"a\" 1.000000))\n");
+  EXPECT_EQ(optimize("print -\"a\";"), "(print (- \"a\"))\n");
+}
+
+TEST(DeadBranchEliminationTest, RemovesBranchesNeverTaken) {
+  EXPECT_EQ(optimize("if (1 > 2) print 1; else print 2;"), "(print 2.000000)\n");
+  EXPECT_EQ(optimize("if (nil) print 1; print 2;"), "(print 2.000000)\n");
+  EXPECT_EQ(optimize("while (false) print 1;"), "");
+  EXPECT_EQ(optimize("print true ? 1 : 2;"), "(print 1.000000)\n");
+  EXPECT_EQ(optimize("for (var i = 0; false;) print i;"),
+            "(block\n  (var i 0.000000))\n");
+}
+
+TEST(ConstantPropagationTest, ReplacesLocalsNeverAssigned) {
+  EXPECT_EQ(optimize("fun f() { var n = 2; return n * 3; }"),
+            "(fun f ()\n  (var n 2.000000)\n  (return 6.000000))\n");
+  EXPECT_EQ(optimize("fun f() { var n = 2; n = 3; return n; }"),
+            "(fun f ()\n  (var n 2.000000)\n  (; (= n 3.000000))\n"
+            "  (return n))\n");
+}
+
+TEST(ConstantPropagationTest, RespectsScopes) {
+  // Globals may be assigned by later code, parameters by the caller.
+  EXPECT_EQ(optimize("var g = 1; print g;"), "(var g 1.000000)\n(print g)\n");
+  EXPECT_EQ(optimize("fun f(n) { { var n = 1; } return n; }"),
+            "(fun f (n)\n  (block\n    (var n 1.000000))\n  (return n))\n");
+}
+
+TEST(PassManagerTest, LevelZeroRunsNoPasses) {
+  EXPECT_TRUE(PassManager::forLevel(0).empty());
+  EXPECT_EQ(optimize("print 1 + 2;", 0), "(print (+ 1.000000 2.000000))\n");
+}
+
+TEST(InliningTest, SubstitutesArgumentsForParameters) {
+  EXPECT_EQ(optimize("fun sq(x) { return x * x; }\n"
+                     "{ var n = 1; n = 2; print sq(n); }"),
+            "(fun sq (x)\n  (return (* x x)))\n"
+            "(block\n  (var n 1.000000)\n  (; (= n 2.000000))\n"
+            "  (print (inline sq (* n n))))\n");
+  // Inlined bodies are folded like any other expression.
+  EXPECT_EQ(optimize("fun sq(x) { return x * x; } print sq(3);"),
+            "(fun sq (x)\n  (return (* x x)))\n(print (inline sq 9.000000))\n");
+}
+
+TEST(InliningTest, KeepsCallsItCanNotInline) {
+  // Recursive, declared twice, called with a global or an expression.
+  EXPECT_EQ(optimize("fun f(n) { return f(n); } print f(1);"),
+            "(fun f (n)\n  (return (call f n)))\n(print (call f 1.000000))\n");
+  EXPECT_EQ(optimize("fun f() { return 1; } var f; print f();"),
+            "(fun f ()\n  (return 1.000000))\n(var f)\n(print (call f))\n");
+  EXPECT_EQ(optimize("fun f(n) { return n; } var g = 1; print f(g);"),
+            "(fun f (n)\n  (return n))\n(var g 1.000000)\n(print (call f g))\n");
+  EXPECT_EQ(optimize("fun f(n) { return n; } print f(clock());"),
+            "(fun f (n)\n  (return n))\n(print (call f (call clock)))\n");
+}
+
+TEST(InliningTest, HonorsTheLimits) {
+  std::string source = "fun f(n) { return n + 1; } fun g(n) { return f(n); } "
+                       "print g(1);";
+  EXPECT_EQ(optimize(source), "(fun f (n)\n  (return (+ n 1.000000)))\n"
+                              "(fun g (n)\n  (return (inline f (+ n 1.000000))))\n"
+                              "(print (inline g (inline f 2.000000)))\n");
+
+  Tokenizer tokenizer{source};
+  Parser parser{tokenizer.getTokens()};
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
+  Inlining({.size = 16, .depth = 1}).run(*unit);
+  EXPECT_EQ(PrinterVisitor().print(unit->statements()),
+            "(fun f (n)\n  (return (+ n 1.000000)))\n"
+            "(fun g (n)\n  (return (inline f (+ n 1.000000))))\n"
+            "(print (inline g (call f 1.000000)))\n");
+
+  EXPECT_EQ(optimize("fun f(n) { return n + 1; } print f(1);", 0),
+            "(fun f (n)\n  (return (+ n 1.000000)))\n(print (call f 1.000000))\n");
+}
+
+TEST(PurityAnalysisTest, FindsPureFunctions) {
+  EXPECT_EQ(pure("fun fib(n) { if (n < 2) return n;"
+                 "  return fib(n - 1) + fib(n - 2); }"
+                 "fun sum(n) { var s = 0;"
+                 "  for (var i = 0; i < n; i = i + 1) s = s + i; return s; }"
+                 "var limit = 10;"
+                 "fun capped(n) { return sum(n) < limit; }"),
+            (std::vector<std::string>{"capped", "fib", "sum"}));
+}
+
+TEST(PurityAnalysisTest, ReportsTheDeclarationsOfDependencies) {
+  Tokenizer tokenizer{"fun sum(n) { return n; }"
+                      "var limit = 10;"
+                      "fun capped(n) { return sum(n) < limit; }"};
+  Parser parser{tokenizer.getTokens()};
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
+  PurityAnalysis purity;
+  purity.run(*unit);
+
+  const std::vector<Stmt::Stmt *> &statements = unit->statements();
+  auto capped = static_cast<const Stmt::FunctionStmt *>(statements[2]);
+  EXPECT_EQ(purity.dependencies(capped),
+            (PurityAnalysis::Dependencies{
+                {"sum", static_cast<const Stmt::Declaration *>(statements[0])},
+                {"limit", static_cast<const Stmt::Declaration *>(statements[1])}}));
+}
+
+TEST(PurityAnalysisTest, RejectsEffectsAndChangingGlobals) {
+  EXPECT_EQ(pure("fun a(x) { print x; return x; }"
+                 "fun b(x) { return a(x); }"
+                 "fun c(x) { return clock() + x; }"
+                 "fun d(x) { return x.field; }"
+                 "var scale = 1;"
+                 "fun e(x) { return x * scale; }"
+                 "fun f() { scale = 2; }"
+                 "fun g(x) { fun h() { return x; } return h; }"
+                 "fun i(x) { return x; }"
+                 "fun i(x) { return x + 1; }"),
+            std::vector<std::string>{});
+}
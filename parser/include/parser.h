@@ -1,8 +1,10 @@
 #pragma once
 
+#include <compilation_unit.h>
 #include <expr.h>
 #include <stmt.h>
 #include <token.h>
+#include <memory>
 #include <vector>
 
 class Parser {
@@ -14,7 +16,7 @@ public:
   Parser(std::vector<Token>);
   Parser(std::vector<Token>, bool);
 
-  std::vector<Stmt::Stmt *> parse();
+  std::shared_ptr<CompilationUnit> parse();
 
 private:
   Stmt::Stmt *declaration();
@@ -55,7 +57,12 @@ private:
 
   Exception error(Token, const std::string &);
 
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    return _unit->make<T>(std::forward<Args>(args)...);
+  }
+
   int _current = 0;
   bool _is_repl = false;
   std::vector<Token> _tokens;
+  std::shared_ptr<CompilationUnit> _unit;
 };
@@ -7,12 +7,15 @@
 #include <function_type.h>
 
 #include <deque>
+#include <resolution.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 enum ClassType {
   CLASS_NONE,
-  LOX_CLASS
+  LOX_CLASS,
+  SUBCLASS
 };
 
 class Resolver : public Expr::ExprVisitor, public Stmt::StmtVisitor {
@@ -42,6 +45,8 @@ public:
   void visitGet(const Expr::GetExpr *) override;
   void visitSet(const Expr::SetExpr *) override;
   void visitThis(const Expr::ThisExpr *) override;
+  void visitSuper(const Expr::SuperExpr *) override;
+  void visitInline(const Expr::InlineExpr *) override;
 
   void resolve(const std::vector<Stmt::Stmt *> &);
 
@@ -49,17 +54,49 @@ private:
   void resolve(const std::vector<const Stmt::Stmt *> &);
   void resolve(const Stmt::Stmt *);
   void resolve(const Expr::Expr *);
-  void resolveLocal(const Expr::Expr *, const Token &);
+  void resolveLocal(const Expr::Reference *, const Token &);
   void resolveFunction(const Stmt::FunctionStmt *, FunctionType);
 
   void beginScope();
   void endScope();
 
-  void declare(const Token &);
+  struct Variable {
+    bool defined;
+    int slot;
+    bool captured = false;
+    // Whether the variable is captured is only known once its scope ends,
+    // until then its uses in the declaring function are collected here.
+    std::vector<const Expr::Reference *> uses;
+    const Stmt::Declaration *declaration = nullptr;
+    int param = -1;
+  };
+
+  // Every declaration takes the next slot of its function, even if it
+  // shadows an earlier one with the same name. Slots are reused once the
+  // scope ends.
+  struct Scope {
+    std::unordered_map<std::string, Variable> variables;
+    int start;
+  };
+
+  struct Function {
+    FunctionInfo info;
+    // Index of the function's outermost scope.
+    size_t base;
+    int nextSlot = 0;
+  };
+
+  Variable *declare(const Token &, const Stmt::Declaration * = nullptr);
   void define(const Token &);
+  void finish(Variable &);
+  size_t functionOf(size_t scope) const;
+  int capture(size_t function, size_t scope, Variable &);
 
   Interpreter &_interpreter;
-  std::deque<std::unordered_map<std::string, bool>> _scopes;
+  std::deque<Scope> _scopes;
+  // The functions being resolved, innermost last. The first one stands for
+  // the top level code.
+  std::vector<Function> _functions;
   
   ClassType _currentClass = ClassType::CLASS_NONE;
   FunctionType _currentFunction = FunctionType::FUNCTION_NONE;
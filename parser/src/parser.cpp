@@ -3,19 +3,19 @@
 #include "lox.h"
 #include "token_type.h"
 
-Parser::Parser(std::vector<Token> tokens) : _tokens(std::move(tokens)) {}
-Parser::Parser(std::vector<Token> tokens, bool is_repl) : _tokens(std::move(tokens)), _is_repl(is_repl) {}
-
-std::vector<Stmt::Stmt *> Parser::parse() {
-  std::vector<Stmt::Stmt *> statements;
+Parser::Parser(std::vector<Token> tokens) : Parser(std::move(tokens), false) {}
+Parser::Parser(std::vector<Token> tokens, bool is_repl)
+    : _is_repl(is_repl), _tokens(std::move(tokens)),
+      _unit(std::make_shared<CompilationUnit>()) {}
 
+std::shared_ptr<CompilationUnit> Parser::parse() {
   while (!isEnd()) {
     Stmt::Stmt* decl = declaration();
     if (decl != nullptr)
-      statements.push_back(decl);
+      _unit->statements().push_back(decl);
   }
 
-  return statements;
+  return _unit;
 }
 
 Stmt::Stmt *Parser::declaration() {
@@ -43,7 +43,7 @@ Stmt::Stmt *Parser::varDeclaration() {
   }
 
   consume(SEMICOLON, "Expect ';' after variable declaration.");
-  return new Stmt::VarStmt(name, initializer);
+  return make<Stmt::VarStmt>(name, initializer);
 }
 
 Stmt::Stmt *Parser::funDeclaration() {
@@ -63,21 +63,32 @@ Stmt::Stmt *Parser::funDeclaration() {
 
   consume(LEFT_BRACE, "Expect '{' before function body.");
   std::vector<const Stmt::Stmt *> body = block();
-  return new Stmt::FunctionStmt(name, params, body);
+  return make<Stmt::FunctionStmt>(name, params, body, _unit.get());
 }
 
 Stmt::Stmt *Parser::classDeclaration() {
   Token name = consume(IDENTIFIER, "Expected name after class keyword.");
+
+  Stmt::VarStmt *superDeclaration = nullptr;
+  if (advanceIfMatch({LESS})) {
+    Token superclass = consume(IDENTIFIER, "Expect superclass name.");
+    superDeclaration = make<Stmt::VarStmt>(
+        Token(SUPER, "super", LoxType(), superclass.line()),
+        make<Expr::VariableExpr>(superclass));
+  }
+
   consume(LEFT_BRACE, "Expect '{' before class body.");
 
-  std::vector<Stmt::FunctionStmt *> methods;
+  std::vector<const Stmt::FunctionStmt *> methods;
   while (!check(RIGHT_BRACE) && !isEnd()) {
     methods.push_back(dynamic_cast<Stmt::FunctionStmt *>(funDeclaration()));
   }
 
   consume(RIGHT_BRACE, "Expect '}' after class body.");
 
-  return new Stmt::ClassStmt(name, methods);
+  if (superDeclaration != nullptr)
+    return make<Stmt::ClassStmt>(name, superDeclaration, methods);
+  return make<Stmt::ClassStmt>(name, methods);
 }
 
 Stmt::Stmt *Parser::statement() {
@@ -86,7 +97,7 @@ Stmt::Stmt *Parser::statement() {
   if (advanceIfMatch({RETURN}))
     return returnStatement();
   if (advanceIfMatch({LEFT_BRACE}))
-    return new Stmt::Block(block());
+    return make<Stmt::Block>(block());
   if (advanceIfMatch({IF}))
     return ifStatement();
   if (advanceIfMatch({WHILE}))
@@ -100,7 +111,7 @@ Stmt::Stmt *Parser::statement() {
 Stmt::Stmt *Parser::printStatement() {
   Expr::Expr *expr = expression();
   consume(SEMICOLON, "Expected ';' after expression.");
-  return new Stmt::PrintStmt(expr);
+  return make<Stmt::PrintStmt>(expr);
 }
 
 Stmt::Stmt *Parser::expressionStatement() {
@@ -109,9 +120,9 @@ Stmt::Stmt *Parser::expressionStatement() {
 
   if (next_token.type() == TOKEN_TYPE::SEMICOLON) {
     advance();
-    return new Stmt::ExprStmt(expr);
+    return make<Stmt::ExprStmt>(expr);
   } else if (_is_repl) {
-    return new Stmt::PrintStmt(expr);
+    return make<Stmt::PrintStmt>(expr);
   }
 
   throw error(next_token, "Expected ';' after expression.");
@@ -139,7 +150,7 @@ Stmt::Stmt *Parser::ifStatement() {
     elseBranch = statement();
   }
 
-  return new Stmt::IfStmt(condition, thenBranch, elseBranch);
+  return make<Stmt::IfStmt>(condition, thenBranch, elseBranch);
 }
 
 Stmt::Stmt *Parser::whileStatement() {
@@ -148,7 +159,7 @@ Stmt::Stmt *Parser::whileStatement() {
   consume(RIGHT_PAREN, "Expect ')' after expr.");
 
   Stmt::Stmt *body = statement();
-  return new Stmt::WhileStmt(condition, body);
+  return make<Stmt::WhileStmt>(condition, body);
 }
 
 Stmt::Stmt *Parser::forStatement() {
@@ -173,7 +184,7 @@ Stmt::Stmt *Parser::forStatement() {
 
   Stmt::Stmt *body = statement();
 
-  return new Stmt::ForStmt(init, condition, after, body);
+  return make<Stmt::ForStmt>(init, condition, after, body);
 }
 
 Stmt::Stmt *Parser::returnStatement() {
@@ -184,7 +195,7 @@ Stmt::Stmt *Parser::returnStatement() {
   }
 
   consume(SEMICOLON, "Expected semicolon after return statement.");
-  return new Stmt::ReturnStmt(ret, value);
+  return make<Stmt::ReturnStmt>(ret, value);
 }
 
 Expr::Expr *Parser::expression() { return assignment(); }
@@ -202,12 +213,12 @@ Expr::Expr *Parser::assignment() {
     if (variable_ptr != nullptr) {
       Token name = variable_ptr->name();
 
-      return new Expr::AssignExpr(name, value);
+      return make<Expr::AssignExpr>(name, value);
     } else if (get_ptr != nullptr) {
       Token name = get_ptr->name();
       const Expr::Expr* object = get_ptr->object();
 
-      return new Expr::SetExpr(object, name, value);
+      return make<Expr::SetExpr>(object, name, value);
     }
 
     error(equals, "Invalid assignment target.");
@@ -225,7 +236,7 @@ Expr::Expr *Parser::ternary() {
     consume(SEMICOLON, "Expected ':' for ternary expression");
 
     Expr::Expr *second = expression();
-    expr = new Expr::TernaryExpr(expr, first, second);
+    expr = make<Expr::TernaryExpr>(expr, first, second);
   }
 
   return expr;
@@ -238,7 +249,7 @@ Expr::Expr *Parser::logic() {
     Token op = previous();
     Expr::Expr *second = equality();
 
-    expr = new Expr::LogicExpr(op, expr, second);
+    expr = make<Expr::LogicExpr>(op, expr, second);
   }
 
   return expr;
@@ -251,7 +262,7 @@ Expr::Expr *Parser::equality() {
     Token op = previous();
 
     Expr::Expr *right = comparison();
-    expr = new Expr::BinaryExpr(expr, op, right);
+    expr = make<Expr::BinaryExpr>(expr, op, right);
   }
 
   return expr;
@@ -263,7 +274,7 @@ Expr::Expr *Parser::comparison() {
   while (advanceIfMatch({GREATER, GREATER_EQUAL, LESS, LESS_EQUAL})) {
     Token op = previous();
     Expr::Expr *right = term();
-    expr = new Expr::BinaryExpr(expr, op, right);
+    expr = make<Expr::BinaryExpr>(expr, op, right);
   }
 
   return expr;
@@ -275,7 +286,7 @@ Expr::Expr *Parser::term() {
   while (advanceIfMatch({MINUS, PLUS})) {
     Token op = previous();
     Expr::Expr *right = factor();
-    expr = new Expr::BinaryExpr(expr, op, right);
+    expr = make<Expr::BinaryExpr>(expr, op, right);
   }
 
   return expr;
@@ -287,7 +298,7 @@ Expr::Expr *Parser::factor() {
   while (advanceIfMatch({SLASH, STAR})) {
     Token op = previous();
     Expr::Expr *right = unary();
-    expr = new Expr::BinaryExpr(expr, op, right);
+    expr = make<Expr::BinaryExpr>(expr, op, right);
   }
 
   return expr;
@@ -297,7 +308,7 @@ Expr::Expr *Parser::unary() {
   while (advanceIfMatch({MINUS, BANG})) {
     Token op = previous();
     Expr::Expr *expr = unary();
-    return new Expr::UnaryExpr(op, expr);
+    return make<Expr::UnaryExpr>(op, expr);
   }
 
   return call();
@@ -318,10 +329,10 @@ Expr::Expr *Parser::call() {
       }
 
       Token paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
-      expr = new Expr::CallExpr(expr, paren, arguments);
+      expr = make<Expr::CallExpr>(expr, paren, arguments);
     } else if (advanceIfMatch({DOT})) {
       Token name = consume(IDENTIFIER, "Expect property name after '.'.");
-      expr = new Expr::GetExpr(expr, name);
+      expr = make<Expr::GetExpr>(expr, name);
     } else {
       break;
     }
@@ -332,25 +343,33 @@ Expr::Expr *Parser::call() {
 
 Expr::Expr *Parser::primary() {
   if (advanceIfMatch({FALSE}))
-    return new Expr::LiteralExpr(false);
+    return make<Expr::LiteralExpr>(false);
   if (advanceIfMatch({TRUE}))
-    return new Expr::LiteralExpr(true);
+    return make<Expr::LiteralExpr>(true);
   if (advanceIfMatch({NIL}))
-    return new Expr::LiteralExpr(std::monostate());
+    return make<Expr::LiteralExpr>(std::monostate());
   if (advanceIfMatch({NUMBER, STRING})) {
-    return new Expr::LiteralExpr(previous().literal());
+    return make<Expr::LiteralExpr>(previous().literal());
   }
   if (advanceIfMatch({THIS})) {
-    return new Expr::ThisExpr(previous());
+    return make<Expr::ThisExpr>(previous());
+  }
+  if (advanceIfMatch({SUPER})) {
+    Token keyword = previous();
+    consume(DOT, "Expect '.' after 'super'.");
+    Token method = consume(IDENTIFIER, "Expect superclass method name.");
+    return make<Expr::SuperExpr>(
+        keyword, method,
+        make<Expr::ThisExpr>(Token(THIS, "this", LoxType(), keyword.line())));
   }
   if (advanceIfMatch({IDENTIFIER})) {
-    return new Expr::VariableExpr(previous());
+    return make<Expr::VariableExpr>(previous());
   }
   if (advanceIfMatch({LEFT_PAREN})) {
     Expr::Expr *expr = expression();
     consume(RIGHT_PAREN, "Expect ')' after expression.");
 
-    return new Expr::GroupingExpr(expr);
+    return make<Expr::GroupingExpr>(expr);
   }
 
   throw error(peek(), "Expected expression");
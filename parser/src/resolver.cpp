@@ -1,7 +1,11 @@
 #include <lox.h>
 #include <resolver.h>
 
-Resolver::Resolver(Interpreter &interpreter) : _interpreter(interpreter) {}
+#include <algorithm>
+
+Resolver::Resolver(Interpreter &interpreter) : _interpreter(interpreter) {
+  _functions.push_back({FunctionInfo(), 0});
+}
 
 void Resolver::visitExprStmt(const Stmt::ExprStmt *stmt) {
   resolve(stmt->expr());
@@ -12,7 +16,7 @@ void Resolver::visitPrintStmt(const Stmt::PrintStmt *stmt) {
 }
 
 void Resolver::visitVarStmt(const Stmt::VarStmt *stmt) {
-  declare(stmt->name());
+  declare(stmt->name(), stmt);
   if (stmt->init() != nullptr) {
     resolve(stmt->init());
   }
@@ -38,14 +42,21 @@ void Resolver::visitWhileStmt(const Stmt::WhileStmt *stmt) {
 }
 
 void Resolver::visitForStmt(const Stmt::ForStmt *stmt) {
-  resolve(stmt->init());
-  resolve(stmt->condition());
+  beginScope();
+
+  if (stmt->init() != nullptr)
+    resolve(stmt->init());
+  if (stmt->condition() != nullptr)
+    resolve(stmt->condition());
   resolve(stmt->body());
-  resolve(stmt->after());
+  if (stmt->after() != nullptr)
+    resolve(stmt->after());
+
+  endScope();
 }
 
 void Resolver::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
-  declare(stmt->name());
+  declare(stmt->name(), stmt);
   define(stmt->name());
 
   resolveFunction(stmt, FunctionType::FUNCTION);
@@ -59,6 +70,13 @@ void Resolver::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
     }
     resolve(stmt->expr());
   }
+
+  // The value of a call returned by a function is the value of the function
+  // call itself, which the called function can run in place of.
+  bool tailCall = dynamic_cast<const Expr::CallExpr *>(stmt->expr()) != nullptr &&
+                  (_currentFunction == FunctionType::FUNCTION ||
+                   _currentFunction == FunctionType::METHOD);
+  stmt->resolveTailCall(tailCall);
 }
 
 void Resolver::visitClassStmt(const Stmt::ClassStmt *stmt) {
@@ -66,14 +84,22 @@ void Resolver::visitClassStmt(const Stmt::ClassStmt *stmt) {
 
   _currentClass = ClassType::LOX_CLASS;
 
-  declare(stmt->name());
+  declare(stmt->name(), stmt);
   define(stmt->name());
 
-  beginScope();
+  if (stmt->superclass() != nullptr) {
+    _currentClass = ClassType::SUBCLASS;
+    if (stmt->superclass()->name().lexeme() == stmt->name().lexeme()) {
+      Lox::runtime_error(RuntimeError(stmt->superclass()->name(),
+                                      "A class can't inherit from itself."));
+    }
 
-  _scopes.back()["this"] = true;
+    // Even at the top level, so that super is a local the methods capture.
+    beginScope();
+    resolve(stmt->superDeclaration());
+  }
 
-  for (Stmt::FunctionStmt *method : stmt->methods()) {
+  for (const Stmt::FunctionStmt *method : stmt->methods()) {
     FunctionType funType = FunctionType::METHOD;
 
     if (method->name().lexeme() == "init")
@@ -82,7 +108,8 @@ void Resolver::visitClassStmt(const Stmt::ClassStmt *stmt) {
     resolveFunction(method, funType);
   }
 
-  endScope();
+  if (stmt->superclass() != nullptr)
+    endScope();
 
   _currentClass = enclosingClass;
 }
@@ -109,10 +136,12 @@ void Resolver::visitTernary(const Expr::TernaryExpr *expr) {
 }
 
 void Resolver::visitVariable(const Expr::VariableExpr *expr) {
-  if (!_scopes.empty() && _scopes.back().contains(expr->name().lexeme()) &&
-      _scopes.back()[expr->name().lexeme()] == false) {
-    Lox::runtime_error(RuntimeError(
-        expr->name(), "Cannot read local variable in its own initializer."));
+  if (!_scopes.empty()) {
+    auto it = _scopes.back().variables.find(expr->name().lexeme());
+    if (it != _scopes.back().variables.end() && !it->second.defined) {
+      Lox::runtime_error(RuntimeError(
+          expr->name(), "Cannot read local variable in its own initializer."));
+    }
   }
 
   resolveLocal(expr, expr->name());
@@ -151,10 +180,33 @@ void Resolver::visitThis(const Expr::ThisExpr *expr) {
   resolveLocal(expr, expr->keyword());
 }
 
+void Resolver::visitSuper(const Expr::SuperExpr *expr) {
+  if (_currentClass == ClassType::CLASS_NONE) {
+    Lox::runtime_error(RuntimeError(
+        expr->keyword(), "Can't use 'super' keyword outside of a class."));
+    return;
+  }
+  if (_currentClass != ClassType::SUBCLASS) {
+    Lox::runtime_error(RuntimeError(
+        expr->keyword(), "Can't use 'super' in a class with no superclass."));
+  }
+  resolveLocal(expr, expr->keyword());
+  resolve(expr->self());
+}
+
+// The body is made of the arguments of the call and nodes of the function
+// that refer to nothing but globals.
+void Resolver::visitInline(const Expr::InlineExpr *expr) {
+  resolve(expr->call());
+  resolve(expr->body());
+}
+
 void Resolver::resolve(const std::vector<Stmt::Stmt *> &statements) {
   for (const Stmt::Stmt *stmt : statements) {
     resolve(stmt);
   }
+
+  _interpreter.resolveScript(_functions.front().info);
 }
 
 void Resolver::resolve(const std::vector<const Stmt::Stmt *> &statements) {
@@ -169,13 +221,49 @@ void Resolver::resolve(const Expr::Expr *expression) {
   expression->accept(this);
 }
 
-void Resolver::resolveLocal(const Expr::Expr *expr, const Token &name) {
+void Resolver::resolveLocal(const Expr::Reference *expr, const Token &name) {
   for (int i = _scopes.size() - 1; i >= 0; i--) {
-    if (_scopes[i].contains(name.lexeme())) {
-      _interpreter.resolve(expr, _scopes.size() - 1 - i);
-      return;
-    }
+    auto it = _scopes[i].variables.find(name.lexeme());
+    if (it == _scopes[i].variables.end())
+      continue;
+
+    size_t function = _functions.size() - 1;
+    if (functionOf(i) == function)
+      it->second.uses.push_back(expr);
+    else
+      expr->resolve({Local::UPVALUE, capture(function, i, it->second)});
+    return;
+  }
+
+  expr->resolveGlobal();
+}
+
+// Makes the variable declared in the given scope available to a function
+// nested inside it, and returns its index among the function's upvalues.
+int Resolver::capture(size_t function, size_t scope, Variable &variable) {
+  Capture captured;
+  if (functionOf(scope) == function - 1) {
+    variable.captured = true;
+    captured = {true, variable.slot};
+  } else {
+    captured = {false, capture(function - 1, scope, variable)};
   }
+
+  std::vector<Capture> &captures = _functions[function].info.captures;
+  for (size_t i = 0; i < captures.size(); i++) {
+    if (captures[i].local == captured.local && captures[i].index == captured.index)
+      return i;
+  }
+
+  captures.push_back(captured);
+  return captures.size() - 1;
+}
+
+size_t Resolver::functionOf(size_t scope) const {
+  size_t function = _functions.size() - 1;
+  while (_functions[function].base > scope)
+    function--;
+  return function;
 }
 
 void Resolver::resolveFunction(const Stmt::FunctionStmt *stmt,
@@ -184,33 +272,89 @@ void Resolver::resolveFunction(const Stmt::FunctionStmt *stmt,
   FunctionType prevFunction = _currentFunction;
   _currentFunction = type;
 
+  _functions.push_back({FunctionInfo(), _scopes.size()});
   beginScope();
 
-  for (const Token &param : stmt->params()) {
-    declare(param);
+  std::vector<Token> params = stmt->params();
+  if (type == FunctionType::METHOD || type == FunctionType::INITIALIZER) {
+    _functions.back().info.method = true;
+    params.insert(params.begin(), Token(THIS, "this"));
+  }
+
+  for (const Token &param : params) {
+    Variable *variable = declare(param);
     define(param);
+
+    std::vector<Local> &infoParams = _functions.back().info.params;
+    variable->param = infoParams.size();
+    infoParams.emplace_back();
   }
 
   resolve(stmt->body());
   endScope();
 
+  stmt->resolveFunction(std::move(_functions.back().info));
+  _functions.pop_back();
+
   _currentFunction = prevFunction;
 }
 
-void Resolver::declare(const Token &name) {
-  if (_scopes.empty())
-    return;
+Resolver::Variable *Resolver::declare(const Token &name,
+                                      const Stmt::Declaration *declaration) {
+  if (_scopes.empty()) {
+    if (declaration != nullptr)
+      declaration->resolveGlobal();
+    return nullptr;
+  }
+
+  Scope &scope = _scopes.back();
+  Function &function = _functions.back();
+
+  // A redeclaration hides the earlier variable for good.
+  auto it = scope.variables.find(name.lexeme());
+  if (it != scope.variables.end())
+    finish(it->second);
 
-  _scopes.back()[name.lexeme()] = false;
+  Variable &variable = scope.variables[name.lexeme()];
+  variable = Variable{};
+  variable.slot = function.nextSlot++;
+  variable.declaration = declaration;
+  function.info.slots = std::max(function.info.slots, function.nextSlot);
+
+  return &variable;
+}
+
+// Reports where the variable lives, now that all its uses are known.
+void Resolver::finish(Variable &variable) {
+  FunctionInfo &info = _functions.back().info;
+  Local local{variable.captured ? Local::CELL : Local::SLOT, variable.slot};
+  if (variable.captured)
+    info.hasCells = true;
+
+  for (const Expr::Reference *use : variable.uses)
+    use->resolve(local);
+  if (variable.declaration != nullptr)
+    variable.declaration->resolve(local);
+  if (variable.param >= 0)
+    info.params[variable.param] = local;
 }
 
 void Resolver::define(const Token &name) {
   if (_scopes.empty())
     return;
 
-  _scopes.back()[name.lexeme()] = true;
+  _scopes.back().variables[name.lexeme()].defined = true;
 }
 
-void Resolver::beginScope() { _scopes.emplace_back(); }
+void Resolver::beginScope() {
+  _scopes.push_back({{}, _functions.back().nextSlot});
+}
+
+void Resolver::endScope() {
+  Scope &scope = _scopes.back();
+  for (auto &[name, variable] : scope.variables)
+    finish(variable);
 
-void Resolver::endScope() { _scopes.pop_back(); }
+  _functions.back().nextSlot = scope.start;
+  _scopes.pop_back();
+}
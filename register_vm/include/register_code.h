@@ -0,0 +1,145 @@
+#pragma once
+
+#include <callables.h>
+#include <lox_function.h>
+#include <lox_type.h>
+#include <resolution.h>
+#include <stmt.h>
+#include <token.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace Register {
+
+// Instructions of the register machine. A names the register written, B
+// and C the registers read, as in ADD A B C: R[A] = R[B] + R[C]. The K
+// forms read a constant as C instead. Jumps keep their offset in A and are
+// relative to the next instruction. The list is expanded into the opcode
+// enum and into the VM's dispatch table, which must stay in the same order.
+#define REGISTER_OPCODES(X)                                                    \
+  X(MOVE)           /* R[A] = R[B] */                                          \
+  X(LOADK)          /* R[A] = K[B] */                                          \
+  X(GET_CELL)       /* R[A] = cells[B] */                                      \
+  X(SET_CELL)       /* cells[A] = R[B] */                                      \
+  X(NEW_CELL)       /* cells[A] = new cell holding R[B] */                     \
+  X(EMPTY_CELL)     /* cells[A] = new cell holding nil */                      \
+  X(GET_UPVALUE)    /* R[A] = upvalues[B] */                                   \
+  X(SET_UPVALUE)    /* upvalues[A] = R[B] */                                   \
+  X(GET_GLOBAL)     /* R[A] = globals[tokens[B]] */                            \
+  X(SET_GLOBAL)     /* globals[tokens[A]] = R[B] */                            \
+  X(DEFINE_GLOBAL)  /* define globals[tokens[A]] = R[B] */                     \
+  X(GET_PROPERTY)   /* R[A] = R[B].tokens[C] */                                \
+  X(SET_PROPERTY)   /* R[A].tokens[B] = R[C] */                                \
+  X(GET_SUPER)      /* R[A] = method tokens[C] of class R[B], bound to R[A] */ \
+  X(ADD)                                                                       \
+  X(ADDK)                                                                      \
+  X(SUBTRACT)                                                                  \
+  X(SUBTRACTK)                                                                 \
+  X(MULTIPLY)                                                                  \
+  X(MULTIPLYK)                                                                 \
+  X(DIVIDE)                                                                    \
+  X(DIVIDEK)                                                                   \
+  X(LESS)                                                                      \
+  X(LESSK)                                                                     \
+  X(LESS_EQUAL)                                                                \
+  X(LESS_EQUALK)                                                               \
+  X(GREATER)                                                                   \
+  X(GREATERK)                                                                  \
+  X(GREATER_EQUAL)                                                             \
+  X(GREATER_EQUALK)                                                            \
+  X(EQUAL)                                                                     \
+  X(NOT_EQUAL)                                                                 \
+  X(NOT)            /* R[A] = !R[B] */                                         \
+  X(NEGATE)         /* R[A] = -R[B] */                                         \
+  X(TRUTH)          /* R[A] = R[B] is truthy */                                \
+  X(JUMP)                                                                      \
+  X(JUMP_IF_FALSE)  /* if R[B] is falsey */                                    \
+  X(JUMP_IF_TRUE)   /* if R[B] is truthy */                                    \
+  /* Comparisons fused with the jump of a condition, taken when false. */      \
+  X(JUMP_IF_NOT_LESS)                                                          \
+  X(JUMP_IF_NOT_LESSK)                                                         \
+  X(JUMP_IF_NOT_LESS_EQUAL)                                                    \
+  X(JUMP_IF_NOT_LESS_EQUALK)                                                   \
+  X(JUMP_IF_NOT_GREATER)                                                       \
+  X(JUMP_IF_NOT_GREATERK)                                                      \
+  X(JUMP_IF_NOT_GREATER_EQUAL)                                                 \
+  X(JUMP_IF_NOT_GREATER_EQUALK)                                                \
+  X(LOOP)           /* jumps back by A */                                      \
+  X(PRINT)          /* prints R[A] */                                          \
+  X(CALL)           /* R[A] = R[A](R[A + 1], ..., R[A + B]) */                 \
+  X(CLOSURE)        /* R[A] = new function of functions[B] */                  \
+  X(CLASS)          /* R[A] = new class of classes[B], subclass of R[C] */     \
+  X(RETURN)         /* returns R[A] */                                         \
+  X(RETURN_NIL)
+
+enum OpCode : uint8_t {
+#define REGISTER_OPCODE_ENUM(name) OP_##name,
+  REGISTER_OPCODES(REGISTER_OPCODE_ENUM)
+#undef REGISTER_OPCODE_ENUM
+};
+
+struct Instruction {
+  OpCode op;
+  uint16_t a = 0;
+  uint16_t b = 0;
+  uint16_t c = 0;
+};
+
+// A class declaration, instantiated by OP_CLASS.
+struct ClassInfo {
+  std::string name;
+  std::vector<FunctionCode> methods;
+  // The name of the superclass, if the class has one.
+  std::optional<Token> superclass;
+};
+
+// Compiled code of one function, or of the top level code of a script.
+// Locals are the registers the Resolver assigned as slots, temporaries are
+// allocated above them. LoxFunctions created from the declaration run this
+// code, and keep it alive.
+struct Function : CompiledFunction {
+  static constexpr uint32_t NO_TOKEN = UINT32_MAX;
+
+  const Stmt::FunctionStmt *declaration = nullptr;
+  FunctionInfo info;
+  // Registers used by the code: the slots of its locals and temporaries.
+  int registers = 0;
+  Token name{END_OF_FILE, ""};
+
+  std::vector<Instruction> code;
+  std::vector<LoxType> constants;
+  std::vector<Token> tokens;
+  // Where globals named by a token are stored, once the VM looked them up.
+  mutable std::vector<LoxType *> globals;
+  // The functions declared in the code.
+  std::vector<FunctionCode> functions;
+  std::vector<ClassInfo> classes;
+  // The token each instruction reports errors at, parallel to code.
+  std::vector<uint32_t> locations;
+
+  size_t addConstant(const LoxType &value) {
+    for (size_t i = 0; i < constants.size(); i++) {
+      if (constants[i].tag() == value.tag() && constants[i] == value)
+        return i;
+    }
+    constants.push_back(value);
+    return constants.size() - 1;
+  }
+  size_t addToken(const Token &token) {
+    tokens.push_back(token);
+    globals.push_back(nullptr);
+    return tokens.size() - 1;
+  }
+
+  const Token &tokenAt(const Instruction *instruction) const {
+    uint32_t index = locations[instruction - code.data()];
+    return index == NO_TOKEN ? name : tokens[index];
+  }
+};
+
+} // namespace Register
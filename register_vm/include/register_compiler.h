@@ -0,0 +1,95 @@
+#pragma once
+
+#include <expression_visitor.h>
+#include <interpreter.h>
+#include <register_code.h>
+#include <stmt_visitor.h>
+
+#include <memory>
+#include <vector>
+
+namespace Register {
+
+// Translates resolved syntax trees to register code. Locals live in the
+// registers of the slots the Resolver gave them, so the VM's frames look
+// like the tree walker's (see Frame). Each expression is compiled into a
+// target register, temporaries are allocated above the locals and freed
+// in the order they were allocated.
+class Compiler : public Expr::ExprVisitor, public Stmt::StmtVisitor {
+public:
+  explicit Compiler(const Interpreter &resolution) : _resolution(resolution) {}
+
+  // Compiles top level code, and every function declared in it. Returns
+  // nullptr if the code does not fit the instruction format.
+  std::unique_ptr<Function> compile(const std::vector<Stmt::Stmt *> &);
+
+  void visitExprStmt(const Stmt::ExprStmt *) override;
+  void visitPrintStmt(const Stmt::PrintStmt *) override;
+  void visitVarStmt(const Stmt::VarStmt *) override;
+  void visitBlock(const Stmt::Block *) override;
+  void visitIfStmt(const Stmt::IfStmt *) override;
+  void visitWhileStmt(const Stmt::WhileStmt *) override;
+  void visitForStmt(const Stmt::ForStmt *) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *) override;
+  void visitReturnStmt(const Stmt::ReturnStmt *) override;
+  void visitClassStmt(const Stmt::ClassStmt *) override;
+
+  void visitBinary(const Expr::BinaryExpr *) override;
+  void visitLiteral(const Expr::LiteralExpr *) override;
+  void visitUnary(const Expr::UnaryExpr *) override;
+  void visitGrouping(const Expr::GroupingExpr *) override;
+  void visitTernary(const Expr::TernaryExpr *) override;
+  void visitVariable(const Expr::VariableExpr *) override;
+  void visitAssign(const Expr::AssignExpr *) override;
+  void visitLogic(const Expr::LogicExpr *) override;
+  void visitCall(const Expr::CallExpr *) override;
+  void visitGet(const Expr::GetExpr *) override;
+  void visitSet(const Expr::SetExpr *) override;
+  void visitThis(const Expr::ThisExpr *) override;
+  void visitSuper(const Expr::SuperExpr *) override;
+  void visitInline(const Expr::InlineExpr *) override;
+
+private:
+  // Target of expressions whose value is not used.
+  static constexpr int DISCARD = -1;
+
+  void compile(const Stmt::Stmt *);
+  void compile(const Expr::Expr *, int target);
+  // The register holding the value of an expression: the local it reads,
+  // or a new temporary it is compiled into.
+  int source(const Expr::Expr *);
+  // Like source, but copies locals that the expression evaluated after it
+  // may assign.
+  int operand(const Expr::Expr *, const Expr::Expr *after);
+  // The register the running expression writes its value to.
+  int target();
+  int allocate();
+  FunctionCode compileFunction(const Stmt::FunctionStmt *);
+
+  void emit(OpCode, size_t a = 0, size_t b = 0, size_t c = 0);
+  void emitAt(const Token &, OpCode, size_t a = 0, size_t b = 0, size_t c = 0);
+  void emitMove(int to, int from);
+  size_t emitJump(OpCode, size_t b = 0, size_t c = 0);
+  void patchJump(size_t);
+  void emitLoop(size_t start);
+  // Jumps if the condition is false, fusing comparisons into the jump.
+  size_t emitJumpIfFalse(const Expr::Expr *);
+
+  void emitDefine(const Local *, const Token &, const Expr::Expr *init);
+  void emitDeclared(const Local *, const Token &, OpCode, size_t index,
+                    size_t c = 0);
+  // Reads a local of the running function into a register.
+  void emitGet(int target, const Local &);
+
+  uint16_t operand(size_t, const Token &);
+  const Local *slotOf(const Expr::Expr *) const;
+
+  const Interpreter &_resolution;
+  Function *_function = nullptr;
+  int _target = DISCARD;
+  // The first free register.
+  int _next = 0;
+  bool _hadError = false;
+};
+
+} // namespace Register
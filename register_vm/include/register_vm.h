@@ -0,0 +1,62 @@
+#pragma once
+
+#include <environment.h>
+#include <frame.h>
+#include <heap.h>
+#include <interpreter.h>
+#include <register_code.h>
+#include <register_compiler.h>
+
+#include <memory>
+#include <vector>
+
+class LoxClass;
+
+namespace Register {
+
+// Runs register code. The registers of each call are a window into one
+// stack: the locals, laid out as the Resolver assigned their slots, then
+// the temporaries. A call's window starts at the register of its callee,
+// so the arguments already sit where the parameters go.
+class VM : public RootSource {
+public:
+  VM();
+  ~VM();
+
+  // Compiles and runs resolved top level code. The Interpreter that
+  // resolved it provides the layout of its variables.
+  void interpret(const std::vector<Stmt::Stmt *> &, const Interpreter &);
+
+  void markRoots(Heap &) override;
+
+private:
+  static constexpr size_t STACK_SLOTS = 64 * 1024;
+  static constexpr size_t MAX_FRAMES = 16 * 1024;
+
+  struct CallFrame {
+    const Function *function;
+    const Instruction *ip;
+    Frame frame;
+    // Keeps the running function, and with it its upvalues, alive.
+    LoxType callee;
+    // The register the result goes to, the one the callee was called from.
+    LoxType *result;
+    // Initializers return their instance, which sits in the first slot.
+    bool initializer;
+  };
+
+  void run();
+  void call(LoxType *callee, size_t argc, const Token &);
+  void callFunction(const LoxFunction *, const LoxType &receiver,
+                    LoxType *result, bool initializer);
+  void reset();
+
+  std::unique_ptr<LoxType[]> _stack;
+  std::unique_ptr<Upvalue *[]> _cells;
+  // The end of the running frame's registers.
+  LoxType *_top;
+  std::vector<CallFrame> _frames;
+  std::shared_ptr<Environment> _globals;
+};
+
+} // namespace Register
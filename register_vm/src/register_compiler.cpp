@@ -0,0 +1,610 @@
+#include <register_compiler.h>
+#include <lox.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace Register {
+
+namespace {
+
+// Finds assignments to locals. Operands that read a local directly from
+// its register must not be overwritten before they are used.
+class Assignments : public Expr::ExprVisitor {
+public:
+  static bool in(const Expr::Expr *expr) {
+    Assignments finder;
+    expr->accept(&finder);
+    return finder._found;
+  }
+
+  void visitBinary(const Expr::BinaryExpr *expr) override {
+    expr->left()->accept(this);
+    expr->right()->accept(this);
+  }
+  void visitLiteral(const Expr::LiteralExpr *) override {}
+  void visitUnary(const Expr::UnaryExpr *expr) override {
+    expr->right()->accept(this);
+  }
+  void visitGrouping(const Expr::GroupingExpr *expr) override {
+    expr->expr()->accept(this);
+  }
+  void visitTernary(const Expr::TernaryExpr *expr) override {
+    expr->condition()->accept(this);
+    expr->first()->accept(this);
+    expr->second()->accept(this);
+  }
+  void visitVariable(const Expr::VariableExpr *) override {}
+  void visitAssign(const Expr::AssignExpr *) override { _found = true; }
+  void visitLogic(const Expr::LogicExpr *expr) override {
+    expr->first()->accept(this);
+    expr->second()->accept(this);
+  }
+  void visitCall(const Expr::CallExpr *expr) override {
+    expr->callee()->accept(this);
+    for (const Expr::Expr *arg : expr->arguments())
+      arg->accept(this);
+  }
+  void visitGet(const Expr::GetExpr *expr) override {
+    expr->object()->accept(this);
+  }
+  void visitSet(const Expr::SetExpr *expr) override {
+    expr->object()->accept(this);
+    expr->value()->accept(this);
+  }
+  void visitThis(const Expr::ThisExpr *) override {}
+  void visitSuper(const Expr::SuperExpr *) override {}
+  void visitInline(const Expr::InlineExpr *expr) override {
+    visitCall(expr->call());
+  }
+
+private:
+  bool _found = false;
+};
+
+const Expr::Expr *ungroup(const Expr::Expr *expr) {
+  while (auto grouping = dynamic_cast<const Expr::GroupingExpr *>(expr))
+    expr = grouping->expr();
+  return expr;
+}
+
+// Logic and ternary expressions write their target before they are done
+// reading, so they must not be compiled straight into a local they read.
+bool writesLast(const Expr::Expr *expr) {
+  expr = ungroup(expr);
+  return dynamic_cast<const Expr::LogicExpr *>(expr) == nullptr &&
+         dynamic_cast<const Expr::TernaryExpr *>(expr) == nullptr;
+}
+
+const Expr::LiteralExpr *literal(const Expr::Expr *expr) {
+  return dynamic_cast<const Expr::LiteralExpr *>(ungroup(expr));
+}
+
+} // namespace
+
+std::unique_ptr<Function> Compiler::compile(
+    const std::vector<Stmt::Stmt *> &statements) {
+  auto script = std::make_unique<Function>();
+  script->info = _resolution.script();
+  script->registers = script->info.slots;
+  _function = script.get();
+  _next = script->info.slots;
+  _hadError = false;
+
+  for (const Stmt::Stmt *statement : statements)
+    compile(statement);
+  emit(OP_RETURN_NIL);
+
+  if (_hadError)
+    return nullptr;
+  return script;
+}
+
+void Compiler::visitExprStmt(const Stmt::ExprStmt *stmt) {
+  compile(stmt->expr(), DISCARD);
+}
+
+void Compiler::visitPrintStmt(const Stmt::PrintStmt *stmt) {
+  emit(OP_PRINT, source(stmt->expr()));
+}
+
+void Compiler::visitVarStmt(const Stmt::VarStmt *stmt) {
+  emitDefine(stmt->local(), stmt->name(), stmt->init());
+}
+
+void Compiler::visitBlock(const Stmt::Block *block) {
+  for (const Stmt::Stmt *statement : block->statements())
+    compile(statement);
+}
+
+void Compiler::visitIfStmt(const Stmt::IfStmt *stmt) {
+  size_t elseJump = emitJumpIfFalse(stmt->condition());
+  compile(stmt->thenBranch());
+
+  if (stmt->elseBranch() == nullptr) {
+    patchJump(elseJump);
+    return;
+  }
+
+  size_t endJump = emitJump(OP_JUMP);
+  patchJump(elseJump);
+  compile(stmt->elseBranch());
+  patchJump(endJump);
+}
+
+void Compiler::visitWhileStmt(const Stmt::WhileStmt *stmt) {
+  size_t start = _function->code.size();
+  size_t exitJump = emitJumpIfFalse(stmt->condition());
+  compile(stmt->body());
+  emitLoop(start);
+  patchJump(exitJump);
+}
+
+void Compiler::visitForStmt(const Stmt::ForStmt *stmt) {
+  if (stmt->init() != nullptr)
+    compile(stmt->init());
+
+  size_t start = _function->code.size();
+  size_t exitJump = 0;
+  if (stmt->condition() != nullptr)
+    exitJump = emitJumpIfFalse(stmt->condition());
+
+  compile(stmt->body());
+  if (stmt->after() != nullptr) {
+    int mark = _next;
+    compile(stmt->after(), DISCARD);
+    _next = mark;
+  }
+  emitLoop(start);
+
+  if (stmt->condition() != nullptr)
+    patchJump(exitJump);
+}
+
+void Compiler::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  _function->functions.push_back(compileFunction(stmt));
+  emitDeclared(stmt->local(), stmt->name(), OP_CLOSURE,
+               _function->functions.size() - 1);
+}
+
+void Compiler::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
+  if (stmt->expr() != nullptr)
+    emit(OP_RETURN, source(stmt->expr()));
+  else
+    emit(OP_RETURN_NIL);
+}
+
+void Compiler::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  ClassInfo info{stmt->name().lexeme(), {}, std::nullopt};
+  // The methods of a subclass capture super, which is defined first.
+  int superclass = 0;
+  if (stmt->superclass() != nullptr) {
+    compile(stmt->superDeclaration());
+    superclass = source(stmt->superclass());
+    info.superclass = stmt->superclass()->name();
+  }
+
+  for (const Stmt::FunctionStmt *method : stmt->methods())
+    info.methods.push_back(compileFunction(method));
+
+  _function->classes.push_back(std::move(info));
+  emitDeclared(stmt->local(), stmt->name(), OP_CLASS,
+               _function->classes.size() - 1, superclass);
+}
+
+void Compiler::visitBinary(const Expr::BinaryExpr *expr) {
+  OpCode op, constantOp;
+  switch (expr->op().type()) {
+  case GREATER:
+    op = OP_GREATER, constantOp = OP_GREATERK;
+    break;
+  case GREATER_EQUAL:
+    op = OP_GREATER_EQUAL, constantOp = OP_GREATER_EQUALK;
+    break;
+  case LESS:
+    op = OP_LESS, constantOp = OP_LESSK;
+    break;
+  case LESS_EQUAL:
+    op = OP_LESS_EQUAL, constantOp = OP_LESS_EQUALK;
+    break;
+  case MINUS:
+    op = OP_SUBTRACT, constantOp = OP_SUBTRACTK;
+    break;
+  case PLUS:
+    op = OP_ADD, constantOp = OP_ADDK;
+    break;
+  case SLASH:
+    op = OP_DIVIDE, constantOp = OP_DIVIDEK;
+    break;
+  case STAR:
+    op = OP_MULTIPLY, constantOp = OP_MULTIPLYK;
+    break;
+  case BANG_EQUAL:
+    op = constantOp = OP_NOT_EQUAL;
+    break;
+  case EQUAL_EQUAL:
+    op = constantOp = OP_EQUAL;
+    break;
+  default:
+    Lox::error(expr->op().line(), "Invalid operator for binary expression");
+    _hadError = true;
+    return;
+  }
+
+  int left = operand(expr->left(), expr->right());
+  const Expr::LiteralExpr *constant = literal(expr->right());
+  if (constant != nullptr && constantOp != op) {
+    emitAt(expr->op(), constantOp, target(), left,
+           _function->addConstant(constant->value()));
+    return;
+  }
+
+  int right = source(expr->right());
+  emitAt(expr->op(), op, target(), left, right);
+}
+
+void Compiler::visitLiteral(const Expr::LiteralExpr *expr) {
+  emit(OP_LOADK, target(), _function->addConstant(expr->value()));
+}
+
+void Compiler::visitUnary(const Expr::UnaryExpr *expr) {
+  int operand = source(expr->right());
+
+  switch (expr->op().type()) {
+  case MINUS:
+    emit(OP_NEGATE, target(), operand);
+    break;
+  case BANG:
+    emit(OP_NOT, target(), operand);
+    break;
+  default:
+    Lox::error(expr->op().line(), "Invalid operator to Unary expression");
+    _hadError = true;
+  }
+}
+
+void Compiler::visitGrouping(const Expr::GroupingExpr *expr) {
+  compile(expr->expr(), _target);
+}
+
+void Compiler::visitTernary(const Expr::TernaryExpr *expr) {
+  size_t elseJump = emitJumpIfFalse(expr->condition());
+  int result = target();
+  compile(expr->first(), result);
+  size_t endJump = emitJump(OP_JUMP);
+  patchJump(elseJump);
+  compile(expr->second(), result);
+  patchJump(endJump);
+}
+
+void Compiler::visitVariable(const Expr::VariableExpr *expr) {
+  const Local *local = expr->local();
+  if (local == nullptr) {
+    emit(OP_GET_GLOBAL, target(), _function->addToken(expr->name()));
+    return;
+  }
+
+  emitGet(target(), *local);
+}
+
+void Compiler::visitAssign(const Expr::AssignExpr *expr) {
+  const Local *local = expr->local();
+
+  if (local != nullptr && local->type == Local::SLOT && writesLast(expr->value())) {
+    compile(expr->value(), local->index);
+    if (_target != DISCARD)
+      emitMove(_target, local->index);
+    return;
+  }
+
+  int value = source(expr->value());
+  if (local == nullptr) {
+    emit(OP_SET_GLOBAL, _function->addToken(expr->name()), value);
+  } else {
+    switch (local->type) {
+    case Local::SLOT:
+      emitMove(local->index, value);
+      break;
+    case Local::CELL:
+      emit(OP_SET_CELL, local->index, value);
+      break;
+    case Local::UPVALUE:
+      emit(OP_SET_UPVALUE, local->index, value);
+      break;
+    }
+  }
+
+  if (_target != DISCARD)
+    emitMove(_target, value);
+}
+
+// Both operators produce a bool rather than one of their operands.
+void Compiler::visitLogic(const Expr::LogicExpr *expr) {
+  int result = target();
+  compile(expr->first(), result);
+  emit(OP_TRUTH, result, result);
+  size_t endJump = emitJump(
+      expr->op().type() == OR ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE, result);
+  compile(expr->second(), result);
+  emit(OP_TRUTH, result, result);
+  patchJump(endJump);
+}
+
+// The callee and its arguments go into consecutive registers above every
+// live one, where the callee's frame starts. A temporary that was just
+// allocated for the result holds nothing yet, and starts the window.
+void Compiler::visitCall(const Expr::CallExpr *expr) {
+  bool inPlace = _target != DISCARD && _target == _next - 1 &&
+                 _target >= _function->info.slots;
+  int base = inPlace ? _target : _next;
+
+  _next = base;
+  compile(expr->callee(), allocate());
+  for (const Expr::Expr *arg : expr->arguments())
+    compile(arg, allocate());
+
+  emitAt(expr->paren(), OP_CALL, base, expr->arguments().size());
+  _next = inPlace ? base + 1 : base;
+  if (!inPlace && _target != DISCARD)
+    emitMove(_target, base);
+}
+
+void Compiler::visitGet(const Expr::GetExpr *expr) {
+  int object = source(expr->object());
+  emit(OP_GET_PROPERTY, target(), object, _function->addToken(expr->name()));
+}
+
+void Compiler::visitSet(const Expr::SetExpr *expr) {
+  int object = operand(expr->object(), expr->value());
+  int value = source(expr->value());
+  emit(OP_SET_PROPERTY, object, _function->addToken(expr->name()), value);
+  if (_target != DISCARD)
+    emitMove(_target, value);
+}
+
+void Compiler::visitThis(const Expr::ThisExpr *expr) {
+  emitGet(target(), *expr->local());
+}
+
+void Compiler::visitSuper(const Expr::SuperExpr *expr) {
+  int result = target();
+  compile(expr->self(), result);
+  int superclass = allocate();
+  emitGet(superclass, *expr->local());
+  emit(OP_GET_SUPER, result, superclass, _function->addToken(expr->method()));
+}
+
+// Only the tree walker runs inlined bodies, the call is compiled instead.
+void Compiler::visitInline(const Expr::InlineExpr *expr) {
+  visitCall(expr->call());
+}
+
+// Temporaries of a statement are free once it is done.
+void Compiler::compile(const Stmt::Stmt *stmt) {
+  int mark = _next;
+  stmt->accept(this);
+  _next = mark;
+}
+
+// Temporaries of an expression are free once its value is in the target.
+void Compiler::compile(const Expr::Expr *expr, int target) {
+  int enclosing = _target;
+  int mark = _next;
+  _target = target;
+  expr->accept(this);
+  _target = enclosing;
+  _next = mark;
+}
+
+int Compiler::source(const Expr::Expr *expr) {
+  if (const Local *local = slotOf(expr))
+    return local->index;
+
+  int result = allocate();
+  compile(expr, result);
+  return result;
+}
+
+int Compiler::operand(const Expr::Expr *expr, const Expr::Expr *after) {
+  if (slotOf(expr) != nullptr && Assignments::in(after)) {
+    int copy = allocate();
+    compile(expr, copy);
+    return copy;
+  }
+
+  return source(expr);
+}
+
+int Compiler::target() {
+  if (_target == DISCARD)
+    _target = allocate();
+  return _target;
+}
+
+int Compiler::allocate() {
+  int result = _next++;
+  _function->registers = std::max(_function->registers, _next);
+  return result;
+}
+
+FunctionCode Compiler::compileFunction(const Stmt::FunctionStmt *stmt) {
+  auto function = std::make_shared<Function>();
+  function->declaration = stmt;
+  function->info = stmt->info();
+  function->registers = function->info.slots;
+  function->name = stmt->name();
+
+  Function *enclosing = _function;
+  int next = _next;
+  _function = function.get();
+  _next = function->info.slots;
+
+  for (const Stmt::Stmt *statement : stmt->body())
+    compile(statement);
+  emit(OP_RETURN_NIL);
+
+  _function = enclosing;
+  _next = next;
+
+  return {stmt, &function->info, function};
+}
+
+void Compiler::emit(OpCode op, size_t a, size_t b, size_t c) {
+  const Token &name = _function->name;
+  _function->code.push_back(
+      {op, operand(a, name), operand(b, name), operand(c, name)});
+  _function->locations.push_back(Function::NO_TOKEN);
+}
+
+void Compiler::emitAt(const Token &token, OpCode op, size_t a, size_t b,
+                      size_t c) {
+  emit(op, a, b, c);
+  _function->locations.back() = _function->addToken(token);
+}
+
+void Compiler::emitMove(int to, int from) {
+  if (to != from)
+    emit(OP_MOVE, to, from);
+}
+
+size_t Compiler::emitJump(OpCode op, size_t b, size_t c) {
+  emit(op, 0, b, c);
+  return _function->code.size() - 1;
+}
+
+// Jumps are relative to the instruction after them.
+void Compiler::patchJump(size_t at) {
+  _function->code[at].a =
+      operand(_function->code.size() - at - 1, _function->name);
+}
+
+void Compiler::emitLoop(size_t start) {
+  emit(OP_LOOP, _function->code.size() + 1 - start);
+}
+
+size_t Compiler::emitJumpIfFalse(const Expr::Expr *condition) {
+  int mark = _next;
+  size_t jump;
+  auto comparison = dynamic_cast<const Expr::BinaryExpr *>(ungroup(condition));
+
+  OpCode op = OP_JUMP_IF_FALSE, constantOp = OP_JUMP_IF_FALSE;
+  if (comparison != nullptr) {
+    switch (comparison->op().type()) {
+    case LESS:
+      op = OP_JUMP_IF_NOT_LESS, constantOp = OP_JUMP_IF_NOT_LESSK;
+      break;
+    case LESS_EQUAL:
+      op = OP_JUMP_IF_NOT_LESS_EQUAL, constantOp = OP_JUMP_IF_NOT_LESS_EQUALK;
+      break;
+    case GREATER:
+      op = OP_JUMP_IF_NOT_GREATER, constantOp = OP_JUMP_IF_NOT_GREATERK;
+      break;
+    case GREATER_EQUAL:
+      op = OP_JUMP_IF_NOT_GREATER_EQUAL,
+      constantOp = OP_JUMP_IF_NOT_GREATER_EQUALK;
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (op == OP_JUMP_IF_FALSE) {
+    jump = emitJump(OP_JUMP_IF_FALSE, source(condition));
+  } else {
+    int left = operand(comparison->left(), comparison->right());
+    if (const Expr::LiteralExpr *constant = literal(comparison->right()))
+      jump = emitJump(constantOp, left, _function->addConstant(constant->value()));
+    else
+      jump = emitJump(op, left, source(comparison->right()));
+    _function->locations.back() = _function->addToken(comparison->op());
+  }
+
+  _next = mark;
+  return jump;
+}
+
+void Compiler::emitDefine(const Local *local, const Token &name,
+                          const Expr::Expr *init) {
+  if (local != nullptr && local->type == Local::SLOT) {
+    if (init != nullptr)
+      compile(init, local->index);
+    else
+      emit(OP_LOADK, local->index, _function->addConstant(LoxType()));
+    return;
+  }
+
+  int value;
+  if (init != nullptr) {
+    value = source(init);
+  } else {
+    value = allocate();
+    emit(OP_LOADK, value, _function->addConstant(LoxType()));
+  }
+
+  if (local == nullptr) {
+    emit(OP_DEFINE_GLOBAL, _function->addToken(name), value);
+  } else {
+    _function->info.hasCells = true;
+    emit(OP_NEW_CELL, local->index, value);
+  }
+}
+
+// Functions and classes may capture themselves, so captured ones get their
+// cell before they are created.
+void Compiler::emitDeclared(const Local *local, const Token &name, OpCode op,
+                            size_t index, size_t c) {
+  if (local != nullptr && local->type == Local::SLOT) {
+    emit(op, local->index, index, c);
+    return;
+  }
+
+  if (local != nullptr) {
+    _function->info.hasCells = true;
+    emit(OP_EMPTY_CELL, local->index);
+  }
+
+  int value = allocate();
+  emit(op, value, index, c);
+
+  if (local == nullptr)
+    emit(OP_DEFINE_GLOBAL, _function->addToken(name), value);
+  else
+    emit(OP_SET_CELL, local->index, value);
+}
+
+void Compiler::emitGet(int target, const Local &local) {
+  switch (local.type) {
+  case Local::SLOT:
+    emitMove(target, local.index);
+    break;
+  case Local::CELL:
+    emit(OP_GET_CELL, target, local.index);
+    break;
+  case Local::UPVALUE:
+    emit(OP_GET_UPVALUE, target, local.index);
+    break;
+  }
+}
+
+uint16_t Compiler::operand(size_t value, const Token &where) {
+  if (value > std::numeric_limits<uint16_t>::max()) {
+    Lox::error(where.line(), "Too much code or data in one function.");
+    _hadError = true;
+    return 0;
+  }
+
+  return value;
+}
+
+const Local *Compiler::slotOf(const Expr::Expr *expr) const {
+  expr = ungroup(expr);
+  const Local *local = nullptr;
+  if (auto variable = dynamic_cast<const Expr::VariableExpr *>(expr))
+    local = variable->local();
+  else if (auto keyword = dynamic_cast<const Expr::ThisExpr *>(expr))
+    local = keyword->local();
+
+  return local != nullptr && local->type == Local::SLOT ? local : nullptr;
+}
+
+} // namespace Register
@@ -0,0 +1,418 @@
+#include <register_vm.h>
+#include <callables.h>
+#include <lox.h>
+#include <lox_class.h>
+#include <lox_function.h>
+#include <lox_instance.h>
+#include <native_func.h>
+#include <runtime_error.h>
+#include <upvalue.h>
+
+#include <algorithm>
+#include <iostream>
+
+// Dispatch jumps straight from one instruction's handler to the next one's
+// through a table of label addresses where the compiler supports it, and
+// goes through a switch elsewhere.
+#if LOX_THREADED_DISPATCH && defined(__GNUC__)
+#define THREADED_DISPATCH 1
+#else
+#define THREADED_DISPATCH 0
+#endif
+
+namespace Register {
+
+VM::VM()
+    : _stack(new LoxType[STACK_SLOTS]), _cells(new Upvalue *[STACK_SLOTS]()),
+      _top(_stack.get()) {
+  _frames.reserve(MAX_FRAMES);
+  Heap::instance().addRootSource(this);
+
+  _globals = std::make_shared<Environment>();
+  _globals->define("clock", LoxType(Heap::instance().make<Clock>()));
+}
+
+VM::~VM() { Heap::instance().removeRootSource(this); }
+
+void VM::interpret(const std::vector<Stmt::Stmt *> &statements,
+                   const Interpreter &resolution) {
+  Compiler compiler(resolution);
+  std::unique_ptr<Function> script = compiler.compile(statements);
+  if (script == nullptr)
+    return;
+
+  try {
+    LoxType *base = _stack.get();
+    if (script->registers > (int)STACK_SLOTS)
+      throw RuntimeError(script->name, "Stack overflow.");
+
+    _top = base + script->registers;
+    std::fill(base, _top, LoxType());
+    _frames.push_back({script.get(), script->code.data(),
+                       Frame{base, _cells.get()}, LoxType(), nullptr, false});
+
+    run();
+  } catch (const RuntimeError &err) {
+    Lox::runtime_error(err);
+    reset();
+  }
+}
+
+void VM::run() {
+  Heap &heap = Heap::instance();
+  CallFrame *frame;
+  const Function *function;
+  const Instruction *ip;
+  // The instruction being executed.
+  const Instruction *in;
+  LoxType *R;
+  const LoxType *K;
+
+  auto reload = [&]() {
+    frame = &_frames.back();
+    function = frame->function;
+    ip = frame->ip;
+    R = frame->frame.slots;
+    K = function->constants.data();
+  };
+  auto error = [&](const char *message) {
+    throw RuntimeError(function->tokenAt(in), message);
+  };
+
+  reload();
+
+#if THREADED_DISPATCH
+  static const void *const labels[] = {
+#define REGISTER_OPCODE_LABEL(name) &&do_##name,
+      REGISTER_OPCODES(REGISTER_OPCODE_LABEL)
+#undef REGISTER_OPCODE_LABEL
+  };
+#define TARGET(name) do_##name
+#define DISPATCH() goto *labels[(in = ip++)->op]
+  DISPATCH();
+#else
+#define TARGET(name) case OP_##name
+#define DISPATCH() break
+  while (true) {
+    switch ((in = ip++)->op) {
+#endif
+
+// Binary operators check their right operand first, like the tree walker.
+#define NUMBER_OPERATION(op, right)                                            \
+  {                                                                            \
+    const LoxType &value = right;                                              \
+    if (!value.isType<double>())                                               \
+      error("Operand must be a number.");                                      \
+    R[in->a] = R[in->b].getValue<double>() op value.getValue<double>();        \
+    DISPATCH();                                                                \
+  }
+#define ADD(right)                                                             \
+  {                                                                            \
+    const LoxType &left = R[in->b], &value = right;                            \
+    if (left.isType<double>() && value.isType<double>())                       \
+      R[in->a] = left.getValue<double>() + value.getValue<double>();           \
+    else if (left.isType<std::string>() && value.isType<std::string>())        \
+      R[in->a] = LoxType::concat(left, value);                                 \
+    else                                                                       \
+      error("Operands must both be numbers or strings");                       \
+    DISPATCH();                                                                \
+  }
+#define MULTIPLY(right)                                                        \
+  {                                                                            \
+    R[in->a] = R[in->b].getValue<double>() * (right).getValue<double>();       \
+    DISPATCH();                                                                \
+  }
+#define DIVIDE(right)                                                          \
+  {                                                                            \
+    const LoxType &value = right;                                              \
+    if (value.getValue<double>() == 0)                                         \
+      error("Division by Zero");                                               \
+    R[in->a] = R[in->b].getValue<double>() / value.getValue<double>();         \
+    DISPATCH();                                                                \
+  }
+#define JUMP_UNLESS(op, right)                                                 \
+  {                                                                            \
+    const LoxType &value = right;                                              \
+    if (!value.isType<double>())                                               \
+      error("Operand must be a number.");                                      \
+    if (!(R[in->b].getValue<double>() op value.getValue<double>()))            \
+      ip += in->a;                                                             \
+    DISPATCH();                                                                \
+  }
+
+  TARGET(MOVE):
+    R[in->a] = R[in->b];
+    DISPATCH();
+  TARGET(LOADK):
+    R[in->a] = K[in->b];
+    DISPATCH();
+
+  TARGET(GET_CELL):
+    R[in->a] = frame->frame.cells[in->b]->get();
+    DISPATCH();
+  TARGET(SET_CELL):
+    frame->frame.cells[in->a]->set(R[in->b]);
+    DISPATCH();
+  TARGET(NEW_CELL):
+    frame->frame.cells[in->a] = heap.make<Upvalue>(R[in->b]);
+    DISPATCH();
+  TARGET(EMPTY_CELL):
+    frame->frame.cells[in->a] = heap.make<Upvalue>();
+    DISPATCH();
+  TARGET(GET_UPVALUE):
+    R[in->a] = frame->frame.upvalues[in->b]->get();
+    DISPATCH();
+  TARGET(SET_UPVALUE):
+    frame->frame.upvalues[in->a]->set(R[in->b]);
+    DISPATCH();
+
+  // Globals are looked up once per instruction. A variable that is not
+  // defined yet, or holds nil, takes the slow path to report it.
+  TARGET(GET_GLOBAL): {
+    LoxType *&global = function->globals[in->b];
+    if (global == nullptr)
+      global = _globals->find(function->tokens[in->b].symbol());
+    if (global == nullptr || global->empty())
+      R[in->a] = _globals->get(function->tokens[in->b]);
+    else
+      R[in->a] = *global;
+    DISPATCH();
+  }
+  TARGET(SET_GLOBAL): {
+    LoxType *&global = function->globals[in->a];
+    if (global == nullptr)
+      global = _globals->find(function->tokens[in->a].symbol());
+    if (global == nullptr)
+      _globals->assign(function->tokens[in->a], R[in->b]);
+    else
+      _globals->store(*global, R[in->b]);
+    DISPATCH();
+  }
+  TARGET(DEFINE_GLOBAL):
+    _globals->define(function->tokens[in->a].symbol(), R[in->b]);
+    DISPATCH();
+
+  TARGET(GET_PROPERTY): {
+    const Token &name = function->tokens[in->c];
+    if (!R[in->b].isType<LoxInstance *>())
+      throw RuntimeError(name, "Cannot get property of non-instance.");
+    R[in->a] = R[in->b].getValue<LoxInstance *>()->get(name);
+    DISPATCH();
+  }
+  TARGET(SET_PROPERTY): {
+    const Token &name = function->tokens[in->b];
+    if (!R[in->a].isType<LoxInstance *>())
+      throw RuntimeError(name, "Cannot set property of non-instance.");
+    R[in->a].getValue<LoxInstance *>()->set(name, R[in->c]);
+    DISPATCH();
+  }
+  TARGET(GET_SUPER): {
+    LoxFunction *method =
+        R[in->b].getValue<LoxClass *>()->superMethod(function->tokens[in->c]);
+    R[in->a] = method->bind(R[in->a].getValue<LoxInstance *>());
+    DISPATCH();
+  }
+
+  TARGET(ADD): ADD(R[in->c])
+  TARGET(ADDK): ADD(K[in->c])
+  TARGET(SUBTRACT): NUMBER_OPERATION(-, R[in->c])
+  TARGET(SUBTRACTK): NUMBER_OPERATION(-, K[in->c])
+  TARGET(MULTIPLY): MULTIPLY(R[in->c])
+  TARGET(MULTIPLYK): MULTIPLY(K[in->c])
+  TARGET(DIVIDE): DIVIDE(R[in->c])
+  TARGET(DIVIDEK): DIVIDE(K[in->c])
+  TARGET(LESS): NUMBER_OPERATION(<, R[in->c])
+  TARGET(LESSK): NUMBER_OPERATION(<, K[in->c])
+  TARGET(LESS_EQUAL): NUMBER_OPERATION(<=, R[in->c])
+  TARGET(LESS_EQUALK): NUMBER_OPERATION(<=, K[in->c])
+  TARGET(GREATER): NUMBER_OPERATION(>, R[in->c])
+  TARGET(GREATERK): NUMBER_OPERATION(>, K[in->c])
+  TARGET(GREATER_EQUAL): NUMBER_OPERATION(>=, R[in->c])
+  TARGET(GREATER_EQUALK): NUMBER_OPERATION(>=, K[in->c])
+  TARGET(EQUAL):
+    R[in->a] = R[in->b] == R[in->c];
+    DISPATCH();
+  TARGET(NOT_EQUAL):
+    R[in->a] = !(R[in->b] == R[in->c]);
+    DISPATCH();
+  TARGET(NOT):
+    R[in->a] = !Interpreter::isTruthyVal(R[in->b]);
+    DISPATCH();
+  TARGET(NEGATE):
+    R[in->a] = -R[in->b].getValue<double>();
+    DISPATCH();
+  TARGET(TRUTH):
+    R[in->a] = Interpreter::isTruthyVal(R[in->b]);
+    DISPATCH();
+
+  TARGET(JUMP):
+    ip += in->a;
+    DISPATCH();
+  TARGET(JUMP_IF_FALSE):
+    if (!Interpreter::isTruthyVal(R[in->b]))
+      ip += in->a;
+    DISPATCH();
+  TARGET(JUMP_IF_TRUE):
+    if (Interpreter::isTruthyVal(R[in->b]))
+      ip += in->a;
+    DISPATCH();
+  TARGET(JUMP_IF_NOT_LESS): JUMP_UNLESS(<, R[in->c])
+  TARGET(JUMP_IF_NOT_LESSK): JUMP_UNLESS(<, K[in->c])
+  TARGET(JUMP_IF_NOT_LESS_EQUAL): JUMP_UNLESS(<=, R[in->c])
+  TARGET(JUMP_IF_NOT_LESS_EQUALK): JUMP_UNLESS(<=, K[in->c])
+  TARGET(JUMP_IF_NOT_GREATER): JUMP_UNLESS(>, R[in->c])
+  TARGET(JUMP_IF_NOT_GREATERK): JUMP_UNLESS(>, K[in->c])
+  TARGET(JUMP_IF_NOT_GREATER_EQUAL): JUMP_UNLESS(>=, R[in->c])
+  TARGET(JUMP_IF_NOT_GREATER_EQUALK): JUMP_UNLESS(>=, K[in->c])
+  // Backward jumps and calls are the collector's safepoints, every value
+  // is in a register there.
+  TARGET(LOOP):
+    ip -= in->a;
+    if (heap.shouldCollect()) {
+      frame->ip = ip;
+      heap.collect();
+    }
+    DISPATCH();
+
+  TARGET(PRINT):
+    std::cout << R[in->a] << std::endl;
+    DISPATCH();
+
+  TARGET(CALL):
+    frame->ip = ip;
+    if (heap.shouldCollect())
+      heap.collect();
+
+    call(R + in->a, in->b, function->tokenAt(in));
+    reload();
+    DISPATCH();
+  TARGET(CLOSURE): {
+    R[in->a] = makeFunction(function->functions[in->b], frame->frame);
+    DISPATCH();
+  }
+  TARGET(CLASS): {
+    const ClassInfo &info = function->classes[in->b];
+    LoxClass *superclass = nullptr;
+    if (info.superclass)
+      superclass = superclassOf(R[in->c], *info.superclass);
+    R[in->a] = makeClass(info.name, superclass, info.methods, frame->frame);
+    DISPATCH();
+  }
+
+  TARGET(RETURN_NIL):
+  TARGET(RETURN): {
+    LoxType result;
+    if (frame->initializer)
+      result = R[0];
+    else if (in->op == OP_RETURN)
+      result = R[in->a];
+
+    if (function->info.hasCells)
+      std::fill(frame->frame.cells, frame->frame.cells + function->info.slots,
+                nullptr);
+
+    LoxType *destination = frame->result;
+    _frames.pop_back();
+    if (_frames.empty()) {
+      reset();
+      return;
+    }
+
+    *destination = std::move(result);
+    reload();
+    _top = R + function->registers;
+    DISPATCH();
+  }
+
+#if !THREADED_DISPATCH
+    }
+  }
+#endif
+
+#undef NUMBER_OPERATION
+#undef ADD
+#undef MULTIPLY
+#undef DIVIDE
+#undef JUMP_UNLESS
+#undef TARGET
+#undef DISPATCH
+}
+
+// Calls the value in a register with the arguments in the registers after
+// it. That register receives the result.
+void VM::call(LoxType *callee, size_t argc, const Token &paren) {
+  CallCache::Entry target = callTarget(*callee, paren);
+  checkArity(target.arity, argc, paren);
+
+  if (target.kind == CallCache::Kind::FUNCTION) {
+    callFunction(target.function, target.function->receiver(), callee, false);
+  } else if (target.kind == CallCache::Kind::CLASS) {
+    LoxType instance = Heap::instance().make<LoxInstance>(
+        static_cast<LoxClass *>(target.callable));
+
+    if (target.function != nullptr)
+      callFunction(target.function, instance, callee, true);
+    else
+      *callee = instance;
+  } else {
+    // Native functions do not use the interpreter.
+    *callee =
+        target.callable->call(nullptr, std::span<const LoxType>(callee + 1, argc));
+  }
+}
+
+// Pushes the frame of a call. The arguments already sit in the registers of
+// the parameters, after the callee's register, which methods use for
+// `this`.
+void VM::callFunction(const LoxFunction *function, const LoxType &receiver,
+                      LoxType *result, bool initializer) {
+  const Function *compiled = static_cast<const Function *>(function->compiled());
+  const FunctionInfo &info = compiled->info;
+  LoxType *base = info.method ? result : result + 1;
+
+  if (_frames.size() == MAX_FRAMES ||
+      base + compiled->registers > _stack.get() + STACK_SLOTS)
+    throw RuntimeError(compiled->name, "Stack overflow.");
+
+  // The callee keeps the upvalues alive, methods overwrite it with their
+  // receiver.
+  LoxType callee = *result;
+  if (info.method)
+    base[0] = receiver;
+
+  _top = base + compiled->registers;
+  std::fill(base + info.params.size(), _top, LoxType());
+
+  Frame frame{base, _cells.get() + (base - _stack.get()), function->upvalues()};
+  if (info.hasCells) {
+    for (size_t i = 0; i < info.params.size(); i++) {
+      if (info.params[i].type == Local::CELL)
+        frame.cells[i] = Heap::instance().make<Upvalue>(base[i]);
+    }
+  }
+
+  _frames.push_back({compiled, compiled->code.data(), frame, std::move(callee),
+                     result, initializer});
+}
+
+void VM::markRoots(Heap &heap) {
+  heap.mark(_globals.get());
+
+  for (LoxType *slot = _stack.get(); slot < _top; slot++)
+    heap.mark(*slot);
+  for (Upvalue **cell = _cells.get(); cell < _cells.get() + (_top - _stack.get()); cell++)
+    heap.mark(*cell);
+  for (CallFrame &frame : _frames)
+    heap.mark(frame.callee);
+}
+
+// Clears the stack once the script is done, or unwinds every call after a
+// runtime error.
+void VM::reset() {
+  std::fill(_stack.get(), _top, LoxType());
+  std::fill(_cells.get(), _cells.get() + (_top - _stack.get()), nullptr);
+  _top = _stack.get();
+  _frames.clear();
+}
+
+} // namespace Register
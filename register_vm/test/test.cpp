@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <interpreter.h>
+#include <parser.h>
+#include <register_code.h>
+#include <register_vm.h>
+#include <resolver.h>
+#include <tokenizer.h>
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace Register;
+
+namespace {
+
+// Runs source on a VM and returns what it printed, runtime errors
+// included.
+std::string run(const std::string &source) {
+  Tokenizer tokenizer{source};
+  Parser parser{tokenizer.getTokens()};
+  std::shared_ptr<CompilationUnit> unit = parser.parse();
+  Interpreter resolution;
+  Resolver(resolution).resolve(unit->statements());
+
+  std::stringstream output;
+  std::streambuf *previous = std::cout.rdbuf(output.rdbuf());
+  VM().interpret(unit->statements(), resolution);
+  std::cout.rdbuf(previous);
+  return output.str();
+}
+
+} // namespace
+
+TEST(FunctionTest, ConstantsAreShared) {
+  Function function;
+  size_t one = function.addConstant(LoxType(1.0));
+  size_t lox = function.addConstant(LoxType(std::string("lox")));
+
+  EXPECT_EQ(function.addConstant(LoxType(1.0)), one);
+  EXPECT_EQ(function.addConstant(LoxType(std::string("lox"))), lox);
+  EXPECT_EQ(function.addConstant(LoxType(true)), 2u);
+  EXPECT_NE(function.addConstant(LoxType()), function.addConstant(LoxType(false)));
+}
+
+TEST(FunctionTest, InstructionsReportTheirToken) {
+  Function function;
+  function.name = Token(IDENTIFIER, "f", LoxType(), 1);
+  Token plus(PLUS, "+", LoxType(), 2);
+
+  function.code.push_back({OP_LOADK, 0, 0, 0});
+  function.locations.push_back(Function::NO_TOKEN);
+  function.code.push_back({OP_ADD, 1, 0, 0});
+  function.locations.push_back(function.addToken(plus));
+
+  EXPECT_EQ(function.tokenAt(&function.code[0]).lexeme(), "f");
+  EXPECT_EQ(function.tokenAt(&function.code[1]).line(), 2u);
+  EXPECT_EQ(function.globals.size(), function.tokens.size());
+}
+
+TEST(FunctionTest, InstructionsAreCompact) {
+  EXPECT_EQ(sizeof(Instruction), 8u);
+}
+
+TEST(VMTest, NestedCallsKeepTheirTemporaries) {
+  // Each call's arguments sit in temporaries above the caller's, which
+  // the calls nested in them must not overwrite.
+  EXPECT_EQ(run("fun add(a, b) { return a + b; }\n"
+                "print add(1, add(2, add(3, 4))) * add(add(5, 6), 1);\n"),
+            "120.000000\n");
+  EXPECT_EQ(run("fun square(n) { return n * n; }\n"
+                "fun f(a, b) {\n"
+                "  var c = a + square(b);\n"
+                "  return a * 100 + b * 10 + c - square(a);\n"
+                "}\n"
+                "print f(2, 3);\n"),
+            "237.000000\n");
+  EXPECT_EQ(run("fun fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }\n"
+                "print fib(15);\n"),
+            "610.000000\n");
+}
+
+TEST(VMTest, ClosuresCaptureRegisters) {
+  // Parameters and locals live in registers until a closure captures them.
+  EXPECT_EQ(run("fun counter(n) {\n"
+                "  fun next() { n = n + 1; return n; }\n"
+                "  return next;\n"
+                "}\n"
+                "var a = counter(10);\n"
+                "var b = counter(0);\n"
+                "a(); a();\n"
+                "print a();\n"
+                "print b();\n"),
+            "13.000000\n1.000000\n");
+  EXPECT_EQ(run("fun f() {\n"
+                "  var x = 1;\n"
+                "  fun get() { return x; }\n"
+                "  x = 2;\n"
+                "  var y = get();\n"
+                "  fun set() { x = 3; }\n"
+                "  set();\n"
+                "  return y * 10 + x;\n"
+                "}\n"
+                "print f();\n"),
+            "23.000000\n");
+  EXPECT_EQ(run("var first = false;\n"
+                "var second = false;\n"
+                "for (var i = 0; i < 2; i = i + 1) {\n"
+                "  var j = i;\n"
+                "  fun get() { return j; }\n"
+                "  if (i == 0) first = get; else second = get;\n"
+                "}\n"
+                "print first();\n"
+                "print second();\n"),
+            "0.000000\n1.000000\n");
+}
+
+TEST(VMTest, RuntimeErrorsReportTheirLine) {
+  EXPECT_EQ(run("fun f(n) {\n"
+                "  return n - nil;\n"
+                "}\n"
+                "print f(1);\n"),
+            "Runtime Error. Operator - : Operand must be a number.\n"
+            "[line 2]\n");
+}
@@ -0,0 +1,25 @@
+# Types a Lox script at the interactive prompt, one line at a time, at
+# every optimization level. Each line is a compilation unit of its own.
+# What it prints has to match the expected output saved next to the script.
+#
+#   cmake -DLOX=<interpreter> -DFLAGS=<flags> -DSCRIPT=<script.lox> -P run_prompt.cmake
+
+get_filename_component(directory ${SCRIPT} DIRECTORY)
+get_filename_component(name ${SCRIPT} NAME_WE)
+file(READ ${directory}/${name}.out expected)
+
+foreach(level -O0 -O1)
+  execute_process(
+    COMMAND ${LOX} ${FLAGS} ${level}
+    INPUT_FILE ${SCRIPT}
+    OUTPUT_VARIABLE actual
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result
+  )
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${FLAGS} ${level} exited with ${result}:\n${actual}${errors}")
+  endif()
+  if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${FLAGS} ${level} printed:\n${actual}\nexpected:\n${expected}")
+  endif()
+endforeach()
@@ -0,0 +1,37 @@
+# Runs a Lox script on one engine at every optimization level. Its output
+# has to match the expected output saved next to the script, and what the
+# tree walker prints for the same script.
+#
+#   cmake -DLOX=<interpreter> -DENGINE=<engine> -DSCRIPT=<script.lox> -P run_script.cmake
+
+get_filename_component(directory ${SCRIPT} DIRECTORY)
+get_filename_component(name ${SCRIPT} NAME_WE)
+file(READ ${directory}/${name}.out expected)
+
+# Runs the script, with errors in the output as they are interleaved with it.
+function(run engine level output)
+  execute_process(
+    COMMAND ${LOX} --engine=${engine} ${level} ${SCRIPT}
+    OUTPUT_VARIABLE printed
+    ERROR_VARIABLE printed
+    RESULT_VARIABLE result
+  )
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "--engine=${engine} ${level} exited with ${result}:\n${printed}")
+  endif()
+  set(${output} "${printed}" PARENT_SCOPE)
+endfunction()
+
+foreach(level -O0 -O1)
+  run(${ENGINE} ${level} actual)
+  if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "--engine=${ENGINE} ${level} printed:\n${actual}\nexpected:\n${expected}")
+  endif()
+
+  if(NOT ENGINE STREQUAL "tree")
+    run(tree ${level} tree)
+    if(NOT actual STREQUAL tree)
+      message(FATAL_ERROR "--engine=${ENGINE} ${level} printed:\n${actual}\nthe tree walker:\n${tree}")
+    endif()
+  endif()
+endforeach()
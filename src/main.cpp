@@ -2,17 +2,73 @@
 #include <string>
 #include <lox.h>
 #include <expr.h>
+#include <heap.h>
 #include <printer_visitor.h>
 
+void usage() {
+  std::cout << "Usage: lox [--gc-stats] [--engine=tree|closure|vm|regvm] [-O0|-O1] [--inline-size=n] [--inline-depth=n] [--dump-ast] [--memoize[=n]] [script]" << std::endl;
+  exit(64);
+}
+
 int main (int argc, char *argv[]) {
-    if (argc > 2) {
-    std::cout << "Usage: lox [script]" << std::endl;
-    exit(64);
-  } else if (argc == 2) {
-    Lox::runFile(argv[1]);
+  std::string script;
+  bool gcStats = false;
+  Engine engine = TREE_WALKER;
+  int optimization = 1;
+  Optimizer::InlineLimits inlineLimits;
+  bool dumpAst = false;
+  size_t memoize = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "--gc-stats")
+      gcStats = true;
+    else if (arg == "--engine=tree")
+      engine = TREE_WALKER;
+    else if (arg == "--engine=closure")
+      engine = CLOSURES;
+    else if (arg == "--engine=vm")
+      engine = STACK_VM;
+    else if (arg == "--engine=regvm")
+      engine = REGISTER_VM;
+    else if (arg == "-O0")
+      optimization = 0;
+    else if (arg == "-O1")
+      optimization = 1;
+    else if (arg.starts_with("--inline-size="))
+      inlineLimits.size = std::stoul(arg.substr(arg.find('=') + 1));
+    else if (arg.starts_with("--inline-depth="))
+      inlineLimits.depth = std::stoi(arg.substr(arg.find('=') + 1));
+    else if (arg == "--dump-ast")
+      dumpAst = true;
+    else if (arg == "--memoize")
+      memoize = 65536;
+    else if (arg.starts_with("--memoize="))
+      memoize = std::stoul(arg.substr(arg.find('=') + 1));
+    else if (arg.starts_with("-") || !script.empty())
+      usage();
+    else
+      script = arg;
+  }
+
+  Heap::instance().setReportStats(gcStats);
+  Lox::setEngine(engine);
+  Lox::setOptimization(optimization);
+  Lox::setInlineLimits(inlineLimits);
+  Lox::setDumpAst(dumpAst);
+  Lox::setMemoize(memoize);
+
+  if (!script.empty()) {
+    Lox::runFile(script);
   } else {
     Lox::runPrompt();
   }
 
+  if (gcStats)
+    Heap::instance().reportStats(std::cerr);
+  if (memoize > 0)
+    Lox::reportMemoStats(std::cerr);
+
   return 0;
 }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <arena.h>
+#include <stmt.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Everything the parser produced for one script or REPL line. The nodes are
+// allocated from the unit's arena and released in one go once neither the
+// caller nor any function declared in the unit refers to it anymore.
+class CompilationUnit : public std::enable_shared_from_this<CompilationUnit> {
+public:
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    return _arena.make<T>(std::forward<Args>(args)...);
+  }
+
+  std::vector<Stmt::Stmt *> &statements() { return _statements; }
+  const std::vector<Stmt::Stmt *> &statements() const { return _statements; }
+
+private:
+  Arena _arena;
+  std::vector<Stmt::Stmt *> _statements;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "expression_visitor.h"
+#include "stmt_visitor.h"
+#include <token.h>
+
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Prints syntax trees as nested lists, one statement per line and the
+// statements of blocks and bodies indented below them.
+class PrinterVisitor : public Expr::ExprVisitor, public Stmt::StmtVisitor {
+public:
+  void visitBinary(const Expr::BinaryExpr* expr) override;
+
+  void visitLiteral(const Expr::LiteralExpr* expr) override;
+
+  void visitGrouping(const Expr::GroupingExpr* expr) override;
+
+  void visitUnary(const Expr::UnaryExpr* expr) override;
+
+  void visitTernary(const Expr::TernaryExpr* expr) override;
+
+  void visitVariable(const Expr::VariableExpr *expr) override;
+  void visitAssign(const Expr::AssignExpr *expr) override;
+  void visitLogic(const Expr::LogicExpr *expr) override;
+  void visitCall(const Expr::CallExpr *expr) override;
+  void visitGet(const Expr::GetExpr *expr) override;
+  void visitSet(const Expr::SetExpr *expr) override;
+  void visitThis(const Expr::ThisExpr *expr) override;
+  void visitSuper(const Expr::SuperExpr *expr) override;
+  void visitInline(const Expr::InlineExpr *expr) override;
+
+  void visitExprStmt(const Stmt::ExprStmt *stmt) override;
+  void visitPrintStmt(const Stmt::PrintStmt *stmt) override;
+  void visitVarStmt(const Stmt::VarStmt *stmt) override;
+  void visitBlock(const Stmt::Block *stmt) override;
+  void visitIfStmt(const Stmt::IfStmt *stmt) override;
+  void visitWhileStmt(const Stmt::WhileStmt *stmt) override;
+  void visitForStmt(const Stmt::ForStmt *stmt) override;
+  void visitFunctionStmt(const Stmt::FunctionStmt *stmt) override;
+  void visitReturnStmt(const Stmt::ReturnStmt *stmt) override;
+  void visitClassStmt(const Stmt::ClassStmt *stmt) override;
+
+  std::string print(const Expr::Expr *expr);
+  std::string print(const std::vector<Stmt::Stmt *> &statements);
+
+private:
+  void parenthesize(const std::string &name,
+                    const std::vector<const Expr::Expr*> &exprs);
+  // Prints a statement on a line of its own, one level deeper.
+  void nest(const Stmt::Stmt *stmt);
+  void function(const Stmt::FunctionStmt *stmt);
+
+  std::string getOutput();
+
+  std::stringstream _builder{};
+  int _depth = 0;
+};
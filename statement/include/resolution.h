@@ -0,0 +1,28 @@
+#pragma once
+
+#include <local.h>
+
+#include <memory>
+#include <vector>
+
+class Memo;
+
+// A variable a function captures when it is created: a cell of the frame
+// it is created in, or one of the creating function's own upvalues.
+struct Capture {
+  bool local;
+  int index;
+};
+
+// What the Resolver worked out about a function declaration.
+struct FunctionInfo {
+  // Slots needed by the frame, including those of nested blocks.
+  int slots = 0;
+  bool hasCells = false;
+  // Methods receive `this` as their first parameter.
+  bool method = false;
+  std::vector<Local> params;
+  std::vector<Capture> captures;
+  // The cache of a pure function whose calls are memoized.
+  std::shared_ptr<Memo> memo;
+};
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "expr.h"
+#include <resolution.h>
+
+#include <memory>
 #include <vector>
 
+class CompilationUnit;
+
 namespace Stmt {
 
 class StmtVisitor;
@@ -12,9 +17,26 @@ public:
   virtual void accept(StmtVisitor *) const = 0;
 };
 
+// A statement that declares a variable. The Resolver stores where the
+// variable lives in it, like it does in an Expr::Reference.
+class Declaration : public Stmt {
+public:
+  // nullptr for a global.
+  const Local *local() const { return _global ? nullptr : &_local; }
+  void resolve(Local local) const {
+    _local = local;
+    _global = false;
+  }
+  void resolveGlobal() const { _global = true; }
+
+private:
+  mutable Local _local{Local::SLOT, 0};
+  mutable bool _global = true;
+};
+
 class ExprStmt : public Stmt {
 public:
-  explicit ExprStmt(Expr::Expr *);
+  explicit ExprStmt(const Expr::Expr *);
 
   void accept(StmtVisitor *) const;
   const Expr::Expr *expr() const { return _expr; }
@@ -25,7 +47,7 @@ private:
 
 class PrintStmt : public Stmt {
 public:
-  explicit PrintStmt(Expr::Expr *);
+  explicit PrintStmt(const Expr::Expr *);
 
   void accept(StmtVisitor *) const;
   const Expr::Expr *expr() const { return _expr; }
@@ -34,9 +56,9 @@ private:
   const Expr::Expr *_expr;
 };
 
-class VarStmt : public Stmt {
+class VarStmt : public Declaration {
 public:
-  explicit VarStmt(Token name, Expr::Expr *init);
+  explicit VarStmt(Token name, const Expr::Expr *init);
 
   void accept(StmtVisitor *) const;
 
@@ -61,8 +83,8 @@ private:
 
 class IfStmt : public Stmt {
 public:
-  explicit IfStmt(Expr::Expr *, Stmt *);
-  explicit IfStmt(Expr::Expr *, Stmt *, Stmt *);
+  explicit IfStmt(const Expr::Expr *, const Stmt *);
+  explicit IfStmt(const Expr::Expr *, const Stmt *, const Stmt *);
   void accept(StmtVisitor *) const;
 
   const Expr::Expr *condition() const { return _condition; }
@@ -77,7 +99,7 @@ private:
 
 class WhileStmt : public Stmt {
 public:
-  explicit WhileStmt(Expr::Expr *, Stmt *);
+  explicit WhileStmt(const Expr::Expr *, const Stmt *);
 
   void accept(StmtVisitor *) const;
 
@@ -85,13 +107,14 @@ public:
   const Stmt *body() const { return _body; }
 
 private:
-  Expr::Expr *_condition;
-  Stmt *_body;
+  const Expr::Expr *_condition;
+  const Stmt *_body;
 };
 
 class ForStmt : public Stmt {
 public:
-  explicit ForStmt(Stmt *, Expr::Expr *, Expr::Expr *, Stmt *);
+  explicit ForStmt(const Stmt *, const Expr::Expr *, const Expr::Expr *,
+                   const Stmt *);
 
   void accept(StmtVisitor *) const;
 
@@ -101,55 +124,82 @@ public:
   const Stmt *body() const { return _body; }
 
 private:
-  Stmt *_init;
-  Expr::Expr *_condition;
-  Expr::Expr *_after;
-  Stmt *_body;
+  const Stmt *_init;
+  const Expr::Expr *_condition;
+  const Expr::Expr *_after;
+  const Stmt *_body;
 };
 
-class FunctionStmt : public Stmt {
+class FunctionStmt : public Declaration {
 public:
   explicit FunctionStmt(Token, std::vector<Token> &,
-                        std::vector<const Stmt *> &);
+                        std::vector<const Stmt *> &, CompilationUnit *);
 
   void accept(StmtVisitor *) const;
 
   const Token name() const { return _name; }
   const std::vector<Token> &params() const { return _params; }
   const std::vector<const Stmt *> &body() const { return _body; }
+  // The unit that owns this declaration, which functions created from it
+  // keep alive.
+  CompilationUnit *unit() const { return _unit; }
+
+  // What the Resolver worked out about the function.
+  const FunctionInfo &info() const { return _info; }
+  void resolveFunction(FunctionInfo info) const { _info = std::move(info); }
+  // Caches the results of its calls from now on, see Memo.
+  void memoize(std::shared_ptr<Memo> memo) const { _info.memo = std::move(memo); }
 
 private:
   Token _name;
   std::vector<Token> _params;
   std::vector<const Stmt *> _body;
+  CompilationUnit *_unit;
+  mutable FunctionInfo _info;
 };
 
 class ReturnStmt : public Stmt {
 public:
   ReturnStmt(Token ret) : _ret(ret), _expr(nullptr) {}
-  ReturnStmt(Token ret, Expr::Expr *expr) : _ret(ret), _expr(expr) {}
+  ReturnStmt(Token ret, const Expr::Expr *expr) : _ret(ret), _expr(expr) {}
 
   void accept(StmtVisitor *) const;
 
   const Expr::Expr *expr() const { return _expr; }
   const Token ret() const { return _ret; }
 
+  // Whether the returned call can run in the frame of the returning
+  // function, as the Resolver found.
+  bool tailCall() const { return _tailCall; }
+  void resolveTailCall(bool tailCall) const { _tailCall = tailCall; }
+
 private:
   Token _ret;
-  Expr::Expr *_expr;
+  const Expr::Expr *_expr;
+  mutable bool _tailCall = false;
 };
 
-class ClassStmt : public Stmt {
+class ClassStmt : public Declaration {
 public:
-  ClassStmt(Token name, std::vector<FunctionStmt*> methods) : _name(name), _methods(std::move(methods)) {}
+  ClassStmt(Token name, std::vector<const FunctionStmt *> methods) : _name(name), _methods(std::move(methods)) {}
+  // A subclass. The methods are declared in a scope of their own, where
+  // super is a local set to the superclass by superDeclaration.
+  ClassStmt(Token name, const VarStmt *superDeclaration,
+            std::vector<const FunctionStmt *> methods)
+      : _name(name), _superDeclaration(superDeclaration),
+        _methods(std::move(methods)) {}
 
   void accept(StmtVisitor*) const;
 
   const Token name() const { return _name; }
-  const std::vector<FunctionStmt*> methods() const { return _methods; }
+  // The variable naming the superclass, or nullptr.
+  const Expr::VariableExpr *superclass() const;
+  const VarStmt *superDeclaration() const { return _superDeclaration; }
+  const std::vector<const FunctionStmt *> &methods() const { return _methods; }
 private:
   Token _name;
-  std::vector<FunctionStmt *> _methods;
+  const VarStmt *_superDeclaration = nullptr;
+  std::vector<const FunctionStmt *> _methods;
 };
 
 } // namespace Stmt
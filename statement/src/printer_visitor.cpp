@@ -0,0 +1,193 @@
+#include <printer_visitor.h>
+
+void PrinterVisitor::visitBinary(const Expr::BinaryExpr* expr) {
+  parenthesize(expr->op().lexeme(), {expr->left(), expr->right()});
+}
+
+void PrinterVisitor::visitLiteral(
+    const Expr::LiteralExpr* expr) {
+  if (expr->value().isType<std::string>())
+    _builder << '"' << expr->value() << '"';
+  else
+    _builder << expr->value();
+}
+
+void PrinterVisitor::visitGrouping(
+    const Expr::GroupingExpr* expr) {
+  parenthesize("group", {expr->expr()});
+}
+
+void PrinterVisitor::visitUnary(const Expr::UnaryExpr* expr) {
+  parenthesize(expr->op().lexeme(), {expr->right()});
+}
+
+void PrinterVisitor::visitTernary(const Expr::TernaryExpr* expr) {
+  parenthesize("tertiary", {expr->condition(), expr->first(), expr->second()});
+}
+
+void PrinterVisitor::visitVariable(const Expr::VariableExpr *expr) {
+  _builder << expr->name().lexeme();
+}
+
+void PrinterVisitor::visitAssign(const Expr::AssignExpr *expr) {
+  parenthesize("= " + expr->name().lexeme(), {expr->value()});
+}
+
+void PrinterVisitor::visitLogic(const Expr::LogicExpr *expr) {
+  parenthesize(expr->op().lexeme(), {expr->first(), expr->second()});
+}
+
+void PrinterVisitor::visitCall(const Expr::CallExpr *expr) {
+  std::vector<const Expr::Expr *> exprs{expr->callee()};
+  exprs.insert(exprs.end(), expr->arguments().begin(), expr->arguments().end());
+  parenthesize("call", exprs);
+}
+
+void PrinterVisitor::visitGet(const Expr::GetExpr *expr) {
+  _builder << "(. ";
+  expr->object()->accept(this);
+  _builder << " " << expr->name().lexeme() << ")";
+}
+
+void PrinterVisitor::visitSet(const Expr::SetExpr *expr) {
+  parenthesize("=. " + expr->name().lexeme(), {expr->object(), expr->value()});
+}
+
+void PrinterVisitor::visitThis(const Expr::ThisExpr *) { _builder << "this"; }
+
+void PrinterVisitor::visitSuper(const Expr::SuperExpr *expr) {
+  _builder << "(super " << expr->method().lexeme() << ")";
+}
+
+void PrinterVisitor::visitInline(const Expr::InlineExpr *expr) {
+  parenthesize("inline " + expr->function()->name().lexeme(), {expr->body()});
+}
+
+void PrinterVisitor::visitExprStmt(const Stmt::ExprStmt *stmt) {
+  parenthesize(";", {stmt->expr()});
+}
+
+void PrinterVisitor::visitPrintStmt(const Stmt::PrintStmt *stmt) {
+  parenthesize("print", {stmt->expr()});
+}
+
+void PrinterVisitor::visitVarStmt(const Stmt::VarStmt *stmt) {
+  if (stmt->init() == nullptr)
+    _builder << "(var " << stmt->name().lexeme() << ")";
+  else
+    parenthesize("var " + stmt->name().lexeme(), {stmt->init()});
+}
+
+void PrinterVisitor::visitBlock(const Stmt::Block *stmt) {
+  _builder << "(block";
+  for (const Stmt::Stmt *statement : stmt->statements())
+    nest(statement);
+  _builder << ")";
+}
+
+void PrinterVisitor::visitIfStmt(const Stmt::IfStmt *stmt) {
+  _builder << "(if ";
+  stmt->condition()->accept(this);
+  nest(stmt->thenBranch());
+  if (stmt->elseBranch() != nullptr)
+    nest(stmt->elseBranch());
+  _builder << ")";
+}
+
+void PrinterVisitor::visitWhileStmt(const Stmt::WhileStmt *stmt) {
+  _builder << "(while ";
+  stmt->condition()->accept(this);
+  nest(stmt->body());
+  _builder << ")";
+}
+
+// Missing clauses are printed as _.
+void PrinterVisitor::visitForStmt(const Stmt::ForStmt *stmt) {
+  _builder << "(for ";
+  if (stmt->init() != nullptr)
+    stmt->init()->accept(this);
+  else
+    _builder << "_";
+  for (const Expr::Expr *clause : {stmt->condition(), stmt->after()}) {
+    _builder << " ";
+    if (clause != nullptr)
+      clause->accept(this);
+    else
+      _builder << "_";
+  }
+  nest(stmt->body());
+  _builder << ")";
+}
+
+void PrinterVisitor::visitFunctionStmt(const Stmt::FunctionStmt *stmt) {
+  _builder << "(fun ";
+  function(stmt);
+}
+
+void PrinterVisitor::visitReturnStmt(const Stmt::ReturnStmt *stmt) {
+  if (stmt->expr() == nullptr)
+    _builder << "(return)";
+  else
+    parenthesize("return", {stmt->expr()});
+}
+
+void PrinterVisitor::visitClassStmt(const Stmt::ClassStmt *stmt) {
+  _builder << "(class " << stmt->name().lexeme();
+  if (stmt->superclass() != nullptr)
+    _builder << " < " << stmt->superclass()->name().lexeme();
+
+  _depth++;
+  for (const Stmt::FunctionStmt *method : stmt->methods()) {
+    _builder << "\n" << std::string(2 * _depth, ' ') << "(";
+    function(method);
+  }
+  _depth--;
+  _builder << ")";
+}
+
+std::string PrinterVisitor::getOutput() { return _builder.str(); }
+
+std::string PrinterVisitor::print(const Expr::Expr* expr) {
+  _builder.str("");
+  expr->accept(this);
+  return getOutput();
+}
+
+std::string PrinterVisitor::print(const std::vector<Stmt::Stmt *> &statements) {
+  _builder.str("");
+  for (const Stmt::Stmt *statement : statements) {
+    statement->accept(this);
+    _builder << "\n";
+  }
+  return getOutput();
+}
+
+void PrinterVisitor::parenthesize(
+    const std::string &name,
+    const std::vector<const Expr::Expr*> &exprs) {
+  _builder << "(" << name;
+  for (const auto &expr : exprs) {
+    _builder << " ";
+
+    expr->accept(this);
+  }
+  _builder << ")";
+}
+
+void PrinterVisitor::nest(const Stmt::Stmt *stmt) {
+  _depth++;
+  _builder << "\n" << std::string(2 * _depth, ' ');
+  stmt->accept(this);
+  _depth--;
+}
+
+// The name, parameters and body of a function or method, after the "(".
+void PrinterVisitor::function(const Stmt::FunctionStmt *stmt) {
+  _builder << stmt->name().lexeme() << " (";
+  for (size_t i = 0; i < stmt->params().size(); i++)
+    _builder << (i > 0 ? " " : "") << stmt->params()[i].lexeme();
+  _builder << ")";
+  for (const Stmt::Stmt *statement : stmt->body())
+    nest(statement);
+  _builder << ")";
+}
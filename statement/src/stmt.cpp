@@ -2,19 +2,19 @@
 
 namespace Stmt {
 
-ExprStmt::ExprStmt(Expr::Expr *expr) : _expr(expr) {}
+ExprStmt::ExprStmt(const Expr::Expr *expr) : _expr(expr) {}
 
 void ExprStmt::accept(StmtVisitor *visitor) const {
   visitor->visitExprStmt(this);
 }
 
-PrintStmt::PrintStmt(Expr::Expr *expr) : _expr(expr) {}
+PrintStmt::PrintStmt(const Expr::Expr *expr) : _expr(expr) {}
 
 void PrintStmt::accept(StmtVisitor *visitor) const {
   visitor->visitPrintStmt(this);
 }
 
-VarStmt::VarStmt(Token name, Expr::Expr *init) : _name(name), _init(init) {}
+VarStmt::VarStmt(Token name, const Expr::Expr *init) : _name(name), _init(init) {}
 
 void VarStmt::accept(StmtVisitor *visitor) const {
   visitor->visitVarStmt(this);
@@ -25,23 +25,24 @@ Block::Block(std::vector<const Stmt *> statements)
 
 void Block::accept(StmtVisitor *visitor) const { visitor->visitBlock(this); }
 
-IfStmt::IfStmt(Expr::Expr *condition, Stmt *thenBranch)
-    : _condition(condition), _thenBranch(thenBranch) {}
+IfStmt::IfStmt(const Expr::Expr *condition, const Stmt *thenBranch)
+    : _condition(condition), _thenBranch(thenBranch), _elseBranch(nullptr) {}
 
-IfStmt::IfStmt(Expr::Expr *condition, Stmt *thenBranch, Stmt *elseBranch)
+IfStmt::IfStmt(const Expr::Expr *condition, const Stmt *thenBranch,
+               const Stmt *elseBranch)
     : _condition(condition), _thenBranch(thenBranch), _elseBranch(elseBranch) {}
 
 void IfStmt::accept(StmtVisitor *visitor) const { visitor->visitIfStmt(this); }
 
-WhileStmt::WhileStmt(Expr::Expr *condition, Stmt *body)
+WhileStmt::WhileStmt(const Expr::Expr *condition, const Stmt *body)
     : _condition(condition), _body(body) {}
 
 void WhileStmt::accept(StmtVisitor *visitor) const {
   visitor->visitWhileStmt(this);
 }
 
-ForStmt::ForStmt(Stmt *init, Expr::Expr *condition, Expr::Expr *after,
-                 Stmt *body)
+ForStmt::ForStmt(const Stmt *init, const Expr::Expr *condition,
+                 const Expr::Expr *after, const Stmt *body)
     : _init(init), _condition(condition), _after(after), _body(body) {}
 
 void ForStmt::accept(StmtVisitor *visitor) const {
@@ -49,8 +50,10 @@ void ForStmt::accept(StmtVisitor *visitor) const {
 }
 
 FunctionStmt::FunctionStmt(Token name, std::vector<Token> &params,
-                           std::vector<const Stmt *> &body)
-    : _name(name), _params(std::move(params)), _body(std::move(body)) {}
+                           std::vector<const Stmt *> &body,
+                           CompilationUnit *unit)
+    : _name(name), _params(std::move(params)), _body(std::move(body)),
+      _unit(unit) {}
 
 void FunctionStmt::accept(StmtVisitor *visitor) const {
   visitor->visitFunctionStmt(this);
@@ -64,4 +67,10 @@ void ClassStmt::accept(StmtVisitor* visitor) const {
   visitor->visitClassStmt(this);
 }
 
+const Expr::VariableExpr *ClassStmt::superclass() const {
+  if (_superDeclaration == nullptr)
+    return nullptr;
+  return static_cast<const Expr::VariableExpr *>(_superDeclaration->init());
+}
+
 } // namespace Stmt
@@ -6,16 +6,18 @@
 #include <any>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <variant>
 
 class Token {
 public:
-  Token(TOKEN_TYPE, std::string);
-  Token(TOKEN_TYPE, std::string, LoxType);
-  Token(TOKEN_TYPE, std::string, LoxType, size_t);
+  Token(TOKEN_TYPE, std::string_view);
+  Token(TOKEN_TYPE, std::string_view, LoxType);
+  Token(TOKEN_TYPE, std::string_view, LoxType, size_t);
 
   TOKEN_TYPE type() const { return _type; }
-  std::string lexeme() const { return _lexeme; }
+  const std::string &lexeme() const { return _lexeme.str(); }
+  const StringRef &symbol() const { return _lexeme; }
   const LoxType &literal() const { return _literal; }
 
   size_t line() const { return _line; }
@@ -24,7 +26,7 @@ public:
 
 private:
   TOKEN_TYPE _type;
-  std::string _lexeme;
+  StringRef _lexeme;
   LoxType _literal;
   size_t _line;
 };
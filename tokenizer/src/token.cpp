@@ -5,14 +5,14 @@
 #include <utility>
 #include <variant>
 
-Token::Token(TOKEN_TYPE type, std::string  lexeme)
-  : _type(type), _lexeme(std::move(lexeme)), _literal(), _line(0) {}
+Token::Token(TOKEN_TYPE type, std::string_view lexeme)
+  : _type(type), _lexeme(lexeme), _literal(), _line(0) {}
 
-Token::Token(TOKEN_TYPE type, std::string  lexeme, LoxType literal)
-: _type(type), _lexeme(std::move(lexeme)), _literal(std::move(literal)), _line(0) {}
+Token::Token(TOKEN_TYPE type, std::string_view lexeme, LoxType literal)
+: _type(type), _lexeme(lexeme), _literal(std::move(literal)), _line(0) {}
 
-Token::Token(TOKEN_TYPE type, std::string  lexeme, LoxType literal, size_t line)
-  : _type(type), _lexeme(std::move(lexeme)), _literal(std::move(literal)), _line(line) {}
+Token::Token(TOKEN_TYPE type, std::string_view lexeme, LoxType literal, size_t line)
+  : _type(type), _lexeme(lexeme), _literal(std::move(literal)), _line(line) {}
 
 bool Token::operator==(const Token& other) const {
   return (_type == other._type) && (_lexeme == other._lexeme) && (_literal == other._literal);
@@ -20,7 +20,7 @@ bool Token::operator==(const Token& other) const {
 
 std::ostream& operator<<(std::ostream& outs, const Token& token)
 {
-  outs << token._lexeme << " ";
+  outs << token.lexeme() << " ";
   if (!token._literal.empty())
     outs << token._literal;
 
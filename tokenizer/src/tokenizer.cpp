@@ -124,7 +124,7 @@ std::optional<Token> Tokenizer::getToken() {
 }
 
 Token Tokenizer::makeToken(TOKEN_TYPE type, LoxType literal) {
-  std::string text = _source.substr(_start, _current - _start);
+  std::string_view text = std::string_view(_source).substr(_start, _current - _start);
   return Token{type, text, literal, _line};
 }
 
@@ -172,7 +172,7 @@ std::optional<Token> Tokenizer::handleString() {
 
   advance();
 
-  std::string literal = _source.substr(_start + 1, _current - _start - 2);
+  StringRef literal(std::string_view(_source).substr(_start + 1, _current - _start - 2));
 
   return makeToken(STRING, literal);
 }
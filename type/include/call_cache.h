@@ -0,0 +1,47 @@
+#pragma once
+
+#include <lox_type.h>
+
+#include <cstddef>
+#include <cstdint>
+
+class LoxCallable;
+class LoxFunction;
+
+// The inline cache of a call site: the callee it called last and what
+// calling it takes, so that a site calling the same function or class
+// again neither works out what the callee is nor computes its arity.
+// Callees are told apart by address, which a collection may move them
+// from or hand to a new object, so the entry only holds until the next
+// collection (see Heap::epoch).
+class CallCache {
+public:
+  enum class Kind : uint8_t { FUNCTION, NATIVE, CLASS };
+
+  struct Entry {
+    LoxType callee;
+    Kind kind = Kind::NATIVE;
+    size_t arity = 0;
+    // The function called, or the initializer of a class if it has one.
+    LoxFunction *function = nullptr;
+    // A native function or a class.
+    LoxCallable *callable = nullptr;
+  };
+
+  const Entry *find(const LoxType &callee, unsigned epoch) const {
+    return _valid && _epoch == epoch && _entry.callee == callee ? &_entry
+                                                                : nullptr;
+  }
+
+  const Entry &set(Entry entry, unsigned epoch) {
+    _entry = std::move(entry);
+    _epoch = epoch;
+    _valid = true;
+    return _entry;
+  }
+
+private:
+  Entry _entry;
+  unsigned _epoch = 0;
+  bool _valid = false;
+};
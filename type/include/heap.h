@@ -0,0 +1,196 @@
+#pragma once
+
+#include <lox_object.h>
+#include <lox_type.h>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class Environment;
+class LoxFunction;
+class LoxInstance;
+
+// Something outside of the heap that holds references into it, such as an
+// interpreter's environments. Registered sources mark their references at
+// the start of every collection, and must pass the actual slots so that
+// references to moved objects can be updated.
+class RootSource {
+public:
+  virtual void markRoots(Heap &) = 0;
+};
+
+// Bump allocated young space. Allocation is a pointer increment; survivors
+// are copied out on a minor collection and the whole space is then reused.
+class Nursery {
+public:
+  static constexpr size_t CAPACITY = 512 * 1024;
+
+  void *allocate(size_t size) {
+    if (_top + size > _end)
+      return nullptr;
+
+    void *memory = _top;
+    _top += size;
+    return memory;
+  }
+
+  bool contains(const void *ptr) const { return ptr >= _begin && ptr < _end; }
+
+  void reset() { _top = _begin; }
+
+private:
+  std::unique_ptr<std::byte[]> _storage{new std::byte[CAPACITY]};
+  std::byte *_begin = _storage.get();
+  std::byte *_top = _begin;
+  std::byte *_end = _begin + CAPACITY;
+};
+
+// Owner of every LoxObject. The heap is generational: instances and
+// functions are born in the nursery and promoted into the old space if they
+// survive a minor collection, everything else is allocated old. The old
+// space is collected by a stop-the-world mark and sweep once enough bytes
+// were promoted or allocated there since the last one.
+//
+// Environments are not heap objects, but take part in the same scheme: one
+// that was reached by a minor collection counts as old, and old
+// environments are only scanned by later minor collections if a young
+// object was stored into them since.
+//
+// Collections are only requested by allocation and performed at the next
+// safepoint (see Interpreter::execute), so code between safepoints may hold
+// unrooted references.
+class Heap {
+public:
+  static Heap &instance();
+
+  ~Heap();
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    if constexpr (std::is_same_v<T, LoxInstance> ||
+                  std::is_same_v<T, LoxFunction>) {
+      if (void *memory = _nursery.allocate(slotSize(sizeof(T)))) {
+        T *object = new (memory) T(std::forward<Args>(args)...);
+        _young.push_back(object);
+        return object;
+      }
+      _nurseryFull = true;
+    }
+
+    T *object = new T(std::forward<Args>(args)...);
+    track(object);
+    // A new old object may refer to young objects and environments without
+    // having gone through a write barrier.
+    remember(object);
+    return object;
+  }
+
+  bool shouldCollect() const {
+    return _nurseryFull || _bytesAllocated >= _nextCollection;
+  }
+  void collect();
+
+  void mark(LoxType &);
+  void mark(LoxObject *);
+  void mark(Environment *);
+
+  bool isYoung(const void *ptr) const { return _nursery.contains(ptr); }
+  bool isYoung(const LoxType &value) const {
+    if (value.isType<LoxInstance *>())
+      return isYoung(value.getValue<LoxInstance *>());
+    if (value.isType<LoxFunction *>())
+      return isYoung(value.getValue<LoxFunction *>());
+    return false;
+  }
+
+  // Must be called whenever a value is stored into an instance field or an
+  // environment slot, so that minor collections can find old-to-young
+  // references without scanning the old space.
+  void writeBarrier(LoxObject *owner, const LoxType &value) {
+    if (!owner->_remembered && !isYoung(owner) && isYoung(value))
+      remember(owner);
+  }
+  void writeBarrier(Environment *, const LoxType &);
+  void forget(Environment *);
+
+  void addRootSource(RootSource *);
+  void removeRootSource(RootSource *);
+
+  // Values held by native code across a safepoint, see RootGuard.
+  void pushRoots(LoxType *, size_t);
+  void popRoots();
+
+  // Changes with every collection, after which objects may have moved and
+  // their old addresses may be reused.
+  unsigned epoch() const { return _epoch; }
+
+  void setReportStats(bool report) { _reportStats = report; }
+  void reportStats(std::ostream &) const;
+
+private:
+  static constexpr size_t MIN_COLLECTION_BYTES = 1024 * 1024;
+
+  static constexpr size_t slotSize(size_t size) {
+    return (size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+           alignof(std::max_align_t);
+  }
+
+  void track(LoxObject *);
+  void remember(LoxObject *object) {
+    object->_remembered = true;
+    _rememberedObjects.push_back(object);
+  }
+  void markRoots();
+  void collectYoung();
+  void collectOld();
+  void evacuate(LoxType &);
+  template <typename T> void evacuate(LoxType &);
+  size_t sweep();
+  void report(const char *, size_t, double, size_t, size_t);
+
+  // Owned by the heap rather than thread local: the interpreter runs on one
+  // thread, and a thread local nursery is destroyed before the static heap,
+  // which then could not destroy the young objects left in it.
+  Nursery _nursery;
+  std::vector<LoxObject *> _young;
+  bool _nurseryFull = false;
+  bool _collectingYoung = false;
+  std::vector<LoxObject *> _promoted;
+  std::vector<LoxObject *> _rememberedObjects;
+  std::unordered_set<Environment *> _rememberedEnvironments;
+
+  LoxObject *_objects = nullptr;
+  std::vector<LoxObject *> _gray;
+  std::vector<RootSource *> _rootSources;
+  std::vector<std::pair<LoxType *, size_t>> _roots;
+  unsigned _epoch = 0;
+
+  size_t _bytesAllocated = 0;
+  size_t _nextCollection = MIN_COLLECTION_BYTES;
+
+  bool _reportStats = false;
+  size_t _collections = 0;
+  size_t _minorCollections = 0;
+  size_t _bytesReclaimed = 0;
+  size_t _bytesPromoted = 0;
+  double _totalPause = 0;
+  double _maxPause = 0;
+};
+
+// Keeps values alive across a safepoint for as long as it is in scope. The
+// values may be rewritten if the objects they refer to are moved.
+class RootGuard {
+public:
+  explicit RootGuard(LoxType *values, size_t count = 1) {
+    Heap::instance().pushRoots(values, count);
+  }
+  ~RootGuard() { Heap::instance().popRoots(); }
+
+  RootGuard(const RootGuard &) = delete;
+  RootGuard &operator=(const RootGuard &) = delete;
+};
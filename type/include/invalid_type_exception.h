@@ -1,13 +1,12 @@
 #include <exception>
-#include <typeindex>
 #include <string>
 #include <sstream>
 
 class InvalidTypeException : public std::exception {
 public:
-  InvalidTypeException(const std::type_index& expected, const std::type_index& given) {
+  InvalidTypeException(const std::string& expected, const std::string& given) {
     std::stringstream stream;
-    stream << "Expected " << expected.name() << ", got " << given.name() << ".";
+    stream << "Expected " << expected << ", got " << given << ".";
     _msg = stream.str();
   }
 
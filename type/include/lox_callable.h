@@ -1,13 +1,16 @@
 #pragma once
 
-#include <vector>
+#include <lox_object.h>
+
+#include <cstddef>
+#include <span>
 
 class LoxType;
 class Interpreter;
 
-class LoxCallable {
+class LoxCallable : public LoxObject {
 public:
-  virtual LoxType call(Interpreter *, const std::vector<LoxType> &) = 0;
+  virtual LoxType call(Interpreter *, std::span<const LoxType>) = 0;
 
   virtual size_t arity() const = 0;
 };
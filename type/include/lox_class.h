@@ -2,25 +2,64 @@
 
 #include <lox_callable.h>
 #include <lox_function.h>
+#include <shape.h>
 
 #include <map>
 #include <string>
-#include <optional>
+#include <unordered_map>
+#include <vector>
+
+class Token;
 
 class LoxClass : public LoxCallable {
 public:
-  LoxClass(const std::string &name,
-           const std::map<std::string, LoxFunction> &methods)
-      : _name(name), _methods(std::move(methods)) {}
+  // The methods of the superclass, if any, are inherited unless methods
+  // overrides them.
+  LoxClass(const std::string &name, LoxClass *superclass,
+           const std::map<std::string, LoxFunction> &methods);
 
-  LoxType call(Interpreter *, const std::vector<LoxType> &) override;
+  LoxType call(Interpreter *, std::span<const LoxType>) override;
   size_t arity() const override;
+  // Creates an instance and runs the initializer on it, for callers that
+  // already looked it up.
+  LoxType instantiate(Interpreter *, LoxFunction *initializer,
+                      std::span<const LoxType>);
+  // The init method, declared or inherited, or nullptr.
+  LoxFunction *initializer() const;
 
   const std::string &name();
+  LoxClass *superclass() { return _superclass; }
+
+  // The number all methods with this name are stored under. Numbers are
+  // handed out as names are first seen, and are the same in every class.
+  static size_t methodId(const std::string &);
+
+  // The method with this name, declared or inherited, or nullptr.
+  LoxFunction *getMethod(const std::string &);
+  LoxFunction *getMethod(size_t id) const {
+    return id < _table.size() ? _table[id] : nullptr;
+  }
+  // The method super.name refers to in the subclasses of this class.
+  // Throws a RuntimeError if there is none.
+  LoxFunction *superMethod(const Token &name);
 
-  std::optional<LoxFunction> getMethod(const std::string &) const;
+  // The shape of new instances, the root of the shapes of all instances.
+  Shape *shape() { return &_shape; }
+
+  void trace(Heap &) override;
+  size_t size() const override;
 
 private:
+  static std::unordered_map<std::string, size_t> &methodIds();
+
   std::string _name;
-  std::map<std::string, LoxFunction> _methods;
+  LoxClass *_superclass;
+  // The methods declared by the class itself.
+  std::vector<LoxFunction> _methods;
+  // Every method of the class by id, copied down from the superclass when
+  // the class is created, so a lookup does not walk the hierarchy. The
+  // inherited ones are owned by the superclass, which the class keeps
+  // alive.
+  std::vector<LoxFunction *> _table;
+  Shape _shape;
 };
@@ -1,20 +1,67 @@
 #pragma once
 
-#include <environment.h>
 #include <lox_callable.h>
+#include <lox_type.h>
+#include <resolution.h>
 #include <stmt.h>
+#include <upvalue.h>
+
+#include <memory>
+#include <vector>
+
+class LoxInstance;
+
+namespace Jit {
+class Code;
+}
+
+// What an engine other than the tree walker compiled a function declaration
+// to. Each engine derives its own, and the functions it creates keep theirs
+// alive and at hand for their calls.
+struct CompiledFunction {};
 
 class LoxFunction : public LoxCallable {
 public:
-  LoxFunction(const Stmt::FunctionStmt, std::shared_ptr<Environment>);
+  LoxFunction(const Stmt::FunctionStmt *, const FunctionInfo *,
+              std::vector<Upvalue *>,
+              std::shared_ptr<const CompiledFunction> compiled = nullptr);
   LoxFunction(const LoxFunction&);
+  // Moving keeps the storage of the upvalues, which the frames of running
+  // calls point into.
+  LoxFunction(LoxFunction &&) = default;
 
-  LoxType call(Interpreter *, const std::vector<LoxType> &) override;
+  LoxType call(Interpreter *, std::span<const LoxType>) override;
+  // Calls a method with an explicit receiver, without binding it first.
+  LoxType invoke(Interpreter *, const LoxType &receiver,
+                 std::span<const LoxType>);
 
   size_t arity() const override;
 
-  LoxFunction* bind(LoxInstance*);
+  LoxFunction* bind(LoxInstance*) const;
+
+  const Stmt::FunctionStmt *declaration() const { return _declaration; }
+  const FunctionInfo &info() const { return *_info; }
+  // What the engine that created the function compiled it to, if any.
+  const CompiledFunction *compiled() const { return _compiled.get(); }
+  // The instance a bound method was bound to, nil otherwise.
+  const LoxType &receiver() const { return _receiver; }
+  Upvalue *const *upvalues() const { return _upvalues.data(); }
+
+  void trace(Heap &) override;
+  size_t size() const override {
+    return sizeof(LoxFunction) + _upvalues.size() * sizeof(Upvalue *);
+  }
 private:
-  Stmt::FunctionStmt _declaration;
-  Environment _closure;
+  // Points into the syntax tree rather than holding a copy, since a young
+  // function may be moved and destroyed while its body is running.
+  const Stmt::FunctionStmt *_declaration;
+  const FunctionInfo *_info;
+  std::shared_ptr<CompilationUnit> _unit;
+  std::shared_ptr<const CompiledFunction> _compiled;
+  std::vector<Upvalue *> _upvalues;
+  LoxType _receiver;
+  // Calls counted until the function is handed to the JIT, and the code it
+  // produced, if any.
+  uint32_t _calls = 0;
+  const Jit::Code *_native = nullptr;
 };
@@ -1,22 +1,57 @@
 #pragma once
 
 #include <lox_class.h>
+#include <lox_object.h>
+#include <property_cache.h>
+#include <shape.h>
 
-#include <map>
+#include <memory>
 
 class Token;
 
-class LoxInstance {
+// An instance of a class. Its shape maps field names to slots; the first
+// slots are stored inline, so small instances need no further allocation,
+// the rest in an array that grows by doubling.
+class LoxInstance : public LoxObject {
 public:
+  static constexpr int INLINE_FIELDS = 4;
+
   LoxInstance(LoxClass*);
   
   const LoxType get(Token);
   
   void set(Token, LoxType);
 
+  // get and set for a site with an inline cache, which is consulted first
+  // and records the result of lookups that miss it.
+  const LoxType get(const Token &, PropertyCache &);
+  void set(const Token &, LoxType, PropertyCache &);
+  // The method a call of the property invokes, or nullptr if the property
+  // is not a method: a field, which takes precedence, or an error that get
+  // reports.
+  LoxFunction *method(const Token &, PropertyCache &);
+
   bool operator==(const LoxInstance&) const;
+
+  void trace(Heap &) override;
+  size_t size() const override;
 private:
+  LoxType &field(int slot) {
+    return slot < INLINE_FIELDS ? _inline[slot] : _overflow[slot - INLINE_FIELDS];
+  }
+  const LoxType &field(int slot) const {
+    return const_cast<LoxInstance *>(this)->field(slot);
+  }
+  // The cache entry for a name on this instance's shape, added on a miss.
+  // nullptr if the name is neither a field nor a method, or the cache is
+  // full.
+  const PropertyCache::Entry *lookup(const Token &, PropertyCache &);
+  // Makes room for a field in the given slot, the first free one.
+  void grow(int slot);
+  size_t overflowCapacity() const;
+
   LoxClass* _loxClass;
-  std::map<std::string, LoxType> _fields;
+  Shape *_shape;
+  LoxType _inline[INLINE_FIELDS];
+  std::unique_ptr<LoxType[]> _overflow;
 };
-
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+class Heap;
+
+// Base of every value that LoxType refers to by pointer. Objects are
+// allocated through Heap::make and freed by the collector once nothing
+// reachable from the roots refers to them.
+class LoxObject {
+public:
+  LoxObject() = default;
+  // Copies are new objects as far as the heap is concerned.
+  LoxObject(const LoxObject &) {}
+  virtual ~LoxObject() = default;
+
+  // Marks every object and environment this object refers to.
+  virtual void trace(Heap &) {}
+
+  // Approximate number of bytes owned by this object.
+  virtual size_t size() const = 0;
+
+private:
+  friend class Heap;
+
+  // For young objects a set mark means the object was promoted and _next
+  // points at its old space copy.
+  bool _marked = false;
+  bool _remembered = false;
+  LoxObject *_next = nullptr;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Immutable heap storage for Lox strings. Flat strings are interned, so two
+// flat strings with the same characters are the same object: equality is a
+// pointer compare and the hash is computed once, when the string is made.
+//
+// Concatenation produces a rope node instead, which only references its two
+// halves. A rope is flattened into its interned canonical string the first
+// time its characters or hash are needed.
+class LoxString {
+public:
+  // Returns the canonical string for these characters, creating it if it
+  // does not exist yet. The caller is responsible for retaining it.
+  static LoxString *intern(std::string_view);
+
+  // Returns a string holding left followed by right. Short results are
+  // built eagerly; longer ones become rope nodes. The caller is
+  // responsible for retaining it.
+  static LoxString *concat(LoxString *left, LoxString *right);
+
+  const std::string &str() const { return canonical()->_chars; }
+  size_t hash() const { return canonical()->_hash; }
+  size_t length() const { return _length; }
+
+  // The interned flat string with the same characters.
+  LoxString *canonical() const {
+    return _canonical != nullptr ? _canonical : flatten();
+  }
+
+  void retain() { _refs++; }
+  void release() {
+    if (--_refs == 0)
+      destroy();
+  }
+
+  static size_t hashOf(std::string_view chars) {
+    return std::hash<std::string_view>()(chars);
+  }
+
+private:
+  static constexpr size_t ROPE_THRESHOLD = 64;
+
+  LoxString(std::string_view chars)
+      : _length(chars.size()), _chars(chars), _hash(hashOf(chars)),
+        _canonical(this) {}
+  LoxString(LoxString *left, LoxString *right);
+
+  bool isRope() const { return _left != nullptr; }
+
+  LoxString *flatten() const;
+  void destroy();
+
+  size_t _refs = 0;
+  size_t _length;
+  std::string _chars;
+  size_t _hash = 0;
+
+  mutable LoxString *_canonical = nullptr;
+  mutable LoxString *_left = nullptr;
+  mutable LoxString *_right = nullptr;
+};
+
+// Owning handle to an interned LoxString, usable as a hash map key.
+class StringRef {
+public:
+  StringRef() : _string(nullptr) {}
+  explicit StringRef(std::string_view chars) : StringRef(LoxString::intern(chars)) {}
+  explicit StringRef(LoxString *string) : _string(string) { retain(); }
+  StringRef(const StringRef &other) : StringRef(other._string) {}
+  StringRef(StringRef &&other) : _string(other._string) { other._string = nullptr; }
+  ~StringRef() { release(); }
+
+  StringRef &operator=(StringRef other) {
+    std::swap(_string, other._string);
+    return *this;
+  }
+
+  LoxString *get() const { return _string; }
+  const std::string &str() const;
+
+  bool operator==(const StringRef &other) const { return _string == other._string; }
+
+private:
+  void retain() {
+    if (_string != nullptr)
+      _string->retain();
+  }
+  void release() {
+    if (_string != nullptr)
+      _string->release();
+  }
+
+  LoxString *_string;
+};
+
+template <> struct std::hash<StringRef> {
+  size_t operator()(const StringRef &ref) const {
+    return ref.get() == nullptr ? 0 : ref.get()->hash();
+  }
+};
@@ -1,12 +1,15 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <ostream>
 #include <string>
-#include <typeindex>
+#include <type_traits>
 #include <variant>
 
 #include <invalid_type_exception.h>
+#include <lox_string.h>
 #include <iostream>
 
 class LoxFunction;
@@ -14,56 +17,178 @@ class LoxInstance;
 class LoxClass;
 class LoxCallable;
 
+// A Lox value packed into 8 bytes. Numbers are stored as plain doubles,
+// everything else lives in the payload of a negative quiet NaN with the
+// tag in bits 48-50 and a pointer or bool in the low 48 bits. Strings point
+// at a LoxString, which is either interned or a rope waiting to be
+// flattened.
 class LoxType {
 public:
-  LoxType();
+  enum Tag { NUMBER, NIL, BOOL, STRING, CALLABLE, FUNCTION, CLASS, INSTANCE };
+
+  template <typename T>
+  using value_type =
+      std::conditional_t<std::is_same_v<T, std::string>, const std::string &, T>;
+
+  LoxType() : _bits(box(NIL, 0)) {}
   LoxType(const LoxType &);
-  LoxType(std::monostate);
-  LoxType(bool);
+  LoxType(LoxType &&);
+  LoxType(std::monostate) : LoxType() {}
+  LoxType(bool val) : _bits(box(BOOL, val)) {}
   LoxType(double);
   LoxType(std::string);
-  LoxType(LoxCallable *);
-  LoxType(LoxFunction *);
-  LoxType(LoxClass *);
-  LoxType(LoxInstance *);
+  LoxType(const StringRef &);
+  LoxType(LoxCallable *val) : _bits(boxPointer(CALLABLE, val)) {}
+  LoxType(LoxFunction *val) : _bits(boxPointer(FUNCTION, val)) {}
+  LoxType(LoxClass *val) : _bits(boxPointer(CLASS, val)) {}
+  LoxType(LoxInstance *val) : _bits(boxPointer(INSTANCE, val)) {}
+  explicit LoxType(LoxString *);
+  ~LoxType();
 
-  template <typename T> const T &getValue() const;
+  template <typename T> value_type<T> getValue() const;
 
   template <typename T> bool isType() const;
 
-  bool empty() const;
-
-  LoxType &operator=(LoxType &);
-  LoxType &operator=(bool);
-  LoxType &operator=(double);
-  LoxType &operator=(std::string);
-  LoxType &operator=(LoxCallable *);
-  LoxType &operator=(LoxFunction *);
-  LoxType &operator=(LoxClass *);
-  LoxType &operator=(LoxInstance *);
+  Tag tag() const;
+  bool empty() const { return _bits == box(NIL, 0); }
 
   LoxType &operator=(const LoxType &);
+  LoxType &operator=(LoxType &&);
 
   bool operator==(const LoxType &) const;
 
+  // Concatenates two string values without copying their characters.
+  static LoxType concat(const LoxType &, const LoxType &);
+
+  static const char *typeName(Tag);
+
 private:
-  std::variant<bool, double, std::string, LoxInstance *, LoxCallable *,
-               LoxClass *, LoxFunction *, std::monostate>
-      _value;
-  std::type_index _type;
+  static constexpr uint64_t BOX_MASK = 0xfff8000000000000;
+  static constexpr uint64_t PAYLOAD_MASK = 0x0000ffffffffffff;
+  static constexpr uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+  static constexpr int TAG_SHIFT = 48;
+
+  static constexpr uint64_t box(Tag tag, uint64_t payload) {
+    return BOX_MASK | (uint64_t(tag) << TAG_SHIFT) | payload;
+  }
+  static uint64_t boxPointer(Tag tag, const void *ptr) {
+    return box(tag, reinterpret_cast<uint64_t>(ptr) & PAYLOAD_MASK);
+  }
+
+  template <typename T> static constexpr Tag tagOf();
+
+  double number() const;
+  void *pointer() const { return reinterpret_cast<void *>(_bits & PAYLOAD_MASK); }
+  LoxString *string() const { return static_cast<LoxString *>(pointer()); }
+
+  void retain() const;
+  void release() const;
+
+  uint64_t _bits;
 
   friend std::ostream &operator<<(std::ostream &, const LoxType &);
 };
 
-template <typename T> const T &LoxType::getValue() const {
-  if (isType<T>()) {
-    return std::get<T>(_value);
+static_assert(sizeof(LoxType) == 8, "LoxType must stay NaN-boxed");
+
+template <typename T> constexpr LoxType::Tag LoxType::tagOf() {
+  if constexpr (std::is_same_v<T, double>)
+    return NUMBER;
+  else if constexpr (std::is_same_v<T, std::monostate>)
+    return NIL;
+  else if constexpr (std::is_same_v<T, bool>)
+    return BOOL;
+  else if constexpr (std::is_same_v<T, std::string>)
+    return STRING;
+  else if constexpr (std::is_same_v<T, LoxCallable *>)
+    return CALLABLE;
+  else if constexpr (std::is_same_v<T, LoxFunction *>)
+    return FUNCTION;
+  else if constexpr (std::is_same_v<T, LoxClass *>)
+    return CLASS;
+  else if constexpr (std::is_same_v<T, LoxInstance *>)
+    return INSTANCE;
+  else
+    static_assert(!sizeof(T), "Type can not be stored in a LoxType");
+}
+
+inline LoxType::LoxType(const LoxType &other) : _bits(other._bits) {
+  retain();
+}
+
+inline LoxType::LoxType(LoxType &&other) : _bits(other._bits) {
+  other._bits = box(NIL, 0);
+}
+
+inline LoxType::LoxType(double val) {
+  if (val != val)
+    _bits = CANONICAL_NAN;
+  else
+    std::memcpy(&_bits, &val, sizeof(val));
+}
+
+inline LoxType::~LoxType() { release(); }
+
+inline LoxType &LoxType::operator=(const LoxType &other) {
+  other.retain();
+  release();
+  _bits = other._bits;
+
+  return *this;
+}
+
+inline LoxType &LoxType::operator=(LoxType &&other) {
+  if (this != &other) {
+    release();
+    _bits = other._bits;
+    other._bits = box(NIL, 0);
   }
 
-  throw InvalidTypeException(_type, typeid(T));
+  return *this;
+}
+
+inline LoxType::Tag LoxType::tag() const {
+  if ((_bits & BOX_MASK) != BOX_MASK)
+    return NUMBER;
+
+  return static_cast<Tag>((_bits >> TAG_SHIFT) & 0x7);
+}
+
+inline double LoxType::number() const {
+  double val;
+  std::memcpy(&val, &_bits, sizeof(val));
+  return val;
+}
+
+inline void LoxType::retain() const {
+  if (isType<std::string>())
+    string()->retain();
+}
+
+inline void LoxType::release() const {
+  if (isType<std::string>())
+    string()->release();
+}
+
+template <typename T> LoxType::value_type<T> LoxType::getValue() const {
+  if (!isType<T>())
+    throw InvalidTypeException(typeName(tagOf<T>()), typeName(tag()));
+
+  if constexpr (std::is_same_v<T, double>)
+    return number();
+  else if constexpr (std::is_same_v<T, bool>)
+    return (_bits & 1) != 0;
+  else if constexpr (std::is_same_v<T, std::string>)
+    return string()->str();
+  else if constexpr (std::is_same_v<T, std::monostate>)
+    return std::monostate();
+  else
+    return static_cast<T>(pointer());
 }
 
 template <typename T> bool LoxType::isType() const {
-  std::type_index template_type = typeid(T);
-  return template_type == _type;
+  if constexpr (tagOf<T>() == NUMBER)
+    return (_bits & BOX_MASK) != BOX_MASK;
+  else
+    return (_bits & ~PAYLOAD_MASK) == box(tagOf<T>(), 0);
 }
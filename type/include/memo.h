@@ -0,0 +1,35 @@
+#pragma once
+
+#include <lox_type.h>
+
+#include <cstddef>
+#include <ostream>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+// The results of calls to a pure function, by the values of their
+// arguments. Only calls whose arguments are all numbers or strings have a
+// key, and only results that are not objects are kept, so that a hit
+// neither shares a mutable object nor needs tracing. Once it holds
+// `capacity` results the cache is emptied and starts over.
+class Memo {
+public:
+  Memo(std::string name, size_t capacity);
+
+  // Encodes the arguments of a call into `key`, false if one of them is
+  // neither a number nor a string.
+  static bool key(std::span<const LoxType> args, std::string &key);
+
+  // The result stored under a key, nullptr on a miss.
+  const LoxType *find(const std::string &key);
+  void insert(std::string key, const LoxType &result);
+
+  void reportStats(std::ostream &) const;
+private:
+  std::string _name;
+  size_t _capacity;
+  std::unordered_map<std::string, LoxType> _results;
+  size_t _hits = 0;
+  size_t _misses = 0;
+};
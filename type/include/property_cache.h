@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class LoxFunction;
+class Shape;
+
+// The inline cache of a property access site: what the name resolved to on
+// instances of the shapes seen there. Monomorphic sites hit the first
+// entry; a site that sees more than SIZE shapes keeps the first ones and
+// looks the others up every time.
+class PropertyCache {
+public:
+  static constexpr size_t SIZE = 4;
+
+  struct Entry {
+    // The id of the shape, which unlike its address is never reused.
+    uint64_t shape = 0;
+    // The slot of a field, or -1 for a method.
+    int slot = -1;
+    LoxFunction *method = nullptr;
+    // For a set that adds the field, the shape the instance moves to.
+    Shape *transition = nullptr;
+  };
+
+  const Entry *find(uint64_t shape) const {
+    for (size_t i = 0; i < _count; i++) {
+      if (_entries[i].shape == shape)
+        return &_entries[i];
+    }
+    return nullptr;
+  }
+
+  void add(const Entry &entry) {
+    if (_count < SIZE)
+      _entries[_count++] = entry;
+  }
+
+  size_t size() const { return _count; }
+
+private:
+  Entry _entries[SIZE];
+  size_t _count = 0;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// The layout of an instance's fields: the slot each field is stored in.
+// Every class is the root of a tree of shapes. An instance starts out at
+// the root and moves to a child whenever a field is added, so instances of
+// a class that get the same fields in the same order share a shape.
+class Shape {
+public:
+  Shape() : _id(++_lastId) {}
+  Shape(const Shape &) = delete;
+  Shape &operator=(const Shape &) = delete;
+
+  // The slot of a field, or -1 if the shape has no such field.
+  int slot(const std::string &name) const {
+    auto it = _slots.find(name);
+    return it != _slots.end() ? it->second : -1;
+  }
+
+  // Identifies the shape in inline caches (see PropertyCache).
+  uint64_t id() const { return _id; }
+  size_t fields() const { return _slots.size(); }
+  const std::unordered_map<std::string, int> &slots() const { return _slots; }
+
+  // The shape with a field added after the existing ones.
+  Shape *add(const std::string &name);
+
+private:
+  static inline uint64_t _lastId = 0;
+
+  uint64_t _id;
+  std::unordered_map<std::string, int> _slots;
+  std::unordered_map<std::string, std::unique_ptr<Shape>> _transitions;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <heap.h>
+#include <lox_object.h>
+#include <lox_type.h>
+
+// A local variable that outlives its frame because a function captured
+// it. The frame and every closure that captured the variable share the
+// same Upvalue.
+class Upvalue : public LoxObject {
+public:
+  Upvalue() = default;
+  explicit Upvalue(LoxType value) : _value(std::move(value)) {}
+
+  const LoxType &get() const { return _value; }
+  void set(LoxType value) {
+    Heap::instance().writeBarrier(this, value);
+    _value = std::move(value);
+  }
+
+  void trace(Heap &heap) override { heap.mark(_value); }
+  size_t size() const override { return sizeof(Upvalue); }
+
+private:
+  LoxType _value;
+};
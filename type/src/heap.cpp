@@ -0,0 +1,263 @@
+#include <environment.h>
+#include <heap.h>
+#include <lox_callable.h>
+#include <lox_class.h>
+#include <lox_function.h>
+#include <lox_instance.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+Heap &Heap::instance() {
+  static Heap heap;
+  return heap;
+}
+
+Heap::~Heap() {
+  for (LoxObject *object : _young)
+    object->~LoxObject();
+
+  while (_objects != nullptr) {
+    LoxObject *next = _objects->_next;
+    delete _objects;
+    _objects = next;
+  }
+}
+
+void Heap::track(LoxObject *object) {
+  object->_next = _objects;
+  _objects = object;
+  _bytesAllocated += object->size();
+}
+
+void Heap::mark(LoxType &value) {
+  if (_collectingYoung) {
+    evacuate(value);
+    return;
+  }
+
+  switch (value.tag()) {
+  case LoxType::CALLABLE:
+    mark(value.getValue<LoxCallable *>());
+    break;
+  case LoxType::FUNCTION:
+    mark(value.getValue<LoxFunction *>());
+    break;
+  case LoxType::CLASS:
+    mark(value.getValue<LoxClass *>());
+    break;
+  case LoxType::INSTANCE:
+    mark(value.getValue<LoxInstance *>());
+    break;
+  default:
+    break;
+  }
+}
+
+void Heap::mark(LoxObject *object) {
+  // A minor collection never traces through the old space, old objects
+  // that refer to young ones are found through the remembered set.
+  if (_collectingYoung || object == nullptr || object->_marked)
+    return;
+
+  object->_marked = true;
+  _gray.push_back(object);
+}
+
+void Heap::mark(Environment *environment) {
+  // Environments are shared by many closures, visit each chain once.
+  for (; environment != nullptr && environment->_epoch != _epoch;
+       environment = environment->_enclosing.get()) {
+    if (_collectingYoung) {
+      // An old environment only refers to young objects if it was
+      // remembered, and everything it encloses is older still.
+      if (environment->_old)
+        break;
+      environment->_old = true;
+    }
+
+    environment->_epoch = _epoch;
+    for (auto &[name, value] : environment->_values)
+      mark(value);
+  }
+}
+
+void Heap::evacuate(LoxType &value) {
+  if (value.isType<LoxInstance *>())
+    evacuate<LoxInstance>(value);
+  else if (value.isType<LoxFunction *>())
+    evacuate<LoxFunction>(value);
+}
+
+template <typename T> void Heap::evacuate(LoxType &value) {
+  T *young = value.getValue<T *>();
+  if (!isYoung(young))
+    return;
+
+  if (!young->_marked) {
+    T *promoted = new T(std::move(*young));
+    track(promoted);
+    _bytesPromoted += promoted->size();
+    _promoted.push_back(promoted);
+
+    young->_marked = true;
+    young->_next = promoted;
+  }
+
+  value = static_cast<T *>(young->_next);
+}
+
+void Heap::writeBarrier(Environment *environment, const LoxType &value) {
+  if (environment->_old && !environment->_remembered && isYoung(value)) {
+    environment->_remembered = true;
+    _rememberedEnvironments.insert(environment);
+  }
+}
+
+void Heap::forget(Environment *environment) {
+  _rememberedEnvironments.erase(environment);
+}
+
+void Heap::addRootSource(RootSource *source) { _rootSources.push_back(source); }
+
+void Heap::removeRootSource(RootSource *source) {
+  std::erase(_rootSources, source);
+}
+
+void Heap::pushRoots(LoxType *values, size_t count) {
+  _roots.emplace_back(values, count);
+}
+
+void Heap::popRoots() { _roots.pop_back(); }
+
+void Heap::markRoots() {
+  _epoch++;
+
+  for (RootSource *source : _rootSources)
+    source->markRoots(*this);
+  for (auto [values, count] : _roots) {
+    for (size_t i = 0; i < count; i++)
+      mark(values[i]);
+  }
+}
+
+void Heap::collect() {
+  collectYoung();
+
+  if (_bytesAllocated >= _nextCollection)
+    collectOld();
+}
+
+void Heap::collectYoung() {
+  auto start = std::chrono::steady_clock::now();
+  size_t promotedBefore = _bytesPromoted;
+
+  _collectingYoung = true;
+  markRoots();
+
+  for (LoxObject *object : _rememberedObjects) {
+    object->_remembered = false;
+    object->trace(*this);
+  }
+  _rememberedObjects.clear();
+
+  for (Environment *environment : _rememberedEnvironments) {
+    environment->_remembered = false;
+    for (auto &[name, value] : environment->_values)
+      evacuate(value);
+  }
+  _rememberedEnvironments.clear();
+
+  // Promoted copies may still refer to other young objects.
+  while (!_promoted.empty()) {
+    LoxObject *object = _promoted.back();
+    _promoted.pop_back();
+    object->trace(*this);
+  }
+  _collectingYoung = false;
+
+  size_t reclaimed = 0;
+  for (LoxObject *object : _young) {
+    if (!object->_marked)
+      reclaimed += object->size();
+    object->~LoxObject();
+  }
+
+  _young.clear();
+  _nursery.reset();
+  _nurseryFull = false;
+
+  std::chrono::duration<double, std::milli> pause =
+      std::chrono::steady_clock::now() - start;
+  _minorCollections++;
+  report("minor", _minorCollections, pause.count(), reclaimed,
+         _bytesPromoted - promotedBefore);
+}
+
+void Heap::collectOld() {
+  auto start = std::chrono::steady_clock::now();
+
+  markRoots();
+
+  while (!_gray.empty()) {
+    LoxObject *object = _gray.back();
+    _gray.pop_back();
+    object->trace(*this);
+  }
+
+  size_t reclaimed = sweep();
+
+  _nextCollection = std::max(_bytesAllocated * 2, MIN_COLLECTION_BYTES);
+
+  std::chrono::duration<double, std::milli> pause =
+      std::chrono::steady_clock::now() - start;
+  _collections++;
+  report("major", _collections, pause.count(), reclaimed, 0);
+}
+
+size_t Heap::sweep() {
+  LoxObject **link = &_objects;
+  size_t reclaimed = 0;
+  _bytesAllocated = 0;
+
+  while (*link != nullptr) {
+    LoxObject *object = *link;
+
+    if (object->_marked) {
+      object->_marked = false;
+      _bytesAllocated += object->size();
+      link = &object->_next;
+    } else {
+      *link = object->_next;
+      reclaimed += object->size();
+      delete object;
+    }
+  }
+
+  return reclaimed;
+}
+
+void Heap::report(const char *kind, size_t number, double pause,
+                  size_t reclaimed, size_t promoted) {
+  _bytesReclaimed += reclaimed;
+  _totalPause += pause;
+  _maxPause = std::max(_maxPause, pause);
+
+  if (!_reportStats)
+    return;
+
+  std::cerr << "[gc] " << kind << " collection " << number << ": " << pause
+            << " ms, reclaimed " << reclaimed << " bytes";
+  if (promoted != 0)
+    std::cerr << ", promoted " << promoted << " bytes";
+  std::cerr << ", " << _bytesAllocated << " bytes old" << std::endl;
+}
+
+void Heap::reportStats(std::ostream &outs) const {
+  outs << "[gc] " << _minorCollections << " minor and " << _collections
+       << " major collections, " << _totalPause << " ms total pause, "
+       << _maxPause << " ms max pause, " << _bytesReclaimed
+       << " bytes reclaimed, " << _bytesPromoted << " bytes promoted, "
+       << _bytesAllocated << " bytes old" << std::endl;
+}
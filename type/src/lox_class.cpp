@@ -1,33 +1,90 @@
+#include <heap.h>
 #include <lox_class.h>
 #include <lox_instance.h>
 #include <lox_type.h>
+#include <runtime_error.h>
+#include <token.h>
 
-LoxType LoxClass::call(Interpreter *interpreter,
-                       const std::vector<LoxType> &args) {
-  LoxInstance *instance = new LoxInstance(this);
+LoxClass::LoxClass(const std::string &name, LoxClass *superclass,
+                   const std::map<std::string, LoxFunction> &methods)
+    : _name(name), _superclass(superclass) {
+  if (superclass != nullptr)
+    _table = superclass->_table;
+
+  _methods.reserve(methods.size());
+  for (const auto &[methodName, method] : methods) {
+    size_t id = methodId(methodName);
+    if (id >= _table.size())
+      _table.resize(id + 1, nullptr);
 
-  std::optional<LoxFunction> initializer = getMethod("init");
-  if (initializer.has_value()) {
-    initializer.value().bind(instance)->call(interpreter, args);
+    _methods.push_back(method);
+    _table[id] = &_methods.back();
   }
+}
 
-  return LoxType(instance);
+LoxType LoxClass::call(Interpreter *interpreter,
+                       std::span<const LoxType> args) {
+  return instantiate(interpreter, initializer(), args);
+}
+
+LoxType LoxClass::instantiate(Interpreter *interpreter,
+                              LoxFunction *initializer,
+                              std::span<const LoxType> args) {
+  LoxType instance = Heap::instance().make<LoxInstance>(this);
+  // The initializer may trigger a collection that moves the instance.
+  RootGuard instanceGuard(&instance);
+
+  if (initializer != nullptr)
+    initializer->invoke(interpreter, instance, args);
+
+  return instance;
 }
 
 const std::string &LoxClass::name() { return _name; }
 
-std::optional<LoxFunction> LoxClass::getMethod(const std::string &name) const {
-  if (_methods.contains(name))
-    return std::optional(_methods.at(name));
+std::unordered_map<std::string, size_t> &LoxClass::methodIds() {
+  static std::unordered_map<std::string, size_t> ids;
+  return ids;
+}
 
-  return std::nullopt;
+size_t LoxClass::methodId(const std::string &name) {
+  std::unordered_map<std::string, size_t> &ids = methodIds();
+  return ids.try_emplace(name, ids.size()).first->second;
 }
 
-size_t LoxClass::arity() const {
-  std::optional<LoxFunction> initializer = getMethod("init");
+LoxFunction *LoxClass::getMethod(const std::string &name) {
+  // A name no method was declared with is not given an id.
+  const std::unordered_map<std::string, size_t> &ids = methodIds();
+  auto it = ids.find(name);
+  return it != ids.end() ? getMethod(it->second) : nullptr;
+}
 
-  if (initializer.has_value())
-    return initializer->arity();
+LoxFunction *LoxClass::superMethod(const Token &name) {
+  if (LoxFunction *method = getMethod(name.lexeme()))
+    return method;
+
+  throw RuntimeError(name, _name + " has no method named " + name.lexeme() + ".");
+}
+
+size_t LoxClass::arity() const {
+  if (LoxFunction *init = initializer())
+    return init->arity();
 
   return 0;
 }
+
+LoxFunction *LoxClass::initializer() const {
+  static const size_t init = methodId("init");
+  return getMethod(init);
+}
+
+void LoxClass::trace(Heap &heap) {
+  heap.mark(_superclass);
+  for (LoxFunction &method : _methods)
+    method.trace(heap);
+}
+
+size_t LoxClass::size() const {
+  return sizeof(LoxClass) + _methods.size() * sizeof(LoxFunction) +
+         _table.size() * sizeof(LoxFunction *);
+}
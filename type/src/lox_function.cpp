@@ -1,35 +1,100 @@
 #include <lox_function.h>
+#include <compilation_unit.h>
+#include <frame.h>
+#include <heap.h>
 #include <interpreter.h>
-#include <return.h>
+#include <jit.h>
+#include <memo.h>
 
-LoxFunction::LoxFunction(const Stmt::FunctionStmt declaration, std::shared_ptr<Environment> enclosing)
-    : _declaration(declaration), _closure(enclosing) {}
+#include <optional>
 
-LoxFunction::LoxFunction(const LoxFunction& other) : _declaration(other._declaration), _closure(other._closure) {}
+LoxFunction::LoxFunction(const Stmt::FunctionStmt *declaration,
+                         const FunctionInfo *info,
+                         std::vector<Upvalue *> upvalues,
+                         std::shared_ptr<const CompiledFunction> compiled)
+    : _declaration(declaration), _info(info),
+      _unit(declaration->unit()->shared_from_this()),
+      _compiled(std::move(compiled)), _upvalues(std::move(upvalues)) {}
+
+LoxFunction::LoxFunction(const LoxFunction& other) : LoxCallable(other), _declaration(other._declaration), _info(other._info), _unit(other._unit), _compiled(other._compiled), _upvalues(other._upvalues), _receiver(other._receiver), _calls(other._calls), _native(other._native) {}
 
 LoxType LoxFunction::call(Interpreter *interpreter,
-                           const std::vector<LoxType> &args) {
-  for (size_t i = 0; i < _declaration.params().size(); i++) {
-    _closure.define(_declaration.params().at(i).lexeme(), args.at(i));
-  }
-  
-  try {
-    interpreter->executeBlock(std::make_shared<Environment>(std::make_shared<Environment>(_closure)), _declaration.body());
-  } catch (Return r) {
-    return r.value();
+                           std::span<const LoxType> args) {
+  return invoke(interpreter, _receiver, args);
+}
+
+// Runs tail calls in a loop, each in the frame of the call it replaces, so
+// that they use neither the native stack nor the interpreter's.
+LoxType LoxFunction::invoke(Interpreter *interpreter, const LoxType &receiver,
+                            std::span<const LoxType> args) {
+  CallStack::Guard guard(interpreter->_stack);
+  LoxFunction *function = this;
+  const LoxType *self = &receiver;
+  // The function of a tail call and its receiver, rooted once there is one.
+  LoxType running[2];
+  std::optional<RootGuard> runningGuard;
+  // The memoized calls the result is also the result of: this one and the
+  // ones it was replaced by in tail position.
+  std::vector<std::pair<Memo *, std::string>> memoized;
+  LoxType result;
+
+  while (true) {
+    if (Memo *memo = function->_info->memo.get()) {
+      std::string key;
+      if (Memo::key(args, key)) {
+        if (const LoxType *found = memo->find(key)) {
+          result = *found;
+          break;
+        }
+        memoized.emplace_back(memo, std::move(key));
+      }
+    }
+
+    if (function->_calls < Jit::THRESHOLD && ++function->_calls == Jit::THRESHOLD)
+      function->_native =
+          interpreter->_jit.compile(function->_declaration, *function->_info);
+    if (function->_native != nullptr && function->_native->run(args, result))
+      break;
+
+    Frame frame = interpreter->_stack.pushFrame(
+        *function->_info, *self, args, function->_declaration->name());
+    frame.upvalues = function->_upvalues.data();
+
+    Completion completion =
+        interpreter->executeBlock(frame, function->_declaration->body());
+    if (completion == Completion::RETURN) {
+      result = interpreter->takeReturnValue();
+      break;
+    }
+    if (completion == Completion::NORMAL) {
+      result = LoxType(std::monostate());
+      break;
+    }
+
+    if (!runningGuard)
+      runningGuard.emplace(running, 2);
+    function =
+        interpreter->takeTailCall(frame.slots, running[0], running[1], args);
+    self = &running[1];
   }
 
-  return LoxType(std::monostate());
+  for (auto &[memo, key] : memoized)
+    memo->insert(std::move(key), result);
+  return result;
 }
 
 size_t LoxFunction::arity() const {
-  return _declaration.params().size();
+  return _declaration->params().size();
 }
 
-LoxFunction* LoxFunction::bind(LoxInstance* instance) {
-  LoxFunction* func  = new LoxFunction(_declaration, std::make_shared<Environment>(_closure));
-  func->_closure.define("this", instance);
-  
-  return func;
+LoxFunction* LoxFunction::bind(LoxInstance* instance) const {
+  LoxFunction *bound = Heap::instance().make<LoxFunction>(*this);
+  bound->_receiver = instance;
+  return bound;
 }
 
+void LoxFunction::trace(Heap &heap) {
+  heap.mark(_receiver);
+  for (Upvalue *upvalue : _upvalues)
+    heap.mark(upvalue);
+}
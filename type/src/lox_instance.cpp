@@ -1,22 +1,34 @@
+#include <heap.h>
 #include <lox_instance.h>
 #include <token.h>
 #include <runtime_error.h>
 
+#include <bit>
 #include <sstream>
 
-LoxInstance::LoxInstance(LoxClass* loxClass) : _loxClass(loxClass) {}
+namespace {
+
+Shape *rootShape(LoxClass *loxClass) {
+  static Shape classless;
+  return loxClass != nullptr ? loxClass->shape() : &classless;
+}
+
+} // namespace
+
+LoxInstance::LoxInstance(LoxClass* loxClass)
+    : _loxClass(loxClass), _shape(rootShape(loxClass)) {}
 
 const LoxType LoxInstance::get(Token name) {
-  if (_fields.contains(name.lexeme())) {
-    return _fields.at(name.lexeme());
-  }
+  int slot = _shape->slot(name.lexeme());
+  if (slot >= 0)
+    return field(slot);
   
-  std::optional<LoxFunction> method_opt = _loxClass->getMethod(name.lexeme());
-  if (method_opt.has_value()) {
+  LoxFunction *method = _loxClass->getMethod(name.lexeme());
+  if (method != nullptr) {
     if (name.lexeme() == "init") 
       throw RuntimeError(name, "Cannot access class's initializer");
 
-    return LoxType(method_opt.value().bind(this));
+    return LoxType(method->bind(this));
   }
 
   std::stringstream error_message;
@@ -26,9 +38,110 @@ const LoxType LoxInstance::get(Token name) {
 }
 
 void LoxInstance::set(Token name, LoxType value) {
-  _fields.insert({name.lexeme(), value});
+  Heap::instance().writeBarrier(this, value);
+
+  int slot = _shape->slot(name.lexeme());
+  if (slot < 0) {
+    slot = _shape->fields();
+    grow(slot);
+    _shape = _shape->add(name.lexeme());
+  }
+  field(slot) = value;
+}
+
+const LoxType LoxInstance::get(const Token &name, PropertyCache &cache) {
+  if (const PropertyCache::Entry *entry = lookup(name, cache)) {
+    if (entry->method == nullptr)
+      return field(entry->slot);
+    return LoxType(entry->method->bind(this));
+  }
+  return get(name);
+}
+
+LoxFunction *LoxInstance::method(const Token &name, PropertyCache &cache) {
+  if (const PropertyCache::Entry *entry = lookup(name, cache))
+    return entry->method;
+
+  if (_shape->slot(name.lexeme()) >= 0 || name.lexeme() == "init")
+    return nullptr;
+  return _loxClass->getMethod(name.lexeme());
+}
+
+const PropertyCache::Entry *LoxInstance::lookup(const Token &name,
+                                                PropertyCache &cache) {
+  if (const PropertyCache::Entry *entry = cache.find(_shape->id()))
+    return entry;
+
+  int slot = _shape->slot(name.lexeme());
+  if (slot >= 0) {
+    cache.add({_shape->id(), slot});
+  } else if (name.lexeme() != "init") {
+    LoxFunction *method = _loxClass->getMethod(name.lexeme());
+    if (method == nullptr)
+      return nullptr;
+    cache.add({_shape->id(), -1, method});
+  }
+  return cache.find(_shape->id());
+}
+
+void LoxInstance::set(const Token &name, LoxType value, PropertyCache &cache) {
+  const PropertyCache::Entry *entry = cache.find(_shape->id());
+  if (entry == nullptr) {
+    int slot = _shape->slot(name.lexeme());
+    Shape *transition = slot < 0 ? _shape->add(name.lexeme()) : nullptr;
+    cache.add({_shape->id(), slot < 0 ? int(_shape->fields()) : slot, nullptr,
+               transition});
+    set(name, std::move(value));
+    return;
+  }
+
+  Heap::instance().writeBarrier(this, value);
+  if (entry->transition != nullptr) {
+    grow(entry->slot);
+    _shape = entry->transition;
+  }
+  field(entry->slot) = value;
 }
 
 bool LoxInstance::operator==(const LoxInstance& other) const {
-  return _fields == other._fields;
+  if (_shape->fields() != other._shape->fields())
+    return false;
+
+  for (auto &[name, slot] : _shape->slots()) {
+    int otherSlot = other._shape->slot(name);
+    if (otherSlot < 0 || !(field(slot) == other.field(otherSlot)))
+      return false;
+  }
+  return true;
+}
+
+void LoxInstance::trace(Heap &heap) {
+  heap.mark(_loxClass);
+  for (size_t slot = 0; slot < _shape->fields(); slot++)
+    heap.mark(field(slot));
+}
+
+size_t LoxInstance::size() const {
+  return sizeof(LoxInstance) + overflowCapacity() * sizeof(LoxType);
+}
+
+void LoxInstance::grow(int slot) {
+  if (slot < INLINE_FIELDS)
+    return;
+
+  // The array is full when the number of fields in it is a power of two.
+  size_t used = slot - INLINE_FIELDS;
+  if (used != 0 && !std::has_single_bit(used))
+    return;
+
+  std::unique_ptr<LoxType[]> overflow(new LoxType[used == 0 ? 1 : 2 * used]);
+  for (size_t i = 0; i < used; i++)
+    overflow[i] = std::move(_overflow[i]);
+  _overflow = std::move(overflow);
+}
+
+size_t LoxInstance::overflowCapacity() const {
+  if (_shape->fields() <= INLINE_FIELDS)
+    return 0;
+  return std::bit_ceil(_shape->fields() - INLINE_FIELDS);
 }
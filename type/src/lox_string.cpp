@@ -0,0 +1,128 @@
+#include <lox_string.h>
+
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+struct InternHash {
+  using is_transparent = void;
+
+  size_t operator()(const LoxString *string) const { return string->hash(); }
+  size_t operator()(std::string_view chars) const {
+    return LoxString::hashOf(chars);
+  }
+};
+
+struct InternEqual {
+  using is_transparent = void;
+
+  bool operator()(const LoxString *a, const LoxString *b) const {
+    return a == b;
+  }
+  bool operator()(std::string_view a, const LoxString *b) const {
+    return a == b->str();
+  }
+  bool operator()(const LoxString *a, std::string_view b) const {
+    return a->str() == b;
+  }
+};
+
+typedef std::unordered_set<LoxString *, InternHash, InternEqual> InternTable;
+
+// Never destroyed, so strings held by other statics can still release
+// themselves during shutdown.
+InternTable &internTable() {
+  static InternTable *table = new InternTable();
+  return *table;
+}
+
+} // namespace
+
+LoxString *LoxString::intern(std::string_view chars) {
+  InternTable &table = internTable();
+
+  auto it = table.find(chars);
+  if (it != table.end())
+    return *it;
+
+  LoxString *string = new LoxString(chars);
+  table.insert(string);
+  return string;
+}
+
+LoxString *LoxString::concat(LoxString *left, LoxString *right) {
+  if (left->length() == 0)
+    return right;
+  if (right->length() == 0)
+    return left;
+
+  if (left->length() + right->length() <= ROPE_THRESHOLD)
+    return intern(left->str() + right->str());
+
+  return new LoxString(left, right);
+}
+
+LoxString::LoxString(LoxString *left, LoxString *right)
+    : _length(left->length() + right->length()), _left(left), _right(right) {
+  _left->retain();
+  _right->retain();
+}
+
+LoxString *LoxString::flatten() const {
+  std::string chars;
+  chars.reserve(_length);
+
+  // Ropes built by repeated appends are as deep as they are long, so walk
+  // them with an explicit stack instead of recursing.
+  std::vector<const LoxString *> pending{this};
+  while (!pending.empty()) {
+    const LoxString *node = pending.back();
+    pending.pop_back();
+
+    if (node->_canonical != nullptr) {
+      chars += node->_canonical->_chars;
+    } else {
+      pending.push_back(node->_right);
+      pending.push_back(node->_left);
+    }
+  }
+
+  _canonical = intern(chars);
+  _canonical->retain();
+
+  // The characters now live in the canonical string, the halves are no
+  // longer needed.
+  LoxString *left = _left, *right = _right;
+  _left = _right = nullptr;
+  left->release();
+  right->release();
+
+  return _canonical;
+}
+
+void LoxString::destroy() {
+  std::vector<LoxString *> pending{this};
+
+  while (!pending.empty()) {
+    LoxString *string = pending.back();
+    pending.pop_back();
+
+    LoxString *children[] = {string->_left, string->_right,
+                             string->_canonical == string ? nullptr
+                                                          : string->_canonical};
+    for (LoxString *child : children) {
+      if (child != nullptr && --child->_refs == 0)
+        pending.push_back(child);
+    }
+
+    if (string->_canonical == string)
+      internTable().erase(string);
+    delete string;
+  }
+}
+
+const std::string &StringRef::str() const {
+  static const std::string empty;
+  return _string == nullptr ? empty : _string->str();
+}
@@ -7,104 +7,85 @@
 #include <lox_callable.h>
 #include <lox_function.h>
 
-LoxType::LoxType() : _value(std::monostate()), _type(typeid(std::monostate)) {}
-LoxType::LoxType(const LoxType& other) : _value(other._value), _type(other._type) {}
-LoxType::LoxType(std::monostate val) : LoxType() {}
+LoxType::LoxType(std::string val) : LoxType(StringRef(val)) {}
 
-LoxType::LoxType(bool val) : _value(val), _type(typeid(bool)) {}
-LoxType::LoxType(double val) : _value(val), _type(typeid(double)) {}
-LoxType::LoxType(std::string val) : _value(val), _type(typeid(std::string)) {}
-LoxType::LoxType(LoxCallable* val)
-    : _value(val), _type(typeid(LoxCallable*)) {}
-LoxType::LoxType(LoxFunction* val)
-    : _value(val), _type(typeid(LoxFunction*)) {}
-LoxType::LoxType(LoxClass* val)
-    : _value(val), _type(typeid(LoxClass*)) {}
-LoxType::LoxType(LoxInstance* val)
-    : _value(val), _type(typeid(LoxInstance*)) {}
+LoxType::LoxType(const StringRef &val) : LoxType(val.get()) {}
 
-bool LoxType::empty() const {
-  return isType<std::monostate>();
+LoxType::LoxType(LoxString *val) : _bits(boxPointer(STRING, val)) {
+  retain();
 }
 
-LoxType &LoxType::operator=(LoxType &other) {
-  _value = std::move(other._value);
-  _type = other._type;
+LoxType LoxType::concat(const LoxType &left, const LoxType &right) {
+  if (!left.isType<std::string>() || !right.isType<std::string>())
+    throw InvalidTypeException(typeName(STRING),
+                               typeName(left.isType<std::string>() ? right.tag()
+                                                                   : left.tag()));
 
-  return *this;
-}
-
-LoxType &LoxType::operator=(bool other) {
-  _value = other;
-  _type = typeid(bool);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(double other) {
-  _value = other;
-  _type = typeid(double);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(std::string other) {
-  _value = other;
-  _type = typeid(std::string);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(LoxCallable* other) {
-  _value = std::move(other);
-  _type = typeid(LoxCallable*);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(LoxInstance* other) {
-  _value = std::move(other);
-  _type = typeid(LoxInstance*);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(LoxClass* other) {
-  _value = std::move(other);
-  _type = typeid(LoxClass*);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(LoxFunction* other) {
-  _value = std::move(other);
-  _type = typeid(LoxFunction*);
-
-  return *this;
-}
-
-LoxType &LoxType::operator=(const LoxType& other) {
-  _value = other._value;
-  _type = other._type;
-
-  return *this;
+  return LoxType(LoxString::concat(left.string(), right.string()));
 }
 
 bool LoxType::operator==(const LoxType& other) const {
-  return (other._type == _type) && (other._value == _value);
+  Tag type = tag();
+  if (type != other.tag())
+    return false;
+
+  switch (type) {
+  case NUMBER:
+    return number() == other.number();
+  case STRING:
+    return _bits == other._bits ||
+           string()->canonical() == other.string()->canonical();
+  default:
+    return _bits == other._bits;
+  }
 }
 
-struct Printer {
-  std::string operator()(bool val) {return val ? "true" : "false";}
-  std::string operator()(double val) {return std::to_string(val);}
-  std::string operator()(std::string val) {return val;}
-  std::string operator()(std::monostate val) {return "nil";}
-  std::string operator()(const LoxCallable* val) {return "<Lox Function>";}
-  std::string operator()(const LoxInstance* val) {return "<Lox Instance>";}
-};
+const char *LoxType::typeName(Tag tag) {
+  switch (tag) {
+  case NUMBER:
+    return "number";
+  case NIL:
+    return "nil";
+  case BOOL:
+    return "bool";
+  case STRING:
+    return "string";
+  case CALLABLE:
+    return "callable";
+  case FUNCTION:
+    return "function";
+  case CLASS:
+    return "class";
+  case INSTANCE:
+    return "instance";
+  }
+
+  return "unknown";
+}
 
 std::ostream& operator<<(std::ostream& outs, const LoxType& type) {
-  outs << std::visit(Printer(), type._value);
+  switch (type.tag()) {
+  case LoxType::NUMBER:
+    outs << std::to_string(type.number());
+    break;
+  case LoxType::NIL:
+    outs << "nil";
+    break;
+  case LoxType::BOOL:
+    outs << (type.getValue<bool>() ? "true" : "false");
+    break;
+  case LoxType::STRING:
+    outs << type.string()->str();
+    break;
+  case LoxType::CALLABLE:
+  case LoxType::FUNCTION:
+  case LoxType::CLASS:
+    outs << "<Lox Function>";
+    break;
+  case LoxType::INSTANCE:
+    outs << "<Lox Instance>";
+    break;
+  }
+
   return outs;
 }
-
@@ -0,0 +1,67 @@
+#include <memo.h>
+
+#include <cstdint>
+#include <cstring>
+
+Memo::Memo(std::string name, size_t capacity)
+    : _name(std::move(name)), _capacity(capacity) {}
+
+bool Memo::key(std::span<const LoxType> args, std::string &key) {
+  key.clear();
+
+  // Each argument is its tag followed by the bits of the number, or the
+  // length and characters of the string, which keeps keys unambiguous.
+  for (const LoxType &arg : args) {
+    if (arg.isType<double>()) {
+      double number = arg.getValue<double>();
+      char bytes[sizeof(number)];
+      std::memcpy(bytes, &number, sizeof(number));
+      key += 'n';
+      key.append(bytes, sizeof(bytes));
+    } else if (arg.isType<std::string>()) {
+      const std::string &string = arg.getValue<std::string>();
+      uint64_t length = string.size();
+      char bytes[sizeof(length)];
+      std::memcpy(bytes, &length, sizeof(length));
+      key += 's';
+      key.append(bytes, sizeof(bytes));
+      key += string;
+    } else {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const LoxType *Memo::find(const std::string &key) {
+  auto it = _results.find(key);
+  if (it == _results.end()) {
+    _misses++;
+    return nullptr;
+  }
+
+  _hits++;
+  return &it->second;
+}
+
+void Memo::insert(std::string key, const LoxType &result) {
+  switch (result.tag()) {
+  case LoxType::NUMBER:
+  case LoxType::NIL:
+  case LoxType::BOOL:
+  case LoxType::STRING:
+    break;
+  default:
+    return;
+  }
+
+  if (_results.size() >= _capacity)
+    _results.clear();
+  _results.insert_or_assign(std::move(key), result);
+}
+
+void Memo::reportStats(std::ostream &outs) const {
+  outs << "[memo] " << _name << ": " << _hits << " hits, " << _misses
+       << " misses, " << _results.size() << " results" << std::endl;
+}
@@ -0,0 +1,11 @@
+#include <shape.h>
+
+Shape *Shape::add(const std::string &name) {
+  std::unique_ptr<Shape> &next = _transitions[name];
+  if (next == nullptr) {
+    next = std::make_unique<Shape>();
+    next->_slots = _slots;
+    next->_slots.emplace(name, _slots.size());
+  }
+  return next.get();
+}
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+
+#include <compilation_unit.h>
+#include <heap.h>
+#include <lox_class.h>
+#include <lox_instance.h>
+#include <lox_type.h>
+#include <shape.h>
+#include <token.h>
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <variant>
+
+TEST(LoxTypeTest, NumbersRoundTrip) {
+  for (double val : {0.0, -0.0, 1.5, -3.25, 1e300, -1e-300,
+                     std::numeric_limits<double>::infinity(),
+                     -std::numeric_limits<double>::infinity()}) {
+    LoxType type(val);
+    EXPECT_TRUE(type.isType<double>());
+    EXPECT_EQ(type.getValue<double>(), val);
+  }
+}
+
+TEST(LoxTypeTest, NaNStaysANumber) {
+  LoxType type(-std::numeric_limits<double>::quiet_NaN());
+  EXPECT_TRUE(type.isType<double>());
+  EXPECT_TRUE(std::isnan(type.getValue<double>()));
+  EXPECT_FALSE(type == type);
+}
+
+TEST(LoxTypeTest, TagsAreDistinct) {
+  LoxType nil;
+  LoxType boolean(true);
+  LoxType string(std::string("lox"));
+  LoxType instance(reinterpret_cast<LoxInstance *>(0x1000));
+
+  EXPECT_TRUE(nil.empty());
+  EXPECT_TRUE(nil.isType<std::monostate>());
+  EXPECT_TRUE(boolean.isType<bool>());
+  EXPECT_TRUE(boolean.getValue<bool>());
+  EXPECT_FALSE(LoxType(false).getValue<bool>());
+  EXPECT_TRUE(string.isType<std::string>());
+  EXPECT_EQ(string.getValue<std::string>(), "lox");
+  EXPECT_TRUE(instance.isType<LoxInstance *>());
+  EXPECT_FALSE(instance.isType<LoxClass *>());
+  EXPECT_EQ(instance.getValue<LoxInstance *>(),
+            reinterpret_cast<LoxInstance *>(0x1000));
+  EXPECT_FALSE(nil == boolean);
+  EXPECT_THROW(nil.getValue<double>(), InvalidTypeException);
+}
+
+TEST(LoxTypeTest, EqualStringsAreInterned) {
+  LoxType first(std::string("abc"));
+  LoxType second(std::string("abc"));
+  LoxType copy = first;
+
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(&second.getValue<std::string>(), &first.getValue<std::string>());
+  EXPECT_EQ(&copy.getValue<std::string>(), &first.getValue<std::string>());
+  EXPECT_FALSE(first == LoxType(std::string("abd")));
+
+  copy = LoxType(1.0);
+  EXPECT_EQ(first.getValue<std::string>(), "abc");
+}
+
+TEST(LoxStringTest, InternReturnsCanonicalString) {
+  StringRef first("name");
+  StringRef second(std::string("na") + "me");
+
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(first.get()->hash(), LoxString::hashOf("name"));
+  EXPECT_EQ(std::hash<StringRef>()(first), first.get()->hash());
+  EXPECT_EQ(LoxType(first), LoxType(std::string("name")));
+}
+
+TEST(LoxStringTest, RopesFlattenOnDemand) {
+  LoxType piece(std::string(40, 'x'));
+  LoxType built(std::string(""));
+
+  for (int i = 0; i < 10000; i++)
+    built = LoxType::concat(built, piece);
+
+  EXPECT_EQ(built.getValue<std::string>().size(), 400000u);
+  EXPECT_EQ(built, LoxType(std::string(400000, 'x')));
+
+  LoxType shorter = LoxType::concat(LoxType(std::string("ab")), LoxType(std::string("c")));
+  EXPECT_EQ(shorter, LoxType(std::string("abc")));
+  EXPECT_THROW(LoxType::concat(shorter, LoxType(1.0)), InvalidTypeException);
+}
+
+TEST(HeapTest, RootedInstancesArePromoted) {
+  Heap &heap = Heap::instance();
+  LoxType kept = heap.make<LoxInstance>(nullptr);
+  LoxType dropped = heap.make<LoxInstance>(nullptr);
+
+  EXPECT_TRUE(heap.isYoung(kept));
+  EXPECT_TRUE(heap.isYoung(dropped));
+
+  {
+    RootGuard guard(&kept);
+    heap.collect();
+  }
+
+  EXPECT_TRUE(kept.isType<LoxInstance *>());
+  EXPECT_FALSE(heap.isYoung(kept));
+}
+
+TEST(ShapeTest, FieldsAddedInTheSameOrderShareAShape) {
+  Shape root;
+  Shape *xy = root.add("x")->add("y");
+
+  EXPECT_EQ(root.add("x")->add("y"), xy);
+  EXPECT_NE(root.add("y")->add("x"), xy);
+  EXPECT_EQ(xy->slot("x"), 0);
+  EXPECT_EQ(xy->slot("y"), 1);
+  EXPECT_EQ(xy->slot("z"), -1);
+  EXPECT_EQ(root.fields(), 0u);
+}
+
+TEST(ShapeTest, FieldsBeyondTheInlineOnesAreKept) {
+  Heap &heap = Heap::instance();
+  LoxType instance = heap.make<LoxInstance>(nullptr);
+  RootGuard guard(&instance);
+
+  for (int i = 0; i < 20; i++) {
+    Token name(IDENTIFIER, "f" + std::to_string(i), LoxType(), 1);
+    instance.getValue<LoxInstance *>()->set(name, LoxType(double(i)));
+  }
+  heap.collect();
+
+  for (int i = 0; i < 20; i++) {
+    Token name(IDENTIFIER, "f" + std::to_string(i), LoxType(), 1);
+    EXPECT_EQ(instance.getValue<LoxInstance *>()->get(name).getValue<double>(), i);
+  }
+}
+
+TEST(PropertyCacheTest, SitesCacheEachShapeOnce) {
+  Heap &heap = Heap::instance();
+  LoxType first = heap.make<LoxInstance>(nullptr);
+  LoxType second = heap.make<LoxInstance>(nullptr);
+  LoxType third = heap.make<LoxInstance>(nullptr);
+  LoxType roots[] = {first, second, third};
+  RootGuard guard(roots, 3);
+  Token x(IDENTIFIER, "x", LoxType(), 1);
+  Token y(IDENTIFIER, "y", LoxType(), 1);
+
+  PropertyCache setX, getX;
+  roots[2].getValue<LoxInstance *>()->set(y, LoxType(0.0));
+  for (int i = 0; i < 3; i++)
+    roots[i].getValue<LoxInstance *>()->set(x, LoxType(double(i)), setX);
+  for (int i = 0; i < 3; i++)
+    EXPECT_EQ(roots[i].getValue<LoxInstance *>()->get(x, getX).getValue<double>(), i);
+
+  // The first two instances share a shape, the third has another one.
+  EXPECT_EQ(setX.size(), 2u);
+  EXPECT_EQ(getX.size(), 2u);
+  EXPECT_EQ(roots[1].getValue<LoxInstance *>()->get(x).getValue<double>(), 1);
+}
+
+TEST(LoxClassTest, MethodsAreCopiedDownTheHierarchy) {
+  auto unit = std::make_shared<CompilationUnit>();
+  auto methods = [&](std::vector<const char *> names) {
+    std::map<std::string, LoxFunction> table;
+    for (const char *name : names) {
+      std::vector<Token> params;
+      std::vector<const Stmt::Stmt *> body;
+      Stmt::FunctionStmt *declaration = unit->make<Stmt::FunctionStmt>(
+          Token(IDENTIFIER, name, LoxType(), 1), params, body, unit.get());
+      table.insert({name, LoxFunction(declaration, nullptr, {})});
+    }
+    return table;
+  };
+
+  LoxClass a("A", nullptr, methods({"f", "g"}));
+  LoxClass b("B", &a, methods({"g"}));
+  LoxClass c("C", &b, methods({"h"}));
+
+  EXPECT_EQ(c.getMethod("f"), a.getMethod("f"));
+  EXPECT_EQ(c.getMethod("g"), b.getMethod("g"));
+  EXPECT_NE(b.getMethod("g"), a.getMethod("g"));
+  EXPECT_NE(c.getMethod("h"), nullptr);
+  EXPECT_EQ(a.getMethod("h"), nullptr);
+  EXPECT_EQ(c.getMethod("missing"), nullptr);
+  EXPECT_EQ(c.getMethod(LoxClass::methodId("f")), a.getMethod("f"));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that all die at the same time. Objects are
+// placed next to each other in large chunks and destroyed together with the
+// arena, in the reverse order of their construction.
+class Arena {
+public:
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    for (auto it = _destructors.rbegin(); it != _destructors.rend(); it++)
+      it->destroy(it->object);
+  }
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      _destructors.push_back({object, [](void *ptr) { static_cast<T *>(ptr)->~T(); }});
+
+    return object;
+  }
+
+  void *allocate(size_t size, size_t alignment) {
+    std::byte *memory = align(_top, alignment);
+    if (memory == nullptr || memory + size > _end) {
+      grow(size + alignment);
+      memory = align(_top, alignment);
+    }
+
+    _top = memory + size;
+    return memory;
+  }
+
+  size_t bytesReserved() const { return _reserved; }
+
+private:
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  static std::byte *align(std::byte *ptr, size_t alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<std::byte *>((address + alignment - 1) & ~(alignment - 1));
+  }
+
+  // Oversized requests get a chunk of their own.
+  void grow(size_t minimum) {
+    size_t size = minimum > CHUNK_SIZE ? minimum : CHUNK_SIZE;
+    _chunks.emplace_back(new std::byte[size]);
+    _top = _chunks.back().get();
+    _end = _top + size;
+    _reserved += size;
+  }
+
+  std::vector<std::unique_ptr<std::byte[]>> _chunks;
+  std::vector<Destructor> _destructors;
+  std::byte *_top = nullptr;
+  std::byte *_end = nullptr;
+  size_t _reserved = 0;
+};